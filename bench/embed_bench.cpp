@@ -0,0 +1,52 @@
+//
+// Per call overhead of calling a Monke function from C++.
+//
+// Usage: embed_bench [calls]
+//
+
+#include <chrono>
+#include <format>
+#include <iostream>
+
+#include "compiled_program.h"
+#include "eval.h"
+#include "isolate.h"
+
+const std::string RULES = R""""(
+let threshold = 100;
+let score = fn(x, y) { if (x * y > threshold) { x * y - threshold } else { 0 } };
+)"""";
+
+// Nanoseconds per call of body(i) over calls iterations
+template <typename F>
+double measure(size_t calls, F &&body) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < calls; i++) {
+    if (!body(static_cast<int64_t>(i))) std::abort();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / static_cast<double>(calls);
+}
+
+int main(int argc, char **argv) {
+  size_t calls = argc > 1 ? std::stoull(argv[1]) : 1000000;
+  auto compiled = CompiledProgram::compile(RULES);
+  if (!compiled.has_value()) return 1;
+
+  std::cout << std::format("{:<28} {:>12}\n", "path", "ns/call");
+  for (bool jit: {false, true}) {
+    IsolateConfig config;
+    config.jit.enabled = jit;
+    Isolate isolate(config);
+    isolate.run(compiled.value());
+    auto score = isolate.lookup("score").value();
+    double ns = measure(calls, [&](int64_t i) { return isolate.call(score, {Integer(i % 1000), Integer(3)}).has_value(); });
+    std::cout << std::format("{:<28} {:>12.1f}\n", jit ? "Isolate::call (jit)" : "Isolate::call (interpreter)", ns);
+  }
+
+  // What a host without the embedding API has to do: rebuild the source and evaluate it every time
+  size_t source_calls = std::max<size_t>(calls / 100, 1);
+  double ns = measure(source_calls, [&](int64_t i) { return eval_program(RULES + std::format("score({}, 3);", i % 1000)).has_value(); });
+  std::cout << std::format("{:<28} {:>12.1f}\n", "eval_program", ns);
+  return 0;
+}
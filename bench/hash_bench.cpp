@@ -0,0 +1,75 @@
+//
+// Lookups in the table behind Hash values against a std::unordered_map keyed by std::string, the obvious way to back them.
+//
+// Usage: hash_bench [keys] [lookups]
+//
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "hash_table.h"
+#include "intern.h"
+
+namespace {
+  template<typename F>
+  double nanoseconds(size_t lookups, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++) f(i);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(lookups);
+  }
+}// namespace
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? std::stoull(argv[1]) : 1000;
+  size_t lookups = argc > 2 ? std::stoull(argv[2]) : 10000000;
+
+  // Config style keys with a shared prefix, so comparing strings has to look past it
+  std::vector<std::string> names;
+  for (size_t i = 0; i < n; i++) names.push_back(std::format("settings.section.field_{}", i));
+
+  HashTable table;
+  std::unordered_map<std::string, Object> map;
+  for (size_t i = 0; i < n; i++) {
+    table.insert(HashKey::of(String(names[i])).value(), Integer(static_cast<int64_t>(i)));
+    map.emplace(names[i], Integer(static_cast<int64_t>(i)));
+  }
+
+  // A fixed random order of hits, so neither side benefits from walking its memory sequentially
+  std::vector<size_t> order(4096);
+  std::mt19937 rng(42);
+  for (auto &o: order) o = rng() % n;
+  std::vector<HashKey> symbols;
+  std::vector<String> strings;
+  for (auto &name: names) {
+    symbols.push_back(HashKey::symbol(intern(name)));
+    strings.emplace_back(name);
+  }
+
+  volatile int64_t sink = 0;
+  auto value = [](const Object *obj) { return std::get<Integer>(*obj).value; };
+  // Keys known up front, as for a literal h["key"]: the interned address is the whole key
+  double interned = nanoseconds(lookups, [&](size_t i) { sink = sink + value(table.find(symbols[order[i % order.size()]])); });
+  // Keys computed at runtime have to be found in the intern table first
+  double computed = nanoseconds(lookups, [&](size_t i) {
+    auto key = HashKey::find(strings[order[i % order.size()]]);
+    sink = sink + value(table.find(key.value()));
+  });
+  double unordered = nanoseconds(lookups, [&](size_t i) { sink = sink + value(&map.find(names[order[i % order.size()]])->second); });
+  // Misses stop at the first group with an empty slot
+  auto absent = HashKey::of(Integer(-1)).value();
+  double miss = nanoseconds(lookups, [&](size_t) { sink = sink + (table.find(absent) == nullptr); });
+
+  std::cout << std::format("{} keys, {} lookups\n", n, lookups);
+  std::cout << std::format("{:>28} {:>10.2f} ns\n", "HashTable, interned key", interned);
+  std::cout << std::format("{:>28} {:>10.2f} ns\n", "HashTable, runtime string", computed);
+  std::cout << std::format("{:>28} {:>10.2f} ns\n", "std::unordered_map<string>", unordered);
+  std::cout << std::format("{:>28} {:>10.2f} ns\n", "HashTable, miss", miss);
+  std::cout << std::format("interned lookups are {:.1f}x faster than std::unordered_map\n", unordered / interned);
+  (void) sink;
+  return 0;
+}
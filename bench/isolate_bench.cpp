@@ -0,0 +1,46 @@
+//
+// Throughput of independent isolates running on their own threads.
+//
+// Usage: isolate_bench [max threads] [scripts per thread]
+//
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <thread>
+
+#include "isolate.h"
+
+const std::string SCRIPT = R""""(
+let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) };
+let sum = fn(n) { if (n < 1) { 0 } else { n + sum(n - 1) } };
+fib(16) + sum(300);
+)"""";
+
+int main(int argc, char **argv) {
+  size_t max_threads = argc > 1 ? std::stoull(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+  size_t scripts = argc > 2 ? std::stoull(argv[2]) : 50;
+
+  double base = 0;
+  std::cout << std::format("{:>8} {:>12} {:>10}\n", "threads", "scripts/s", "speedup");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+      workers.emplace_back([scripts]() {
+        for (size_t i = 0; i < scripts; i++) {
+          Isolate isolate;
+          if (!isolate.run(SCRIPT).has_value()) std::abort();
+        }
+      });
+    }
+    for (auto &worker: workers) {
+      worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double rate = static_cast<double>(threads * scripts) / elapsed.count();
+    if (threads == 1) base = rate;
+    std::cout << std::format("{:>8} {:>12.1f} {:>9.2f}x\n", threads, rate, rate / base);
+  }
+  return 0;
+}
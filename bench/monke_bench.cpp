@@ -0,0 +1,187 @@
+//
+// Google Benchmark suite for every stage of the pipeline: lexing, parsing and evaluating canonical workloads.
+//
+// Usage: monke_bench [--perf-counters] [--benchmark_filter=regex] [--benchmark_out=results.json --benchmark_out_format=json]
+//
+// --perf-counters also counts cycles, instructions, branch misses and cache misses around each benchmark's timed loop,
+// and reports instructions per cycle and, for the evaluation workloads, misses per executed statement. Where the
+// counters cannot be opened the benchmarks still run, labelled with the reason.
+//
+// The monke_bench_json target runs every benchmark and writes monke_bench.json in the build directory. Two such files
+// can be compared with tools/compare.py from the benchmark sources.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "compiled_program.h"
+#include "counts.h"
+#include "isolate.h"
+#include "lexer.h"
+#include "perf_counters.h"
+
+namespace {
+  // Set by --perf-counters
+  bool use_perf_counters = false;
+
+  // Runs the benchmark's timed loop, under hardware counters if asked for. statements is how many one iteration
+  // executes, zero when the benchmark does not evaluate
+  void measure(benchmark::State &state, double statements, const std::function<void()> &loop) {
+    if (!use_perf_counters) return loop();
+    PerfCounters counters;
+    if (!counters.available()) {
+      state.SetLabel("no perf counters, " + counters.error());
+      return loop();
+    }
+    counters.start();
+    loop();
+    counters.stop();
+
+    auto cycles = counters.value(PerfEvent::Cycles);
+    auto instructions = counters.value(PerfEvent::Instructions);
+    if (cycles.has_value() && instructions.has_value() && cycles.value() > 0) {
+      state.counters["IPC"] = instructions.value() / cycles.value();
+    }
+    for (auto event: {PerfEvent::BranchMisses, PerfEvent::L1dMisses, PerfEvent::LlcMisses}) {
+      auto misses = counters.value(event);
+      if (!misses.has_value()) continue;
+      std::string name(perf_event_name(event));
+      state.counters[name] = benchmark::Counter(misses.value(), benchmark::Counter::kAvgIterations);
+      if (statements > 0) {
+        state.counters[name + "/stmt"] = misses.value() / (statements * static_cast<double>(state.iterations()));
+      }
+    }
+  }
+
+  // test_programs/advanced.monke with some arithmetic and strings, repeated to make a large input
+  const std::string UNIT = R""""(
+let z = fn(x) { let a = 4; let b = 5; return a + b + x; };
+let newAdder = fn(x) { fn(y) { x + y + z(x) } };
+let addTwo = newAdder(2);
+let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) };
+let greeting = "hello" + " " + "world";
+let values = [1, 2.5, 'c', "four", {"five": 5}];
+addTwo(2) * fib(10) / 3 - values[0];
+)"""";
+
+  std::string large_source() {
+    std::string source;
+    while (source.size() < (size_t(1) << 20)) source += UNIT;
+    return source;
+  }
+
+  void BM_Lex(benchmark::State &state) {
+    auto source = large_source();
+    size_t tokens = 0;
+    measure(state, 0, [&]() {
+      for (auto _: state) {
+        Lexer lexer(source);
+        while (true) {
+          auto token = lexer.next_token();
+          if (!token.has_value() || token.value().ttype == EOF_) break;
+          tokens++;
+        }
+      }
+    });
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+    state.counters["tokens"] = benchmark::Counter(static_cast<double>(tokens), benchmark::Counter::kIsRate);
+  }
+  BENCHMARK(BM_Lex)->Unit(benchmark::kMillisecond);
+
+  // Lexing and parsing together: the parser lexes its whole input up front
+  void BM_Parse(benchmark::State &state) {
+    auto source = large_source();
+    measure(state, 0, [&]() {
+      for (auto _: state) {
+        auto program = CompiledProgram::compile(source);
+        if (!program.has_value()) state.SkipWithError("parse failed");
+        benchmark::DoNotOptimize(program);
+      }
+    });
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+  }
+  BENCHMARK(BM_Parse)->Unit(benchmark::kMillisecond);
+
+  // Statements one run of call executes, counted by the tree walker since compiled code does not count
+  double statements_per_run(const std::string &setup, const std::string &call) {
+    IsolateConfig config;
+    config.jit.enabled = false;
+    Isolate isolate(config);
+    isolate.run(setup);
+    auto compiled = CompiledProgram::compile(call);
+    if (!compiled.has_value()) return 0;
+    start_counting();
+    isolate.run(compiled.value());
+    double statements = 0;
+    for (auto &[line, counted]: stop_counting().lines) statements += static_cast<double>(counted.count);
+    return statements;
+  }
+
+  // Runs setup once, then call on every iteration. The first argument turns the JIT off (0) or on (1)
+  void run_workload(benchmark::State &state, const std::string &setup, const std::string &call) {
+    IsolateConfig config;
+    config.jit.enabled = state.range(0) != 0;
+    Isolate isolate(config);
+    auto compiled = CompiledProgram::compile(call);
+    if (!isolate.run(setup).has_value() || !compiled.has_value()) {
+      state.SkipWithError("setup failed");
+      return;
+    }
+    auto statements = use_perf_counters ? statements_per_run(setup, call) : 0;
+    measure(state, statements, [&]() {
+      for (auto _: state) {
+        auto result = isolate.run(compiled.value());
+        if (!result.has_value()) state.SkipWithError("run failed");
+        benchmark::DoNotOptimize(result);
+      }
+    });
+  }
+
+  void BM_Fib(benchmark::State &state) {
+    run_workload(state, "let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) };", "fib(20);");
+  }
+  BENCHMARK(BM_Fib)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+  void BM_Closures(benchmark::State &state) {
+    run_workload(state, R""""(
+      let z = fn(x) { let a = 4; let b = 5; return a + b + x; };
+      let newAdder = fn(x) { fn(y) { x + y + z(x) } };
+      let run = fn(i, n, total) { if (i < n) { run(i + 1, n, total + newAdder(i)(2)) } else { total } };
+    )"""", "run(0, 1000, 0);");
+  }
+  BENCHMARK(BM_Closures)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+  void BM_StringConcat(benchmark::State &state) {
+    run_workload(state, R""""(
+      let build = fn(s, i, n) { if (i < n) { build(s + "<td>cell</td>", i + 1, n) } else { s } };
+    )"""", "build(\"\", 0, 1000)[0];");
+  }
+  BENCHMARK(BM_StringConcat)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+  void BM_DeepRecursion(benchmark::State &state) {
+    run_workload(state, "let down = fn(n) { if (n < 1) { 0 } else { 1 + down(n - 1) } };", "down(2000);");
+  }
+  BENCHMARK(BM_DeepRecursion)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+}// namespace
+
+int main(int argc, char **argv) {
+  // Take out our own flag before the library sees the rest
+  int kept = 1;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--perf-counters") == 0) {
+      use_perf_counters = true;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argc = kept;
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,38 @@
+//
+// Writes a generated Monke program to stdout, see program_generator.h.
+//
+// Usage: monke_gen [shape] [bytes] [seed] [--depth=N] [--string-length=N]
+//        shapes: statements, nesting, strings, closures, mixed (the default)
+//
+
+#include <iostream>
+#include <vector>
+
+#include "program_generator.h"
+
+int main(int argc, char **argv) {
+  GeneratorOptions options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.starts_with("--depth=")) {
+      options.depth = std::stoull(arg.substr(std::string("--depth=").size()));
+    } else if (arg.starts_with("--string-length=")) {
+      options.string_length = std::stoull(arg.substr(std::string("--string-length=").size()));
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() > 0) {
+    auto shape = parse_program_shape(positional[0]);
+    if (!shape.has_value()) {
+      std::cerr << "unknown shape: " << positional[0] << std::endl;
+      return 1;
+    }
+    options.shape = shape.value();
+  }
+  if (positional.size() > 1) options.bytes = std::stoull(positional[1]);
+  if (positional.size() > 2) options.seed = std::stoull(positional[2]);
+  std::cout << generate_program(options);
+  return 0;
+}
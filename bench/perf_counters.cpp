@@ -0,0 +1,115 @@
+//
+// Hardware performance counters of the calling thread, through perf_event_open.
+//
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf_counters.h"
+
+namespace {
+  void describe(PerfEvent event, perf_event_attr &attr) {
+    switch (event) {
+      case PerfEvent::Cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case PerfEvent::Instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case PerfEvent::BranchMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case PerfEvent::L1dMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      case PerfEvent::LlcMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    }
+  }
+
+  int open_counter(PerfEvent event) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    describe(event, attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+  }
+}// namespace
+
+std::string_view perf_event_name(PerfEvent event) {
+  switch (event) {
+    case PerfEvent::Cycles:
+      return "cycles";
+    case PerfEvent::Instructions:
+      return "instructions";
+    case PerfEvent::BranchMisses:
+      return "branch-misses";
+    case PerfEvent::L1dMisses:
+      return "L1d-misses";
+    case PerfEvent::LlcMisses:
+      return "LLC-misses";
+  }
+  return "";
+}
+
+PerfCounters::PerfCounters() {
+  for (size_t i = 0; i < PERF_EVENTS; i++) {
+    auto event = static_cast<PerfEvent>(i);
+    fds[i] = open_counter(event);
+    if (fds[i] < 0 && error_.empty()) {
+      error_ = std::format("perf_event_open({}): {}", perf_event_name(event), std::strerror(errno));
+    }
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd: fds) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+bool PerfCounters::available() const {
+  for (int fd: fds) {
+    if (fd >= 0) return true;
+  }
+  return false;
+}
+
+void PerfCounters::start() {
+  for (int fd: fds) {
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void PerfCounters::stop() {
+  for (int fd: fds) {
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+}
+
+std::optional<double> PerfCounters::value(PerfEvent event) const {
+  int fd = fds[static_cast<size_t>(event)];
+  if (fd < 0) return std::nullopt;
+  // The count, then the time the counter was enabled and the time it was actually on the PMU
+  uint64_t values[3];
+  if (read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0) return std::nullopt;
+  return static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+}
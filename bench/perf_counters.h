@@ -0,0 +1,56 @@
+//
+// Hardware performance counters of the calling thread, through perf_event_open.
+//
+// Each counter is opened on its own rather than as a group, so the kernel can multiplex them when there are more
+// than the PMU has registers; values are scaled by the fraction of the time a counter was actually counting. Counters
+// that cannot be opened, because the machine has no PMU or perf_event_paranoid forbids it, are left out.
+//
+
+#ifndef MONKE_CPP_PERF_COUNTERS_H
+#define MONKE_CPP_PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+enum class PerfEvent {
+  Cycles,
+  Instructions,
+  BranchMisses,
+  // Level 1 data cache read misses
+  L1dMisses,
+  // Last level cache misses
+  LlcMisses,
+};
+
+constexpr size_t PERF_EVENTS = static_cast<size_t>(PerfEvent::LlcMisses) + 1;
+
+std::string_view perf_event_name(PerfEvent event);
+
+class PerfCounters {
+  public:
+  // Opens every counter it can, user space only
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  // Whether any counter could be opened. If not, why the first one could not
+  bool available() const;
+  const std::string &error() const { return error_; }
+
+  // Reset and enable every counter, or disable them
+  void start();
+  void stop();
+
+  // What the counter counted between start and stop, nullopt if it is not open or never got scheduled
+  std::optional<double> value(PerfEvent event) const;
+
+  private:
+  std::array<int, PERF_EVENTS> fds;
+  std::string error_;
+};
+
+#endif//MONKE_CPP_PERF_COUNTERS_H
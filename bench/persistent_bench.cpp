@@ -0,0 +1,60 @@
+//
+// Building arrays and hashes one functional update at a time, where every intermediate version stays reachable.
+//
+// Copying the whole container on each update makes this quadratic; with the persistent representations the time per
+// element should stay roughly flat as n grows.
+//
+// Usage: persistent_bench [largest n]
+//
+// The Monke builders recurse once per element, so sizes past a few thousand need a larger stack (ulimit -s).
+//
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "isolate.h"
+#include "persistent_vector.h"
+
+namespace {
+  template<typename F>
+  double nanoseconds_per(size_t n, F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(n);
+  }
+}// namespace
+
+int main(int argc, char **argv) {
+  size_t largest = argc > 1 ? std::stoull(argv[1]) : 2000;
+
+  Isolate isolate;
+  auto setup = R""""(
+    let build_array = fn(a, i, n) { if (i < n) { build_array(push(a, i), i + 1, n) } else { len(a) } };
+    let build_hash = fn(h, i, n) { if (i < n) { build_hash(put(h, i, i), i + 1, n) } else { len(h) } };
+  )"""";
+  if (!isolate.run(setup).has_value()) return 1;
+
+  std::cout << std::format("{:>8} {:>16} {:>16} {:>16} {:>16}\n", "n", "copy push ns", "trie push ns", "Monke push ns", "Monke put ns");
+  for (size_t n = 500; n <= largest; n *= 2) {
+    // Every version kept alive, as the frames of a recursive builder keep theirs
+    double copied = nanoseconds_per(n, [&]() {
+      std::vector<std::vector<int64_t>> versions(1);
+      for (size_t i = 0; i < n; i++) {
+        auto next = versions.back();
+        next.push_back(static_cast<int64_t>(i));
+        versions.push_back(std::move(next));
+      }
+    });
+    double trie = nanoseconds_per(n, [&]() {
+      std::vector<PersistentVector<int64_t>> versions(1);
+      for (size_t i = 0; i < n; i++) versions.push_back(versions.back().push(static_cast<int64_t>(i)));
+    });
+    double array = nanoseconds_per(n, [&]() { isolate.run(std::format("build_array([], 0, {});", n)); });
+    double hash = nanoseconds_per(n, [&]() { isolate.run(std::format("build_hash({{}}, 0, {});", n)); });
+    std::cout << std::format("{:>8} {:>16.1f} {:>16.1f} {:>16.1f} {:>16.1f}\n", n, copied, trie, array, hash);
+  }
+  return 0;
+}
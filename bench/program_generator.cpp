@@ -0,0 +1,137 @@
+//
+// Deterministic generator of large Monke programs.
+//
+
+#include <array>
+#include <format>
+#include <random>
+#include <vector>
+
+#include "program_generator.h"
+
+namespace {
+  constexpr std::array<std::pair<std::string_view, ProgramShape>, 5> SHAPES = {{
+          {"statements", ProgramShape::Statements},
+          {"nesting", ProgramShape::Nesting},
+          {"strings", ProgramShape::Strings},
+          {"closures", ProgramShape::Closures},
+          {"mixed", ProgramShape::Mixed},
+  }};
+
+  // Identifiers may not contain digits, so indices are spelled in letters
+  std::string name(std::string_view prefix, size_t i) {
+    std::string out(prefix);
+    do {
+      out += static_cast<char>('a' + i % 26);
+      i /= 26;
+    } while (i > 0);
+    return out;
+  }
+
+  class Generator {
+    public:
+    explicit Generator(const GeneratorOptions &options) : options(options), rng(options.seed) {}
+
+    std::string run() {
+      out.reserve(options.bytes + 2 * options.string_length);
+      out += "let seed = 0;\n";
+      for (size_t i = 0; out.size() < options.bytes; i++) {
+        auto shape = options.shape;
+        if (shape == ProgramShape::Mixed) shape = SHAPES[i % (SHAPES.size() - 1)].second;
+        switch (shape) {
+          case ProgramShape::Statements:
+            statement();
+            break;
+          case ProgramShape::Nesting:
+            nesting();
+            break;
+          case ProgramShape::Strings:
+            string();
+            break;
+          case ProgramShape::Closures:
+          case ProgramShape::Mixed:
+            closure();
+            break;
+        }
+      }
+      return std::move(out);
+    }
+
+    private:
+    const GeneratorOptions &options;
+    std::mt19937_64 rng;
+    std::string out;
+    size_t statements = 0;
+    size_t nests = 0;
+    size_t strings = 0;
+    size_t closures = 0;
+
+    int64_t small() { return static_cast<int64_t>(rng() % 1000); }
+
+    void statement() {
+      auto previous = statements == 0 ? std::string("seed") : name("v", statements - 1);
+      out += std::format("let {} = {} + {} * ({} - {});\n", name("v", statements), previous, small(), small(), small());
+      statements++;
+    }
+
+    void nesting() {
+      out += std::format("let {} = ", name("n", nests++));
+      std::vector<std::string> closings;
+      for (size_t level = 0; level < options.depth; level++) {
+        switch (rng() % 3) {
+          case 0:
+            out += std::format("if (seed < {}) {{ ", small());
+            closings.push_back(std::format(" }} else {{ {} }}", small()));
+            break;
+          case 1:
+            out += "[";
+            closings.push_back("][0]");
+            break;
+          default:
+            out += std::format("({} + ", small());
+            closings.push_back(")");
+            break;
+        }
+      }
+      out += std::format("{}", small());
+      for (auto closing = closings.rbegin(); closing != closings.rend(); closing++) out += *closing;
+      out += ";\n";
+    }
+
+    void string() {
+      static constexpr std::string_view WORDS[] = {"lorem", "ipsum", "dolor", "sit", "amet", "monke", "banana", "<td>", "</td>"};
+      out += std::format("let {} = \"", name("s", strings++));
+      size_t start = out.size();
+      while (out.size() - start < options.string_length) {
+        out += WORDS[rng() % std::size(WORDS)];
+        out += ' ';
+      }
+      out += "\";\n";
+    }
+
+    void closure() {
+      auto factory = name("f", closures);
+      out += std::format("let {} = fn(a, b) {{ let c = a * {}; fn(x) {{ if (x < b) {{ x + c }} else {{ c - x }} }} }};\n", factory, small());
+      out += std::format("let {} = {}({}, {})({});\n", name("g", closures), factory, small(), small(), small());
+      closures++;
+    }
+  };
+}// namespace
+
+std::optional<ProgramShape> parse_program_shape(std::string_view name) {
+  for (const auto &[shape_name, shape]: SHAPES) {
+    if (shape_name == name) return shape;
+  }
+  return std::nullopt;
+}
+
+std::string_view program_shape_name(ProgramShape shape) {
+  for (const auto &[shape_name, candidate]: SHAPES) {
+    if (candidate == shape) return shape_name;
+  }
+  return "";
+}
+
+std::string generate_program(const GeneratorOptions &options) {
+  return Generator(options).run();
+}
@@ -0,0 +1,44 @@
+//
+// Deterministic generator of large Monke programs, for front end scaling measurements.
+//
+
+#ifndef MONKE_CPP_PROGRAM_GENERATOR_H
+#define MONKE_CPP_PROGRAM_GENERATOR_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+enum class ProgramShape {
+  // A long list of small let statements, each using the one before
+  Statements,
+  // Statements of nested if expressions, array literals and parentheses, depth levels deep
+  Nesting,
+  // Lets of large string literals
+  Strings,
+  // Closure factories and their applications
+  Closures,
+  // All of the above in turn
+  Mixed
+};
+
+class GeneratorOptions {
+  public:
+  ProgramShape shape = ProgramShape::Mixed;
+  // The program is at least this long, and at most one statement longer
+  size_t bytes = size_t(1) << 20;
+  uint64_t seed = 1;
+  // Nesting levels per statement of the Nesting shape. The parser recurses once or more per level
+  size_t depth = 32;
+  // Characters per literal of the Strings shape
+  size_t string_length = 4096;
+};
+
+std::optional<ProgramShape> parse_program_shape(std::string_view name);
+std::string_view program_shape_name(ProgramShape shape);
+
+// A program that parses and evaluates without errors. Equal options always give the same program
+std::string generate_program(const GeneratorOptions &options);
+
+#endif//MONKE_CPP_PROGRAM_GENERATOR_H
@@ -0,0 +1,62 @@
+//
+// Building a string out of many small fragments by repeated +, as templating code does.
+//
+// Copying both sides on every + makes this quadratic in the number of fragments; with ropes each + is O(1) and the
+// result is flattened once, when its characters are first read.
+//
+// Usage: rope_bench [fragments]
+//
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+
+#include "isolate.h"
+#include "rope.h"
+
+namespace {
+  template<typename F>
+  double milliseconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+}// namespace
+
+int main(int argc, char **argv) {
+  size_t fragments = argc > 1 ? std::stoull(argv[1]) : 100000;
+  const std::string fragment = "<td>cell</td>";
+
+  // What + did before: a new string holding a copy of both sides. A tenth of the fragments, all of them take many seconds
+  size_t few = fragments / 10;
+  double copied = milliseconds([&]() {
+    std::string s;
+    for (size_t i = 0; i < few; i++) s = s + fragment;
+  });
+
+  std::shared_ptr<const Rope> rope = std::make_shared<Rope>("");
+  auto piece = std::make_shared<const Rope>(fragment);
+  double linked = milliseconds([&]() {
+    for (size_t i = 0; i < fragments; i++) rope = Rope::concat(rope, piece);
+  });
+  double flattened = milliseconds([&]() { rope->flat(); });
+  if (rope->size() != fragments * fragment.size()) return 1;
+
+  // The same through the interpreter, in chunks short enough to recurse through
+  Isolate isolate;
+  auto setup = std::format(R""""(
+    let chunk = fn(s, i, n) {{ if (i < n) {{ chunk(s + "{}", i + 1, n) }} else {{ s }} }};
+    let build = fn(s, k, n) {{ if (k < n) {{ build(chunk(s, 0, 1000), k + 1, n) }} else {{ s }} }};
+  )"""", fragment);
+  if (!isolate.run(setup).has_value()) return 1;
+  double monke = milliseconds([&]() { isolate.run(std::format("build(\"\", 0, {})[0];", fragments / 1000)); });
+
+  std::cout << std::format("{} fragments of {} bytes\n", fragments, fragment.size());
+  std::cout << std::format("{:>24} {:>10.2f} ms  ({} fragments)\n", "copying +", copied, few);
+  std::cout << std::format("{:>24} {:>10.2f} ms\n", "rope +", linked);
+  std::cout << std::format("{:>24} {:>10.2f} ms\n", "rope flatten", flattened);
+  std::cout << std::format("{:>24} {:>10.2f} ms\n", "Monke + and flatten", monke);
+  return 0;
+}
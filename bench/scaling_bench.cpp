@@ -0,0 +1,132 @@
+//
+// How lexing, parsing and error positions scale with the size of the input.
+//
+// For every shape of generated program and input sizes doubling up to the largest, a child process generates the
+// program, times the lexer, the parser (which lexes again) and get_position for the last character, then reports its
+// peak RSS. Front end work should be linear, so ns/byte ought to stay flat; a shape whose largest input costs more than
+// twice as much per byte as its smallest is flagged as superlinear.
+//
+// Usage: scaling_bench [largest MB] [--csv]
+//
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "compiled_program.h"
+#include "lexer.h"
+#include "program_generator.h"
+
+namespace {
+  class Measurement {
+    public:
+    double lex_ms = 0;
+    double parse_ms = 0;
+    double position_ms = 0;
+    size_t tokens = 0;
+    // Kilobytes, as getrusage reports it
+    long peak_rss = 0;
+    bool ok = false;
+  };
+
+  template<typename F>
+  double milliseconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+
+  Measurement measure(const GeneratorOptions &options) {
+    Measurement m;
+    auto source = generate_program(options);
+    m.lex_ms = milliseconds([&]() {
+      Lexer lexer(source);
+      while (true) {
+        auto token = lexer.next_token();
+        if (!token.has_value() || token.value().ttype == EOF_) break;
+        m.tokens++;
+      }
+    });
+    bool parsed = false;
+    m.parse_ms = milliseconds([&]() { parsed = CompiledProgram::compile(source).has_value(); });
+    m.position_ms = milliseconds([&]() { get_position(source, source.size() - 1); });
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    m.peak_rss = usage.ru_maxrss;
+    m.ok = parsed;
+    return m;
+  }
+
+  // In a child, so each size starts from a fresh heap and its peak RSS is its own
+  Measurement measure_in_child(const GeneratorOptions &options) {
+    int fds[2];
+    if (pipe(fds) != 0) return {};
+    auto pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      auto m = measure(options);
+      auto written = write(fds[1], &m, sizeof(m));
+      _exit(written == sizeof(m) ? 0 : 1);
+    }
+    close(fds[1]);
+    Measurement m;
+    if (pid < 0 || read(fds[0], &m, sizeof(m)) != sizeof(m)) m = {};
+    close(fds[0]);
+    if (pid > 0) waitpid(pid, nullptr, 0);
+    return m;
+  }
+}// namespace
+
+int main(int argc, char **argv) {
+  size_t largest = 16;
+  bool csv = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--csv") {
+      csv = true;
+    } else {
+      largest = std::stoull(arg);
+    }
+  }
+
+  if (csv) {
+    std::cout << "shape,bytes,tokens,lex_ms,parse_ms,position_ms,peak_rss_kb\n";
+  } else {
+    std::cout << std::format("{:>10} {:>8} {:>10} {:>10} {:>10} {:>10} {:>12} {:>12}\n", "shape", "MB", "lex ms", "parse ms",
+                             "pos ms", "parse ns/B", "peak RSS MB", "RSS/input");
+  }
+  for (auto shape: {ProgramShape::Statements, ProgramShape::Nesting, ProgramShape::Strings, ProgramShape::Closures, ProgramShape::Mixed}) {
+    std::vector<double> per_byte;
+    for (size_t mb = 1; mb <= largest; mb *= 2) {
+      GeneratorOptions options;
+      options.shape = shape;
+      options.bytes = mb << 20;
+      auto m = measure_in_child(options);
+      auto name = program_shape_name(shape);
+      if (!m.ok) {
+        std::cerr << std::format("{} at {} MB did not parse\n", name, mb);
+        return 1;
+      }
+      double bytes = static_cast<double>(options.bytes);
+      per_byte.push_back((m.lex_ms + m.parse_ms) * 1e6 / bytes);
+      if (csv) {
+        std::cout << std::format("{},{},{},{:.3f},{:.3f},{:.3f},{}\n", name, options.bytes, m.tokens, m.lex_ms, m.parse_ms, m.position_ms, m.peak_rss);
+      } else {
+        double rss = static_cast<double>(m.peak_rss) / 1024.0;
+        std::cout << std::format("{:>10} {:>8} {:>10.1f} {:>10.1f} {:>10.2f} {:>10.1f} {:>12.1f} {:>11.1f}x\n", name, mb, m.lex_ms,
+                                 m.parse_ms, m.position_ms, m.parse_ms * 1e6 / bytes, rss, rss / static_cast<double>(mb));
+      }
+    }
+    if (per_byte.size() > 1 && per_byte.back() > 2 * per_byte.front()) {
+      std::cerr << std::format("{}: superlinear, {:.1f} ns/byte at the largest size against {:.1f} at the smallest\n",
+                               program_shape_name(shape), per_byte.back(), per_byte.front());
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+//
+// The vectorized kernels at each supported level against a naive loop, and sum() against the same reduction written in Monke.
+//
+// Usage: simd_bench [elements] [repetitions]
+//
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "isolate.h"
+#include "simd.h"
+
+namespace {
+  template<typename F>
+  double seconds(size_t reps, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < reps; i++) f();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(reps);
+  }
+
+  // Kept out of line and behind volatile so the compiler cannot vectorize or drop it
+  template<typename T>
+  [[gnu::noinline]] T naive_dot(const T *a, const T *b, size_t n) {
+    T total = 0;
+    for (size_t i = 0; i < n; i++) {
+      total += a[i] * b[i];
+      asm volatile("" : "+r"(total));
+    }
+    return total;
+  }
+
+  template<typename T>
+  [[gnu::noinline]] T naive_sum(const T *a, size_t n) {
+    T total = 0;
+    for (size_t i = 0; i < n; i++) {
+      total += a[i];
+      asm volatile("" : "+r"(total));
+    }
+    return total;
+  }
+}// namespace
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? std::stoull(argv[1]) : 4096;
+  size_t reps = argc > 2 ? std::stoull(argv[2]) : 20000;
+
+  std::vector<int64_t> ints(n);
+  std::vector<double> floats(n);
+  for (size_t i = 0; i < n; i++) {
+    ints[i] = static_cast<int64_t>(i % 1000);
+    floats[i] = static_cast<double>(i % 1000) * 0.5;
+  }
+
+  volatile int64_t int_sink = 0;
+  volatile double float_sink = 0;
+  std::cout << std::format("{} elements, detected {}\n", n, simd_level_name(supported_simd_level()));
+  std::cout << std::format("{:>10} {:>14} {:>14} {:>14} {:>14}\n", "", "sum i64 ns", "dot i64 ns", "sum f64 ns", "dot f64 ns");
+  auto row = [&](const char *name, double a, double b, double c, double d) {
+    std::cout << std::format("{:>10} {:>14.1f} {:>14.1f} {:>14.1f} {:>14.1f}\n", name, a * 1e9, b * 1e9, c * 1e9, d * 1e9);
+  };
+  row("naive",
+      seconds(reps, [&]() { int_sink = naive_sum(ints.data(), n); }),
+      seconds(reps, [&]() { int_sink = naive_dot(ints.data(), ints.data(), n); }),
+      seconds(reps, [&]() { float_sink = naive_sum(floats.data(), n); }),
+      seconds(reps, [&]() { float_sink = naive_dot(floats.data(), floats.data(), n); }));
+  for (auto level: {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2}) {
+    if (level > supported_simd_level()) break;
+    auto &k = simd_kernels(level);
+    row(simd_level_name(level),
+        seconds(reps, [&]() { int_sink = k.i64.sum(ints.data(), n); }),
+        seconds(reps, [&]() { int_sink = k.i64.dot(ints.data(), ints.data(), n); }),
+        seconds(reps, [&]() { float_sink = k.f64.sum(floats.data(), n); }),
+        seconds(reps, [&]() { float_sink = k.f64.dot(floats.data(), floats.data(), n); }));
+  }
+
+  // The same reduction from Monke: a builtin call over a vec against a recursive loop over an array
+  size_t small = std::min<size_t>(n, 1000);
+  std::string elements;
+  for (size_t i = 0; i < small; i++) {
+    elements += std::format("{}{}", i == 0 ? "" : ", ", i);
+  }
+  Isolate isolate;
+  auto setup = std::format("let v = vec([{0}]); let a = [{0}]; let total = fn(i) {{ if (i < len(a)) {{ a[i] + total(i + 1) }} else {{ 0 }} }};", elements);
+  if (!isolate.run(setup).has_value()) return 1;
+  double builtin_time = seconds(100, [&]() { isolate.run("sum(v);"); });
+  double recursive_time = seconds(100, [&]() { isolate.run("total(0);"); });
+  std::cout << std::format("\nMonke, {} elements: sum(vec) {:.3f} ms, recursive {:.3f} ms ({:.1f}x)\n", small, builtin_time * 1e3, recursive_time * 1e3, recursive_time / builtin_time);
+  (void) int_sink;
+  (void) float_sink;
+  return 0;
+}
@@ -0,0 +1,34 @@
+# Ahead of time builds of Monke programs. monke_cpp --emit-cpp translates the sources into one C++ file,
+# which is then compiled against monke_core like any other target.
+#
+#   monke_add_executable(<target> <file.monke>...)  native program printing each script's result
+#   monke_add_library(<target> <file.monke>...)     shared library exposing <target>::monke_program_<i>
+
+function(_monke_transpile target out_var)
+    set(sources)
+    foreach(source ${ARGN})
+        get_filename_component(abs ${source} ABSOLUTE)
+        list(APPEND sources ${abs})
+    endforeach()
+    set(generated ${CMAKE_CURRENT_BINARY_DIR}/${target}.monke.cpp)
+    add_custom_command(
+            OUTPUT ${generated}
+            COMMAND monke_cpp --emit-cpp=${generated} ${sources}
+            DEPENDS monke_cpp ${sources}
+            COMMENT "Transpiling ${target}"
+            VERBATIM)
+    set(${out_var} ${generated} PARENT_SCOPE)
+endfunction()
+
+function(monke_add_executable target)
+    _monke_transpile(${target} generated ${ARGN})
+    add_executable(${target} ${generated})
+    target_link_libraries(${target} monke_core spdlog::spdlog)
+endfunction()
+
+function(monke_add_library target)
+    _monke_transpile(${target} generated ${ARGN})
+    add_library(${target} SHARED ${generated})
+    target_compile_definitions(${target} PRIVATE MONKE_NO_MAIN MONKE_NAMESPACE=${target})
+    target_link_libraries(${target} monke_core spdlog::spdlog)
+endfunction()
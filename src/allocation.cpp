@@ -0,0 +1,194 @@
+//
+// Accounting of the interpreter's heap allocations.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "allocation.h"
+#include "profiler.h"
+
+std::atomic<bool> allocation_tracking = false;
+thread_local AllocationSite allocation_site = AllocationSite::Other;
+thread_local const std::string *allocation_function = nullptr;
+
+namespace {
+  // The bookkeeping must not allocate through operator new, or recording an allocation would record another
+  template <typename T>
+  class MallocAllocator {
+    public:
+    using value_type = T;
+    MallocAllocator() = default;
+    template <typename U>
+    MallocAllocator(const MallocAllocator<U> &) {}
+    T *allocate(size_t n) {
+      auto *p = static_cast<T *>(std::malloc(n * sizeof(T)));
+      if (p == nullptr) throw std::bad_alloc();
+      return p;
+    }
+    void deallocate(T *p, size_t) { std::free(p); }
+    template <typename U>
+    bool operator==(const MallocAllocator<U> &) const { return true; }
+  };
+
+  template <typename K, typename V>
+  using MallocMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, MallocAllocator<std::pair<const K, V>>>;
+
+  class LiveAllocation {
+    public:
+    size_t size;
+    AllocationSite site;
+    const std::string *function;
+  };
+
+  class AllocationTables {
+    public:
+    std::mutex mutex;
+    std::array<AllocationCounts, ALLOCATION_SITES> sites;
+    MallocMap<const std::string *, AllocationCounts> functions;
+    MallocMap<void *, LiveAllocation> live;
+    uint64_t live_bytes = 0;
+    uint64_t peak = 0;
+  };
+
+  // Created before tracking first starts and never destroyed, frees may still arrive while statics are torn down
+  AllocationTables *tables = nullptr;
+
+  void add(AllocationCounts &counts, size_t size) {
+    counts.count++;
+    counts.bytes += size;
+    counts.live += size;
+    counts.peak = std::max(counts.peak, counts.live);
+  }
+
+  void record_allocation(void *p, size_t size) {
+    std::lock_guard lock(tables->mutex);
+    add(tables->sites[static_cast<size_t>(allocation_site)], size);
+    add(tables->functions[allocation_function], size);
+    tables->live_bytes += size;
+    tables->peak = std::max(tables->peak, tables->live_bytes);
+    tables->live[p] = {size, allocation_site, allocation_function};
+  }
+
+  void record_free(void *p) {
+    std::lock_guard lock(tables->mutex);
+    auto it = tables->live.find(p);
+    if (it == tables->live.end()) return;
+    auto &[size, site, function] = it->second;
+    tables->sites[static_cast<size_t>(site)].live -= size;
+    tables->functions[function].live -= size;
+    tables->live_bytes -= size;
+    tables->live.erase(it);
+  }
+}// namespace
+
+void *operator new(std::size_t size) {
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) throw std::bad_alloc();
+  if (allocation_tracking.load(std::memory_order_relaxed)) record_allocation(p, size);
+  return p;
+}
+
+void *operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  if (p != nullptr && allocation_tracking.load(std::memory_order_relaxed)) record_free(p);
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  ::operator delete(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  ::operator delete(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  ::operator delete(p);
+}
+
+const char *allocation_site_name(AllocationSite site) {
+  switch (site) {
+    case AllocationSite::Other:
+      return "other";
+    case AllocationSite::Parse:
+      return "parse";
+    case AllocationSite::Environment:
+      return "environment";
+    case AllocationSite::Binding:
+      return "binding";
+    case AllocationSite::String:
+      return "string";
+    case AllocationSite::ReturnValue:
+      return "return value";
+    case AllocationSite::Arguments:
+      return "arguments";
+    case AllocationSite::Collection:
+      return "collection";
+    case AllocationSite::Closure:
+      return "closure";
+  }
+  return "";
+}
+
+void start_allocation_tracking() {
+  if (tables == nullptr) tables = new (std::malloc(sizeof(AllocationTables))) AllocationTables();
+  {
+    std::lock_guard lock(tables->mutex);
+    tables->sites = {};
+    tables->functions.clear();
+    tables->live.clear();
+    tables->live_bytes = 0;
+    tables->peak = 0;
+  }
+  allocation_tracking = true;
+}
+
+AllocationReport stop_allocation_tracking() {
+  allocation_tracking = false;
+  AllocationReport report;
+  if (tables == nullptr) return report;
+  // Nothing records any more, so building the report may allocate while holding the lock
+  std::lock_guard lock(tables->mutex);
+  report.sites = tables->sites;
+  report.peak = tables->peak;
+  for (auto &[function, counts]: tables->functions) {
+    report.functions[function != nullptr ? *function : PROFILER_TOP_LEVEL] = counts;
+  }
+  return report;
+}
+
+std::string print_allocation_report(const AllocationReport &report, size_t top) {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  for (auto &site: report.sites) {
+    count += site.count;
+    bytes += site.bytes;
+  }
+  std::string out = "";
+  out += std::format("allocations: {} totalling {} bytes, peak {} bytes live\n", count, bytes, report.peak);
+  out += std::format("{:>12} {:>14} {:>14}  {}\n", "count", "bytes", "peak live", "site");
+  for (size_t i = 0; i < ALLOCATION_SITES; i++) {
+    auto &site = report.sites[i];
+    out += std::format("{:>12} {:>14} {:>14}  {}\n", site.count, site.bytes, site.peak, allocation_site_name(static_cast<AllocationSite>(i)));
+  }
+
+  std::vector<std::pair<std::string, AllocationCounts>> rows(report.functions.begin(), report.functions.end());
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+    return a.second.bytes != b.second.bytes ? a.second.bytes > b.second.bytes : a.first < b.first;
+  });
+  out += std::format("{:>12} {:>14} {:>14}  {}\n", "count", "bytes", "peak live", "function");
+  for (size_t i = 0; i < std::min(top, rows.size()); i++) {
+    auto &[name, counts] = rows[i];
+    out += std::format("{:>12} {:>14} {:>14}  {}\n", counts.count, counts.bytes, counts.peak, name);
+  }
+  return out;
+}
@@ -0,0 +1,108 @@
+//
+// Accounting of the interpreter's heap allocations.
+//
+// monke_core replaces the global operator new and delete. While tracking, every allocation is recorded with the site
+// the allocating thread is in, set by an AllocationScope around the interpreter code that allocates, and the Monke
+// function it is running. When not tracking the replacements only check a flag before calling malloc and free.
+//
+
+#ifndef MONKE_CPP_ALLOCATION_H
+#define MONKE_CPP_ALLOCATION_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+enum class AllocationSite : uint8_t {
+  // Anything not in a scope below
+  Other,
+  // Lexing, parsing and the AST
+  Parse,
+  // The scopes created for calls and programs
+  Environment,
+  // Bindings added to a scope
+  Binding,
+  // String contents that do not fit inline, and concatenation
+  String,
+  // Objects boxed by return statements
+  ReturnValue,
+  // Argument lists of calls
+  Arguments,
+  // Array and hash literals
+  Collection,
+  // Functions created by function literals
+  Closure,
+};
+
+constexpr size_t ALLOCATION_SITES = static_cast<size_t>(AllocationSite::Closure) + 1;
+
+class AllocationCounts {
+  public:
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  // Bytes allocated while tracking and not freed yet, and the most there ever were
+  uint64_t live = 0;
+  uint64_t peak = 0;
+};
+
+class AllocationReport {
+  public:
+  std::array<AllocationCounts, ALLOCATION_SITES> sites;
+  // By the Monke function that was running, top level code under PROFILER_TOP_LEVEL
+  std::map<std::string, AllocationCounts> functions;
+  // Over every site
+  uint64_t peak = 0;
+};
+
+extern std::atomic<bool> allocation_tracking;
+extern thread_local AllocationSite allocation_site;
+extern thread_local const std::string *allocation_function;
+
+// Attributes the thread's allocations to a site for as long as it is in scope. A single branch when not tracking
+class AllocationScope {
+  public:
+  explicit AllocationScope(AllocationSite site) : previous(allocation_site), entered(allocation_tracking.load(std::memory_order_relaxed)) {
+    if (entered) allocation_site = site;
+  }
+  ~AllocationScope() {
+    if (entered) allocation_site = previous;
+  }
+  AllocationScope(const AllocationScope &) = delete;
+  AllocationScope &operator=(const AllocationScope &) = delete;
+
+  private:
+  AllocationSite previous;
+  bool entered;
+};
+
+// Attributes the thread's allocations to a Monke function for as long as it is in scope. name must outlive the report
+class AllocationFunction {
+  public:
+  explicit AllocationFunction(const std::string *name) : previous(allocation_function), entered(allocation_tracking.load(std::memory_order_relaxed)) {
+    if (entered) allocation_function = name;
+  }
+  ~AllocationFunction() {
+    if (entered) allocation_function = previous;
+  }
+  AllocationFunction(const AllocationFunction &) = delete;
+  AllocationFunction &operator=(const AllocationFunction &) = delete;
+
+  private:
+  const std::string *previous;
+  bool entered;
+};
+
+const char *allocation_site_name(AllocationSite site);
+
+// Forget what was recorded before and start recording every allocation
+void start_allocation_tracking();
+
+// Stop recording. Allocations made while tracking and freed later are not subtracted from live
+AllocationReport stop_allocation_tracking();
+
+// Count, bytes and peak live bytes of every site, then the functions that allocated the most bytes
+std::string print_allocation_report(const AllocationReport &report, size_t top = 20);
+
+#endif//MONKE_CPP_ALLOCATION_H
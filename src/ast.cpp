@@ -5,6 +5,7 @@
 #include "ast.h"
 #include "token.h"
 #include "utils.h"
+#include <atomic>
 #include <format>
 #include <iostream>
 
@@ -24,6 +25,8 @@ std::optional<precedence> get_precedence(token_t t) {
       return precedence::product;
     case ::LPAREN:
       return precedence::call;
+    case ::LBRACKET:
+      return precedence::index;
     default:
       return std::nullopt;
   }
@@ -42,6 +45,17 @@ std::string ExpressionStatement::string() {
   return ::string(e);
 }
 
+const std::string *callee_symbol(Expression *function) {
+  static const std::string *anonymous = intern("anonymous");
+  if (auto *ident = std::get_if<Identifier>(function)) return intern(ident->token.literal);
+  return anonymous;
+}
+
+uint64_t next_node_id() {
+  static std::atomic<uint64_t> next = 1;
+  return next++;
+}
+
 std::string CallExpression::string() {
   std::vector<std::string> args;
   std::transform(arguments.begin(), arguments.end(), std::back_inserter(args), [](const auto e){return ::string(*e); });
@@ -55,6 +69,22 @@ std::string CallExpression::string() {
   });
 }
 
+std::string ArrayLiteral::string() {
+  std::vector<std::string> values;
+  std::transform(elements.begin(), elements.end(), std::back_inserter(values), [](const auto e) { return ::string(*e); });
+  return str_join({"[", str_join(values, ", "), "]"});
+}
+
+std::string HashLiteral::string() {
+  std::vector<std::string> values;
+  std::transform(pairs.begin(), pairs.end(), std::back_inserter(values), [](const auto &p) { return ::string(*p.first) + ": " + ::string(*p.second); });
+  return str_join({"{", str_join(values, ", "), "}"});
+}
+
+std::string IndexExpression::string() {
+  return std::format("({}[{}])", ::string(*left), ::string(*index));
+}
+
 std::string BlockStatement::string() {
   std::string out = "";
   for (const auto &statement: get_statements()) {
@@ -268,14 +298,28 @@ std::ostream &operator<<(std::ostream &os, const CharLiteral &obj) {
   return os;
 }
 
-//std::ostream &operator<<(std::ostream &os, const ArrayLiteral &obj) {
-//  os << "ArrayLiteral(vals=[";
-//  for (const auto &e: obj.values) {
-//    os << *e << ",";
-//  }
-//  os << "])";
-//  return os;
-//}
+std::ostream &operator<<(std::ostream &os, const ArrayLiteral &obj) {
+  os << "ArrayLiteral(vals=[";
+  for (const auto *e: obj.elements) {
+    os << *e << ",";
+  }
+  os << "])";
+  return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const HashLiteral &obj) {
+  os << "HashLiteral(pairs=[";
+  for (const auto &[key, value]: obj.pairs) {
+    os << *key << ": " << *value << ",";
+  }
+  os << "])";
+  return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const IndexExpression &obj) {
+  os << "IndexExpression(left=" << *obj.left << ", index=" << *obj.index << ")";
+  return os;
+}
 
 std::ostream &operator<<(std::ostream &os, const FloatLiteral &obj) {
   os << "(FloatLiteral(val=" << std::to_string(obj.val) << ")";
@@ -381,6 +425,26 @@ bool CallExpression::operator==(const CallExpression &other) const {
   return eq;
 }
 
+bool ArrayLiteral::operator==(const ArrayLiteral &other) const {
+  if (other.elements.size() != elements.size()) return false;
+  for (size_t i = 0; i < elements.size(); i++) {
+    if (!(*elements[i] == *other.elements[i])) return false;
+  }
+  return true;
+}
+
+bool HashLiteral::operator==(const HashLiteral &other) const {
+  if (other.pairs.size() != pairs.size()) return false;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (!(*pairs[i].first == *other.pairs[i].first) || !(*pairs[i].second == *other.pairs[i].second)) return false;
+  }
+  return true;
+}
+
+bool IndexExpression::operator==(const IndexExpression &other) const {
+  return *other.left == *left && *other.index == *index;
+}
+
 const std::vector<Statement> BlockStatement::get_statements() const {
   std::vector<Statement> out;
   for (const auto &[type, s_ptr]: statements) {
@@ -403,3 +467,90 @@ const std::vector<Statement> BlockStatement::get_statements() const {
   }
   return out;
 }
+
+namespace {
+  void delete_children(Statement &node);
+  void delete_children(Expression &node);
+
+  void delete_expression(Expression *node) {
+    delete_children(*node);
+    delete node;
+  }
+
+  // The parser allocates every statement of a block as a Statement, whatever type it is tagged with
+  void delete_block(BlockStatement *node) {
+    for (auto &[type, s_ptr]: node->statements) {
+      auto *stmt = static_cast<Statement *>(s_ptr);
+      delete_children(*stmt);
+      delete stmt;
+    }
+    node->statements.clear();
+  }
+
+  void delete_children(Expression &node) {
+    std::visit(overloads{
+                       [](PrefixExpression &p) { delete_expression(p.right); },
+                       [](InfixExpression &i) {
+                         delete_expression(i.left);
+                         delete_expression(i.right);
+                       },
+                       [](IfExpression &i) {
+                         delete_expression(i.condition);
+                         delete_block(i.consequence);
+                         delete i.consequence;
+                         if (i.alternative.has_value()) {
+                           delete_block(i.alternative.value());
+                           delete i.alternative.value();
+                         }
+                       },
+                       [](FunctionLiteral &f) {
+                         for (auto *param: f.parameters) {
+                           delete param;
+                         }
+                         delete_block(f.body);
+                         delete f.body;
+                       },
+                       [](CallExpression &c) {
+                         delete_expression(c.function);
+                         for (auto *arg: c.arguments) {
+                           delete_expression(arg);
+                         }
+                       },
+                       [](ArrayLiteral &a) {
+                         for (auto *element: a.elements) {
+                           delete_expression(element);
+                         }
+                       },
+                       [](HashLiteral &h) {
+                         for (auto &[key, value]: h.pairs) {
+                           delete_expression(key);
+                           delete_expression(value);
+                         }
+                       },
+                       [](IndexExpression &i) {
+                         delete_expression(i.left);
+                         delete_expression(i.index);
+                       },
+                       [](auto &) {},
+               },
+               node);
+  }
+
+  void delete_children(Statement &node) {
+    std::visit(overloads{
+                       [](LetStatement &let) { delete_children(let.value); },
+                       [](ReturnStatement &ret) { delete_children(ret.return_value); },
+                       [](ExpressionStatement &e) { delete_children(e.e); },
+                       // A nested block is held by value, only its statements are separate allocations
+                       [](BlockStatement &b) { delete_block(&b); },
+               },
+               node);
+  }
+}// namespace
+
+void delete_nodes(Program &program) {
+  for (auto &stmt: program.statements) {
+    delete_children(stmt);
+  }
+  program.statements.clear();
+}
@@ -18,6 +18,7 @@
 #include <variant>
 #include <vector>
 
+#include "intern.h"
 #include "lexer.h"
 #include "utils.h"
 
@@ -29,7 +30,8 @@ enum struct precedence {
   sum = 3,
   product = 4,
   prefix = 5,
-  call = 6
+  call = 6,
+  index = 7
 };
 
 std::optional<precedence> get_precedence(token_t t);
@@ -44,21 +46,28 @@ class FloatLiteral;
 class StringLiteral;
 class CharLiteral;
 class ArrayLiteral;
+class HashLiteral;
 class PrefixExpression;
 class InfixExpression;
 class BooleanLiteral;
 class CallExpression;
+class IndexExpression;
 class IfExpression;
 class FunctionLiteral;
 class LetStatement;
 class ReturnStatement;
 class ExpressionStatement;
 class BlockStatement;
+class CallSiteCache;
+
+// Defined alongside the cache itself so the AST does not depend on the object model
+std::shared_ptr<CallSiteCache> make_call_site_cache();
 
 typedef  std::variant<StringLiteral,
              CharLiteral,
              BooleanLiteral,
              ArrayLiteral,
+             HashLiteral,
              FloatLiteral,
              Identifier,
              IntegerLiteral,
@@ -66,31 +75,14 @@ typedef  std::variant<StringLiteral,
              InfixExpression,
              IfExpression,
              FunctionLiteral,
-             CallExpression>  Expression;
-
-enum class ExpressionType {
-  SL,
-  CL,
-  BL,
-  AL,
-  FL,
-  ID,
-  Int,
-  Pre,
-  Inf,
-  If,
-  FuncL,
-  CE
-};
+             CallExpression,
+             IndexExpression>  Expression;
 
-typedef std::pair<ExpressionType, void *> IndirectExpression;
+// The interned name a call of function is profiled under
+const std::string *callee_symbol(Expression *function);
 
-class ArrayLiteral {
-  public:
-      ArrayLiteral(){}
-      std::vector<IndirectExpression> values;
-      std::vector<Expression> get_values();
-}
+// A number no other node has been given in this process
+uint64_t next_node_id();
 
 // See block statement for why we need this
 enum class StatementType {
@@ -111,6 +103,9 @@ class BlockStatement {
   BlockStatement(Token t, std::vector<std::pair<StatementType, void *>> statements) : t(t), statements(statements){};
   Token t;
   std::vector<std::pair<StatementType, void *>> statements;
+  // Unlike the address, never reused by a tree parsed after this one is freed, so per isolate state is keyed by it.
+  // Copies keep it
+  uint64_t id = next_node_id();
   // Helpful function to decode the above into what we actually want
   const std::vector<Statement> get_statements() const;
   std::string token_literal() { return t.literal; }
@@ -118,25 +113,51 @@ class BlockStatement {
   bool operator==(const BlockStatement &other) const;
 };
 
-//class ArrayLiteral {
-//  public:
-//  ArrayLiteral(){};
-//  ArrayLiteral(Token t, std::vector<std::pair<ExpressionType, void *>> values) : t(t), values(values){};
-//  Token t;
-//  std::vector<std::pair<ExpressionType, void *>> values;
-//  const std::vector<Expression> get_values();
-//  std::string token_literal() { return "\"ArrayLiteral\""; }
-//  std::string string() { return token_literal(); };
-//  bool operator==(const ArrayLiteral &) const { return true; }
-//};
+class ArrayLiteral {
+  public:
+  ArrayLiteral(){};
+  ArrayLiteral(Token t, std::vector<Expression *> elements) : t(std::move(t)), elements(std::move(elements)){};
+  Token t;
+  std::vector<Expression *> elements;
+  std::string token_literal() { return t.literal; }
+  std::string string();
+  bool operator==(const ArrayLiteral &other) const;
+};
+
+class HashLiteral {
+  public:
+  HashLiteral(){};
+  HashLiteral(Token t, std::vector<std::pair<Expression *, Expression *>> pairs) : t(std::move(t)), pairs(std::move(pairs)){};
+  Token t;
+  // Key and value expressions in source order
+  std::vector<std::pair<Expression *, Expression *>> pairs;
+  std::string token_literal() { return t.literal; }
+  std::string string();
+  bool operator==(const HashLiteral &other) const;
+};
+
+class IndexExpression {
+  public:
+  IndexExpression(Token t, Expression *left, Expression *index) : t(std::move(t)), left(left), index(index){};
+  Token t;
+  Expression *left;
+  Expression *index;
+  std::string token_literal() { return t.literal; }
+  std::string string();
+  bool operator==(const IndexExpression &other) const;
+};
 
 class CallExpression {
   public:
   Token t;
   Expression *function;
   std::vector<Expression*> arguments;
-  CallExpression(Token t, Expression* function, std::vector<Expression*> arguments) : t(std::move(t)), function(function), arguments(std::move(arguments)){};
-  CallExpression(Expression* function, std::vector<Expression*> arguments) : function(function), arguments(std::move(arguments)){};
+  // Inline cache for this call site. Shared so that the copies made while walking blocks all feed the same cache
+  std::shared_ptr<CallSiteCache> cache;
+  // Interned name of what is called, the identifier or "anonymous", so profiles can name the frame without copying
+  const std::string *callee_name;
+  CallExpression(Token t, Expression* function, std::vector<Expression*> arguments) : t(std::move(t)), function(function), arguments(std::move(arguments)), cache(make_call_site_cache()), callee_name(::callee_symbol(function)){};
+  CallExpression(Expression* function, std::vector<Expression*> arguments) : function(function), arguments(std::move(arguments)), cache(make_call_site_cache()), callee_name(::callee_symbol(function)){};
   std::string token_literal() { return t.literal; };
   std::string string();
   bool operator==(const CallExpression &other) const;
@@ -171,9 +192,11 @@ class IfExpression {
 class StringLiteral {
   public:
   StringLiteral(){};
-  StringLiteral(Token t, std::string value) : t(t), value(value){};
+  StringLiteral(Token t, std::string value) : t(t), value(value), symbol(intern(this->value)){};
   Token t;
   std::string value;
+  // The interned copy of value, so using the literal as a hash key never hashes its characters
+  const std::string *symbol = nullptr;
   std::string token_literal() { return "\"" + value + "\""; }
   std::string string() { return token_literal(); };
   bool operator==(const StringLiteral &other) const { return other.value == value; }
@@ -297,7 +320,7 @@ class ReturnStatement {
 
 class ExpressionStatement {
   public:
-  // TODO : Not sure what to do for the token here
+  // The parser sets token to the first token of the expression, for its line
   ExpressionStatement() : token(Token(ILLEGAL, "")), e(Expression()){};
   ExpressionStatement(Expression e) : token(Token(ILLEGAL, "")), e(e){};
   std::string token_literal() { unimplemented(); }
@@ -321,6 +344,12 @@ class Program {
   bool operator==(const Program &other) const;
 };
 
+/**
+ * Free the nodes the parser allocated for a program. Nothing may refer to them afterwards,
+ * including functions created by evaluating the program
+ */
+void delete_nodes(Program &program);
+
 
 // Helper variable template
 
@@ -359,8 +388,10 @@ std::ostream &operator<<(std::ostream &os, const BooleanLiteral &obj);
 std::ostream &operator<<(std::ostream &os, const FunctionLiteral &obj);
 std::ostream &operator<<(std::ostream &os, const IntegerLiteral &obj);
 std::ostream &operator<<(std::ostream &os, const FloatLiteral &obj);
-//std::ostream &operator<<(std::ostream &os, const ArrayLiteral &obj);
+std::ostream &operator<<(std::ostream &os, const ArrayLiteral &obj);
+std::ostream &operator<<(std::ostream &os, const HashLiteral &obj);
 std::ostream &operator<<(std::ostream &os, const CallExpression &obj);
+std::ostream &operator<<(std::ostream &os, const IndexExpression &obj);
 std::ostream &operator<<(std::ostream &os, const StringLiteral &obj);
 std::ostream &operator<<(std::ostream &os, const CharLiteral &obj);
 std::ostream &operator<<(std::ostream &os, const Program &obj);
@@ -0,0 +1,530 @@
+//
+// Natively implemented functions available to every program.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <format>
+#include <iostream>
+
+#include "builtins.h"
+#include "hash_table.h"
+#include "isolate.h"
+#include "simd.h"
+#include "utils.h"
+
+namespace {
+  ObjectResult unsupported(const char *name, Object &arg) {
+    return std::unexpected(TypeError(std::format("argument to `{}` not supported, got {}", name, get_type_name(arg))));
+  }
+
+  std::optional<double> number(Object &obj) {
+    if (auto *i = std::get_if<Integer>(&obj)) return static_cast<double>(i->value);
+    if (auto *f = std::get_if<Float>(&obj)) return f->value;
+    return std::nullopt;
+  }
+
+  // How puts and str show a value: strings without quotes or wrappers, everything else as Monke would write it
+  std::string display(Object &obj) {
+    return std::visit(overloads{
+                              [](Integer &i) { return std::format("{}", i.value); },
+                              [](Float &f) { return std::format("{}", f.value); },
+                              [](String &s) { return std::string(s.value()); },
+                              [](Char &c) { return std::string(1, c.value); },
+                              [](Boolean &b) { return std::string(b.value ? "true" : "false"); },
+                              [](Null &) { return std::string("null"); },
+                              [](Vec &v) {
+                                std::vector<std::string> values;
+                                for (size_t i = 0; i < v.size(); i++) {
+                                  auto value = v.at(i);
+                                  values.push_back(display(value));
+                                }
+                                return "[" + str_join(values, ", ") + "]";
+                              },
+                              [](Array &a) {
+                                std::vector<std::string> values;
+                                for (size_t i = 0; i < a.size(); i++) {
+                                  auto value = a.at(i);
+                                  values.push_back(display(value));
+                                }
+                                return "[" + str_join(values, ", ") + "]";
+                              },
+                              [](Hash &h) {
+                                std::vector<std::string> pairs;
+                                for (const auto &[key, value]: h.items()) {
+                                  auto k = key.object();
+                                  auto v = value;
+                                  pairs.push_back(display(k) + ": " + display(v));
+                                }
+                                return "{" + str_join(pairs, ", ") + "}";
+                              },
+                              [](auto &other) { return other.inspect(); },
+                      },
+                      obj);
+  }
+
+  ObjectResult builtin_len(std::span<Object> args) {
+    if (auto *a = std::get_if<Array>(&args[0])) return Integer(static_cast<int64_t>(a->size()));
+    if (auto *v = std::get_if<Vec>(&args[0])) return Integer(static_cast<int64_t>(v->size()));
+    if (auto *h = std::get_if<Hash>(&args[0])) return Integer(static_cast<int64_t>(h->size()));
+    auto *s = std::get_if<String>(&args[0]);
+    if (s == nullptr) return unsupported("len", args[0]);
+    return Integer(static_cast<int64_t>(s->size()));
+  }
+
+  // The arguments are ours, so an array that only the call holds grows in place
+  ObjectResult builtin_push(std::span<Object> args) {
+    auto *a = std::get_if<Array>(&args[0]);
+    if (a == nullptr) return unsupported("push", args[0]);
+    Array out = std::move(*a);
+    out.append(std::move(args[1]));
+    return out;
+  }
+
+  // set(a, i, value) is a with element i replaced
+  ObjectResult builtin_set(std::span<Object> args) {
+    auto *a = std::get_if<Array>(&args[0]);
+    if (a == nullptr) return unsupported("set", args[0]);
+    auto *i = std::get_if<Integer>(&args[1]);
+    if (i == nullptr) return unsupported("set", args[1]);
+    if (i->value < 0 || static_cast<size_t>(i->value) >= a->size()) {
+      return std::unexpected(TypeError(std::format("set out of range: index={}, size={}", i->value, a->size())));
+    }
+    Array out = std::move(*a);
+    out.assign(static_cast<size_t>(i->value), std::move(args[2]));
+    return out;
+  }
+
+  // slice(a, from, to) takes the elements in [from, to), clamped to the array
+  ObjectResult builtin_slice(std::span<Object> args) {
+    auto *a = std::get_if<Array>(&args[0]);
+    if (a == nullptr) return unsupported("slice", args[0]);
+    auto *from = std::get_if<Integer>(&args[1]);
+    if (from == nullptr) return unsupported("slice", args[1]);
+    auto *to = std::get_if<Integer>(&args[2]);
+    if (to == nullptr) return unsupported("slice", args[2]);
+    if (from->value < 0 || to->value < 0) {
+      return std::unexpected(TypeError(std::format("slice out of range: from={}, to={}", from->value, to->value)));
+    }
+    return a->slice(static_cast<size_t>(from->value), static_cast<size_t>(to->value));
+  }
+
+  ObjectResult builtin_puts(std::span<Object> args) {
+    for (auto &arg: args) {
+      std::cout << display(arg) << std::endl;
+    }
+    return Null();
+  }
+
+  ObjectResult builtin_abs(std::span<Object> args) {
+    if (auto *i = std::get_if<Integer>(&args[0])) return Integer(i->value < 0 ? -i->value : i->value);
+    if (auto *f = std::get_if<Float>(&args[0])) return Float(std::fabs(f->value));
+    return unsupported("abs", args[0]);
+  }
+
+  typedef std::variant<std::span<const int64_t>, std::span<const double>> Numbers;
+
+  // The elements of a Vec, or of an Array while it is stored unboxed
+  std::optional<Numbers> numbers(Object &obj) {
+    if (auto *v = std::get_if<Vec>(&obj)) {
+      return std::visit([](auto &elements) { return Numbers(std::span(elements)); }, *v->elements);
+    }
+    if (auto *a = std::get_if<Array>(&obj)) {
+      // The kernels want one contiguous run, and the arguments are ours to replace
+      if (!a->contiguous()) {
+        obj = a->flatten();
+        a = std::get_if<Array>(&obj);
+      }
+      if (auto *ints = std::get_if<std::vector<int64_t>>(a->elements.get())) return Numbers(std::span(*ints));
+      if (auto *floats = std::get_if<std::vector<double>>(a->elements.get())) return Numbers(std::span(*floats));
+    }
+    return std::nullopt;
+  }
+
+  std::vector<double> widen(Numbers n) {
+    return std::visit([](auto span) { return std::vector<double>(span.begin(), span.end()); }, n);
+  }
+
+  ObjectResult length_mismatch(const char *name, size_t a, size_t b) {
+    return std::unexpected(TypeError(std::format("length mismatch in `{}`: {} vs {}", name, a, b)));
+  }
+
+  // vec(1, 2, 3) or vec(array). Integers stay int64, anything with a Float in it becomes double
+  ObjectResult builtin_vec(std::span<Object> args) {
+    if (args.size() == 1) {
+      if (std::holds_alternative<Vec>(args[0])) return args[0];
+      if (auto *a = std::get_if<Array>(&args[0])) {
+        if (auto n = numbers(args[0])) {
+          return std::visit([](auto span) { return Vec(std::vector(span.begin(), span.end())); }, n.value());
+        }
+        std::vector<Object> elements;
+        for (size_t i = 0; i < a->size(); i++) {
+          elements.push_back(a->at(i));
+        }
+        return builtin_vec(elements);
+      }
+    }
+    bool floats = false;
+    for (auto &arg: args) {
+      if (std::holds_alternative<Float>(arg)) {
+        floats = true;
+      } else if (!std::holds_alternative<Integer>(arg)) {
+        return unsupported("vec", arg);
+      }
+    }
+    if (!floats) {
+      std::vector<int64_t> out;
+      out.reserve(args.size());
+      for (auto &arg: args) {
+        out.push_back(std::get<Integer>(arg).value);
+      }
+      return Vec(std::move(out));
+    }
+    std::vector<double> out;
+    out.reserve(args.size());
+    for (auto &arg: args) {
+      out.push_back(number(arg).value());
+    }
+    return Vec(std::move(out));
+  }
+
+  ObjectResult builtin_sum(std::span<Object> args) {
+    auto n = numbers(args[0]);
+    if (!n.has_value()) return unsupported("sum", args[0]);
+    auto &kernels = simd_kernels();
+    if (auto *ints = std::get_if<std::span<const int64_t>>(&n.value())) return Integer(kernels.i64.sum(ints->data(), ints->size()));
+    auto floats = std::get<std::span<const double>>(n.value());
+    return Float(kernels.f64.sum(floats.data(), floats.size()));
+  }
+
+  ObjectResult builtin_dot(std::span<Object> args) {
+    auto a = numbers(args[0]);
+    if (!a.has_value()) return unsupported("dot", args[0]);
+    auto b = numbers(args[1]);
+    if (!b.has_value()) return unsupported("dot", args[1]);
+    auto size = [](Numbers n) { return std::visit([](auto span) { return span.size(); }, n); };
+    if (size(a.value()) != size(b.value())) return length_mismatch("dot", size(a.value()), size(b.value()));
+
+    auto &kernels = simd_kernels();
+    auto *x = std::get_if<std::span<const int64_t>>(&a.value());
+    auto *y = std::get_if<std::span<const int64_t>>(&b.value());
+    if (x != nullptr && y != nullptr) return Integer(kernels.i64.dot(x->data(), y->data(), x->size()));
+    auto wide_a = widen(a.value());
+    auto wide_b = widen(b.value());
+    return Float(kernels.f64.dot(wide_a.data(), wide_b.data(), wide_a.size()));
+  }
+
+  // min(v) and max(v) over a vector
+  template<bool Max>
+  ObjectResult reduce_extremum(const char *name, Object &arg) {
+    auto n = numbers(arg);
+    if (!n.has_value()) return unsupported(name, arg);
+    auto &kernels = simd_kernels();
+    return std::visit([&](auto span) -> ObjectResult {
+      if (span.empty()) return std::unexpected(TypeError(std::format("`{}` of an empty vector", name)));
+      if constexpr (std::is_same_v<decltype(span), std::span<const int64_t>>) {
+        return Integer((Max ? kernels.i64.max : kernels.i64.min)(span.data(), span.size()));
+      } else {
+        return Float((Max ? kernels.f64.max : kernels.f64.min)(span.data(), span.size()));
+      }
+    },
+                      n.value());
+  }
+
+  /*
+   * map_add and map_mul: elementwise with a vector of the same length, or with a number applied to every element.
+   * pick selects the vector and the broadcast kernel from a SimdOps
+   */
+  template<typename Pick>
+  ObjectResult elementwise(const char *name, std::span<Object> args, Pick pick) {
+    auto a = numbers(args[0]);
+    if (!a.has_value()) return unsupported(name, args[0]);
+    auto b = numbers(args[1]);
+    auto scalar = number(args[1]);
+    if (!b.has_value() && !scalar.has_value()) return unsupported(name, args[1]);
+
+    auto &kernels = simd_kernels();
+    auto *x = std::get_if<std::span<const int64_t>>(&a.value());
+    if (x != nullptr && (b.has_value() ? std::holds_alternative<std::span<const int64_t>>(b.value()) : std::holds_alternative<Integer>(args[1]))) {
+      auto [vector, broadcast] = pick(kernels.i64);
+      std::vector<int64_t> out(x->size());
+      if (b.has_value()) {
+        auto y = std::get<std::span<const int64_t>>(b.value());
+        if (y.size() != x->size()) return length_mismatch(name, x->size(), y.size());
+        vector(x->data(), y.data(), out.data(), out.size());
+      } else {
+        broadcast(x->data(), std::get<Integer>(args[1]).value, out.data(), out.size());
+      }
+      return Vec(std::move(out));
+    }
+
+    // Mixed types compute in double
+    auto [vector, broadcast] = pick(kernels.f64);
+    auto wide_a = widen(a.value());
+    std::vector<double> out(wide_a.size());
+    if (b.has_value()) {
+      auto wide_b = widen(b.value());
+      if (wide_b.size() != wide_a.size()) return length_mismatch(name, wide_a.size(), wide_b.size());
+      vector(wide_a.data(), wide_b.data(), out.data(), out.size());
+    } else {
+      broadcast(wide_a.data(), scalar.value(), out.data(), out.size());
+    }
+    return Vec(std::move(out));
+  }
+
+  ObjectResult builtin_map_add(std::span<Object> args) {
+    return elementwise("map_add", args, [](auto &ops) { return std::pair(ops.add, ops.add_scalar); });
+  }
+
+  ObjectResult builtin_map_mul(std::span<Object> args) {
+    return elementwise("map_mul", args, [](auto &ops) { return std::pair(ops.mul, ops.mul_scalar); });
+  }
+
+  // clamp(x, lo, hi) for a number, or elementwise for a vector
+  ObjectResult builtin_clamp(std::span<Object> args) {
+    auto lo = number(args[1]);
+    if (!lo.has_value()) return unsupported("clamp", args[1]);
+    auto hi = number(args[2]);
+    if (!hi.has_value()) return unsupported("clamp", args[2]);
+    bool int_bounds = std::holds_alternative<Integer>(args[1]) && std::holds_alternative<Integer>(args[2]);
+
+    if (auto *i = std::get_if<Integer>(&args[0]); i != nullptr && int_bounds) {
+      return Integer(std::min(std::max(i->value, std::get<Integer>(args[1]).value), std::get<Integer>(args[2]).value));
+    }
+    if (auto x = number(args[0])) return Float(std::min(std::max(x.value(), lo.value()), hi.value()));
+
+    auto n = numbers(args[0]);
+    if (!n.has_value()) return unsupported("clamp", args[0]);
+    auto &kernels = simd_kernels();
+    if (auto *ints = std::get_if<std::span<const int64_t>>(&n.value()); ints != nullptr && int_bounds) {
+      std::vector<int64_t> out(ints->size());
+      kernels.i64.clamp(ints->data(), std::get<Integer>(args[1]).value, std::get<Integer>(args[2]).value, out.data(), out.size());
+      return Vec(std::move(out));
+    }
+    auto wide = widen(n.value());
+    std::vector<double> out(wide.size());
+    kernels.f64.clamp(wide.data(), lo.value(), hi.value(), out.data(), out.size());
+    return Vec(std::move(out));
+  }
+
+  // min and max stay integers when both arguments are, like the arithmetic operators. With one argument they reduce a vector
+  template<typename Pick>
+  ObjectResult extremum(const char *name, std::span<Object> args, Pick pick) {
+    if (args.size() != 2) {
+      return std::unexpected(TypeError(std::format("wrong number of arguments: want=1 or 2, got={}", args.size())));
+    }
+    auto *a = std::get_if<Integer>(&args[0]);
+    auto *b = std::get_if<Integer>(&args[1]);
+    if (a != nullptr && b != nullptr) return Integer(pick(a->value, b->value));
+    auto x = number(args[0]);
+    if (!x.has_value()) return unsupported(name, args[0]);
+    auto y = number(args[1]);
+    if (!y.has_value()) return unsupported(name, args[1]);
+    return Float(pick(x.value(), y.value()));
+  }
+
+  ObjectResult builtin_min(std::span<Object> args) {
+    if (args.size() == 1) return reduce_extremum<false>("min", args[0]);
+    return extremum("min", args, [](auto x, auto y) { return std::min(x, y); });
+  }
+
+  ObjectResult builtin_max(std::span<Object> args) {
+    if (args.size() == 1) return reduce_extremum<true>("max", args[0]);
+    return extremum("max", args, [](auto x, auto y) { return std::max(x, y); });
+  }
+
+  ObjectResult builtin_sqrt(std::span<Object> args) {
+    auto x = number(args[0]);
+    if (!x.has_value()) return unsupported("sqrt", args[0]);
+    return Float(std::sqrt(x.value()));
+  }
+
+  ObjectResult overflow(const char *name) {
+    return std::unexpected(TypeError(std::format("integer overflow in `{}`", name)));
+  }
+
+  // A whole double as an Integer. NaN, the infinities and anything outside int64 have no Integer to become
+  ObjectResult to_integer(const char *name, double value) {
+    if (!(value >= -0x1p63 && value < 0x1p63)) {
+      return std::unexpected(TypeError(std::format("{} out of range: {}", name, value)));
+    }
+    return Integer(static_cast<int64_t>(value));
+  }
+
+  ObjectResult builtin_pow(std::span<Object> args) {
+    auto *base = std::get_if<Integer>(&args[0]);
+    auto *exponent = std::get_if<Integer>(&args[1]);
+    if (base != nullptr && exponent != nullptr && exponent->value >= 0) {
+      // By squaring; the factor is only squared when a higher bit still needs it, so it overflows only if the result does
+      int64_t result = 1;
+      int64_t factor = base->value;
+      for (int64_t e = exponent->value; e > 0; e >>= 1) {
+        if ((e & 1) != 0 && __builtin_mul_overflow(result, factor, &result)) return overflow("pow");
+        if (e > 1 && __builtin_mul_overflow(factor, factor, &factor)) return overflow("pow");
+      }
+      return Integer(result);
+    }
+    auto x = number(args[0]);
+    if (!x.has_value()) return unsupported("pow", args[0]);
+    auto y = number(args[1]);
+    if (!y.has_value()) return unsupported("pow", args[1]);
+    return Float(std::pow(x.value(), y.value()));
+  }
+
+  ObjectResult builtin_floor(std::span<Object> args) {
+    if (std::holds_alternative<Integer>(args[0])) return args[0];
+    auto *f = std::get_if<Float>(&args[0]);
+    if (f == nullptr) return unsupported("floor", args[0]);
+    return to_integer("floor", std::floor(f->value));
+  }
+
+  ObjectResult builtin_ceil(std::span<Object> args) {
+    if (std::holds_alternative<Integer>(args[0])) return args[0];
+    auto *f = std::get_if<Float>(&args[0]);
+    if (f == nullptr) return unsupported("ceil", args[0]);
+    return to_integer("ceil", std::ceil(f->value));
+  }
+
+  ObjectResult builtin_str(std::span<Object> args) {
+    return String(display(args[0]));
+  }
+
+  ObjectResult builtin_upper(std::span<Object> args) {
+    auto *s = std::get_if<String>(&args[0]);
+    if (s == nullptr) return unsupported("upper", args[0]);
+    std::string out(s->value());
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::toupper(c); });
+    return String(std::move(out));
+  }
+
+  ObjectResult builtin_lower(std::span<Object> args) {
+    auto *s = std::get_if<String>(&args[0]);
+    if (s == nullptr) return unsupported("lower", args[0]);
+    std::string out(s->value());
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return String(std::move(out));
+  }
+
+  ObjectResult builtin_trim(std::span<Object> args) {
+    auto *s = std::get_if<String>(&args[0]);
+    if (s == nullptr) return unsupported("trim", args[0]);
+    auto first = s->value().find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return String("");
+    auto last = s->value().find_last_not_of(" \t\r\n");
+    return String(s->value().substr(first, last - first + 1));
+  }
+
+  // substr(s, start, count), clamped to the string like std::string::substr
+  ObjectResult builtin_substr(std::span<Object> args) {
+    auto *s = std::get_if<String>(&args[0]);
+    if (s == nullptr) return unsupported("substr", args[0]);
+    auto *start = std::get_if<Integer>(&args[1]);
+    if (start == nullptr) return unsupported("substr", args[1]);
+    auto *count = std::get_if<Integer>(&args[2]);
+    if (count == nullptr) return unsupported("substr", args[2]);
+    if (start->value < 0 || count->value < 0) {
+      return std::unexpected(TypeError(std::format("substr out of range: start={}, count={}", start->value, count->value)));
+    }
+    auto from = std::min(static_cast<size_t>(start->value), s->value().size());
+    return String(s->value().substr(from, static_cast<size_t>(count->value)));
+  }
+
+  ObjectResult builtin_contains(std::span<Object> args) {
+    auto *s = std::get_if<String>(&args[0]);
+    if (s == nullptr) return unsupported("contains", args[0]);
+    if (auto *part = std::get_if<String>(&args[1])) return Boolean(s->value().find(part->value()) != std::string::npos);
+    if (auto *c = std::get_if<Char>(&args[1])) return Boolean(s->value().find(c->value) != std::string::npos);
+    return unsupported("contains", args[1]);
+  }
+
+  ObjectResult builtin_keys(std::span<Object> args) {
+    auto *h = std::get_if<Hash>(&args[0]);
+    if (h == nullptr) return unsupported("keys", args[0]);
+    std::vector<Object> keys;
+    keys.reserve(h->size());
+    for (const auto &[key, value]: h->items()) keys.push_back(key.object());
+    return Array::from(std::move(keys));
+  }
+
+  ObjectResult builtin_values(std::span<Object> args) {
+    auto *h = std::get_if<Hash>(&args[0]);
+    if (h == nullptr) return unsupported("values", args[0]);
+    std::vector<Object> values;
+    values.reserve(h->size());
+    for (const auto &[key, value]: h->items()) values.push_back(value);
+    return Array::from(std::move(values));
+  }
+
+  ObjectResult builtin_has(std::span<Object> args) {
+    auto *h = std::get_if<Hash>(&args[0]);
+    if (h == nullptr) return unsupported("has", args[0]);
+    if (!HashKey::hashable(args[1])) return std::unexpected(unusable_key_error(args[1]));
+    auto key = HashKey::find(args[1]);
+    return Boolean(key.has_value() && h->find(key.value()) != nullptr);
+  }
+
+  // put(h, key, value) is h with key bound to value. h itself is only changed when nothing else can see it
+  ObjectResult builtin_put(std::span<Object> args) {
+    auto *h = std::get_if<Hash>(&args[0]);
+    if (h == nullptr) return unsupported("put", args[0]);
+    auto key = HashKey::of(args[1]);
+    if (!key.has_value()) return std::unexpected(unusable_key_error(args[1]));
+    Hash out = std::move(*h);
+    out.insert(key.value(), std::move(args[2]));
+    return out;
+  }
+}// namespace
+
+BuiltinRegistry::BuiltinRegistry() {
+  define("len", 1, true, builtin_len);
+  define("push", 2, true, builtin_push);
+  define("set", 3, true, builtin_set);
+  define("slice", 3, true, builtin_slice);
+  define("puts", std::nullopt, false, builtin_puts);
+  define("abs", 1, true, builtin_abs);
+  define("min", std::nullopt, true, builtin_min);
+  define("max", std::nullopt, true, builtin_max);
+  define("sqrt", 1, true, builtin_sqrt);
+  define("pow", 2, true, builtin_pow);
+  define("floor", 1, true, builtin_floor);
+  define("ceil", 1, true, builtin_ceil);
+  define("str", 1, true, builtin_str);
+  define("upper", 1, true, builtin_upper);
+  define("lower", 1, true, builtin_lower);
+  define("trim", 1, true, builtin_trim);
+  define("substr", 3, true, builtin_substr);
+  define("contains", 2, true, builtin_contains);
+  define("vec", std::nullopt, true, builtin_vec);
+  define("sum", 1, true, builtin_sum);
+  define("dot", 2, true, builtin_dot);
+  define("map_add", 2, true, builtin_map_add);
+  define("map_mul", 2, true, builtin_map_mul);
+  define("clamp", 3, true, builtin_clamp);
+  define("keys", 1, true, builtin_keys);
+  define("values", 1, true, builtin_values);
+  define("has", 2, true, builtin_has);
+  define("put", 3, true, builtin_put);
+}
+
+void BuiltinRegistry::define(const std::string &name, std::optional<size_t> arity, bool pure, BuiltinFunction fn) {
+  // Replace in place so pointers handed out by find keep seeing the current definition
+  auto [it, _] = entries.try_emplace(name, Null());
+  it->second = Builtin(it->first, arity, pure, fn);
+}
+
+Object *BuiltinRegistry::find(const std::string &name) {
+  auto it = entries.find(name);
+  return it == entries.end() ? nullptr : &it->second;
+}
+
+Object *find_builtin(const std::string &name) {
+  return current_isolate().builtins.find(name);
+}
+
+ObjectResult call_builtin(Builtin &builtin, std::span<Object> args) {
+  if (builtin.arity.has_value() && builtin.arity.value() != args.size()) {
+    return std::unexpected(TypeError(std::format("wrong number of arguments: want={}, got={}", builtin.arity.value(), args.size())));
+  }
+  return builtin.fn(args);
+}
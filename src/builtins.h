@@ -0,0 +1,47 @@
+//
+// Natively implemented functions available to every program.
+//
+
+#ifndef MONKE_CPP_BUILTINS_H
+#define MONKE_CPP_BUILTINS_H
+
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+#include "object.h"
+
+/*
+ * The builtins of an isolate, by name.
+ *
+ * A builtin is only seen where its name is not bound in the scope chain, so programs can shadow any of them. Entries are
+ * never removed and the map is node based, so a pointer to one stays valid for the life of the registry and call site
+ * caches can hold on to it.
+ */
+class BuiltinRegistry {
+  public:
+  // Starts out with the default builtins: len, push, set, slice, puts, the math, string, vector and hash helpers
+  BuiltinRegistry();
+
+  /**
+   * Register a builtin, replacing one of the same name
+   * @param arity nullopt for any number of arguments; otherwise calls with a different count fail before fn runs
+   * @param pure fn has no observable effects, so calls may be memoized and reordered
+   */
+  void define(const std::string &name, std::optional<size_t> arity, bool pure, BuiltinFunction fn);
+
+  // nullptr if there is no builtin called name
+  Object *find(const std::string &name);
+
+  private:
+  std::unordered_map<std::string, Object> entries;
+};
+
+// The builtin called name in the current isolate, nullptr if there is none
+Object *find_builtin(const std::string &name);
+
+// Check the argument count against the builtin's arity and call it
+ObjectResult call_builtin(Builtin &builtin, std::span<Object> args);
+
+#endif//MONKE_CPP_BUILTINS_H
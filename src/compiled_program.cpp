@@ -0,0 +1,26 @@
+//
+// Parsed programs shared between threads.
+//
+
+#include "compiled_program.h"
+#include "eval.h"
+#include "parser.h"
+
+CompiledProgram::~CompiledProgram() {
+  delete_nodes(const_cast<Program &>(program));
+}
+
+std::expected<std::shared_ptr<const CompiledProgram>, Error> CompiledProgram::compile(std::string source) {
+  Lexer l = Lexer(source);
+  Parser p = Parser(&l);
+  Program program = p.parse_program();
+  if (program.error.has_value()) {
+    return std::unexpected(program.error.value());
+  }
+  return std::make_shared<const CompiledProgram>(std::move(source), std::move(program));
+}
+
+ObjectResult CompiledProgram::evaluate(std::shared_ptr<Environment> env) const {
+  // Evaluation takes nodes by reference but never writes to them
+  return ::evaluate(const_cast<Program &>(program), env);
+}
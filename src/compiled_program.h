@@ -0,0 +1,45 @@
+//
+// Parsed programs shared between threads.
+//
+
+#ifndef MONKE_CPP_COMPILED_PROGRAM_H
+#define MONKE_CPP_COMPILED_PROGRAM_H
+
+#include <expected>
+#include <memory>
+#include <string>
+
+#include "ast.h"
+#include "object.h"
+
+/*
+ * The result of parsing a script, owning every node of its tree.
+ *
+ * The tree is never written after parsing: evaluation only reads it, and call site caches are per isolate (see
+ * call_site_cache). Any number of threads may therefore evaluate one program at the same time, each in its own isolate
+ * or environment. The nodes are freed with the last reference, so functions created by the program must not outlive it;
+ * Isolate::run keeps the programs it ran alive for that reason.
+ */
+class CompiledProgram {
+  public:
+  CompiledProgram(std::string source, Program program) : source(std::move(source)), program(std::move(program)){};
+  ~CompiledProgram();
+  CompiledProgram(const CompiledProgram &) = delete;
+  CompiledProgram &operator=(const CompiledProgram &) = delete;
+
+  const std::string source;
+  const Program program;
+
+  /**
+   * Parse source once for use from any thread
+   * @return the lexer or parser error if the source does not parse
+   */
+  static std::expected<std::shared_ptr<const CompiledProgram>, Error> compile(std::string source);
+
+  /**
+   * Evaluate the program in env with the isolate current on the calling thread, like `evaluate`
+   */
+  ObjectResult evaluate(std::shared_ptr<Environment> env) const;
+};
+
+#endif//MONKE_CPP_COMPILED_PROGRAM_H
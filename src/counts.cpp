@@ -0,0 +1,200 @@
+//
+// Execution counts of every line and function of a Monke program.
+//
+
+#include <algorithm>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "counts.h"
+#include "trace.h"
+
+std::atomic<bool> counting = false;
+
+namespace {
+  class FunctionEntry {
+    public:
+    FunctionCounts counts;
+    // Calls of the function on the thread's stack, total_time is only added when the outermost one returns
+    uint32_t active = 0;
+  };
+
+  class Activation {
+    public:
+    FunctionEntry *function;
+    uint64_t start;
+  };
+
+  // The counts of one thread. Only that thread writes, readers must wait until it is done
+  class CountTable {
+    public:
+    // Indexed by line
+    std::vector<LineCounts> lines;
+    std::vector<bool> declared;
+    // References to the entries stay valid as the map grows
+    std::unordered_map<const std::string *, FunctionEntry> functions;
+    std::vector<uint32_t> line_stack;
+    std::vector<Activation> call_stack;
+    // Clock at the previous event
+    uint64_t last = 0;
+
+    void grow(uint32_t line) {
+      if (line >= lines.size()) {
+        lines.resize(line + 1);
+        declared.resize(line + 1);
+      }
+    }
+
+    // Charge the time since the previous event to what is innermost, and return the clock
+    uint64_t tick() {
+      auto now = trace_clock();
+      auto elapsed = last == 0 ? 0 : now - last;
+      last = now;
+      if (!line_stack.empty()) lines[line_stack.back()].self_time += elapsed;
+      if (!call_stack.empty()) call_stack.back().function->counts.self_time += elapsed;
+      return now;
+    }
+  };
+
+  // Every thread's table, kept after the thread exits so its counts can still be merged
+  std::mutex tables_mutex;
+  std::vector<std::unique_ptr<CountTable>> tables;
+  thread_local CountTable *thread_table = nullptr;
+
+  CountTable &table_for_thread() {
+    if (thread_table == nullptr) {
+      std::lock_guard lock(tables_mutex);
+      tables.push_back(std::make_unique<CountTable>());
+      thread_table = tables.back().get();
+    }
+    return *thread_table;
+  }
+
+  std::string milliseconds(uint64_t nanoseconds) {
+    return std::format("{:.3f}", static_cast<double>(nanoseconds) / 1e6);
+  }
+}// namespace
+
+void declare_counted_line(uint32_t line) {
+  if (!counting.load(std::memory_order_relaxed)) return;
+  auto &table = table_for_thread();
+  table.grow(line);
+  table.declared[line] = true;
+}
+
+void enter_counted_line(uint32_t line) {
+  auto &table = table_for_thread();
+  table.tick();
+  table.grow(line);
+  table.lines[line].count++;
+  table.line_stack.push_back(line);
+}
+
+void leave_counted_line() {
+  auto &table = table_for_thread();
+  table.tick();
+  if (!table.line_stack.empty()) table.line_stack.pop_back();
+}
+
+void enter_counted_call(const std::string *name) {
+  auto &table = table_for_thread();
+  auto now = table.tick();
+  auto &function = table.functions[name];
+  function.counts.calls++;
+  function.active++;
+  table.call_stack.push_back({&function, now});
+}
+
+void leave_counted_call() {
+  auto &table = table_for_thread();
+  auto now = table.tick();
+  if (table.call_stack.empty()) return;
+  auto activation = table.call_stack.back();
+  table.call_stack.pop_back();
+  if (--activation.function->active == 0) activation.function->counts.total_time += now - activation.start;
+}
+
+void start_counting() {
+  {
+    std::lock_guard lock(tables_mutex);
+    for (auto &table: tables) *table = CountTable();
+  }
+  counting = true;
+}
+
+Counts stop_counting() {
+  counting = false;
+  Counts counts;
+  std::lock_guard lock(tables_mutex);
+  for (auto &table: tables) {
+    for (uint32_t line = 0; line < table->lines.size(); line++) {
+      auto &from = table->lines[line];
+      if (!table->declared[line] && from.count == 0) continue;
+      auto &to = counts.lines[line];
+      to.count += from.count;
+      to.self_time += from.self_time;
+    }
+    for (auto &[name, function]: table->functions) {
+      auto &to = counts.functions[*name];
+      to.calls += function.counts.calls;
+      to.self_time += function.counts.self_time;
+      to.total_time += function.counts.total_time;
+    }
+  }
+  return counts;
+}
+
+std::string annotate_source(const Counts &counts, std::string_view source, size_t top) {
+  std::string out = "";
+  if (!source.empty()) {
+    out += std::format("{:>10} {:>12}  {:>5}: {}\n", "count", "self ms", "line", "source");
+    uint32_t line = 1;
+    size_t start = 0;
+    while (start < source.size()) {
+      auto end = std::min(source.find('\n', start), source.size());
+      auto text = source.substr(start, end - start);
+      if (auto it = counts.lines.find(line); it == counts.lines.end()) {
+        out += std::format("{:>10} {:>12}  {:>5}: {}\n", "-", "", line, text);
+      } else if (it->second.count == 0) {
+        out += std::format("{:>10} {:>12}  {:>5}: {}\n", "#####", "", line, text);
+      } else {
+        out += std::format("{:>10} {:>12}  {:>5}: {}\n", it->second.count, milliseconds(it->second.self_time), line, text);
+      }
+      start = end + 1;
+      line++;
+    }
+    out += "\n";
+  }
+
+  std::vector<std::pair<std::string, FunctionCounts>> rows(counts.functions.begin(), counts.functions.end());
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+    return a.second.self_time != b.second.self_time ? a.second.self_time > b.second.self_time : a.first < b.first;
+  });
+  out += std::format("{:>10} {:>12} {:>12}  {}\n", "calls", "self ms", "total ms", "function");
+  for (size_t i = 0; i < std::min(top, rows.size()); i++) {
+    auto &[name, function] = rows[i];
+    out += std::format("{:>10} {:>12} {:>12}  {}\n", function.calls, milliseconds(function.self_time), milliseconds(function.total_time), name);
+  }
+  return out;
+}
+
+std::string counts_json(const Counts &counts) {
+  std::string out = "{\"lines\": [\n";
+  size_t i = 0;
+  for (auto &[line, counted]: counts.lines) {
+    out += std::format("{{\"line\": {}, \"count\": {}, \"self_ns\": {}}}{}\n", line, counted.count, counted.self_time,
+                       ++i < counts.lines.size() ? "," : "");
+  }
+  out += "], \"functions\": [\n";
+  i = 0;
+  // Function names are identifiers or "anonymous", nothing to escape
+  for (auto &[name, function]: counts.functions) {
+    out += std::format("{{\"name\": \"{}\", \"calls\": {}, \"self_ns\": {}, \"total_ns\": {}}}{}\n", name, function.calls,
+                       function.self_time, function.total_time, ++i < counts.functions.size() ? "," : "");
+  }
+  out += "]}\n";
+  return out;
+}
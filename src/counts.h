@@ -0,0 +1,101 @@
+//
+// Execution counts of every line and function of a Monke program, like gcov.
+//
+// While counting, each statement the tree walker executes bumps the counter of its line and each call bumps the
+// counter of its callee. The clock is read at every one of these events and the time since the previous event is
+// charged to the innermost statement and call running, which gives self times that add up to the whole run. Each
+// thread counts into its own table, the tables are merged when counting stops.
+//
+
+#ifndef MONKE_CPP_COUNTS_H
+#define MONKE_CPP_COUNTS_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+class LineCounts {
+  public:
+  // Executions of the statements that start on the line
+  uint64_t count = 0;
+  // Nanoseconds spent in them, not counting nested statements
+  uint64_t self_time = 0;
+};
+
+class FunctionCounts {
+  public:
+  uint64_t calls = 0;
+  // Nanoseconds spent in its own code, and in its own code and its callees. Recursive calls count once in total_time
+  uint64_t self_time = 0;
+  uint64_t total_time = 0;
+};
+
+class Counts {
+  public:
+  // Every line a statement starts on, including the ones never executed
+  std::map<uint32_t, LineCounts> lines;
+  // Functions and builtins by the name they were called by
+  std::map<std::string, FunctionCounts> functions;
+};
+
+extern std::atomic<bool> counting;
+
+// Called by the parser for every statement, so lines that never run show up in the listing
+void declare_counted_line(uint32_t line);
+
+void enter_counted_line(uint32_t line);
+void leave_counted_line();
+void enter_counted_call(const std::string *name);
+void leave_counted_call();
+
+// One execution of a statement on the given line, for as long as it is in scope. A single branch when not counting
+class LineCount {
+  public:
+  explicit LineCount(uint32_t line) : entered(counting.load(std::memory_order_relaxed)) {
+    if (entered) enter_counted_line(line);
+  }
+  ~LineCount() {
+    if (entered) leave_counted_line();
+  }
+  LineCount(const LineCount &) = delete;
+  LineCount &operator=(const LineCount &) = delete;
+
+  private:
+  bool entered;
+};
+
+// One call, for as long as it is in scope. name must outlive the counts, e.g. be interned
+class CallCount {
+  public:
+  explicit CallCount(const std::string *name) : entered(counting.load(std::memory_order_relaxed)) {
+    if (entered) enter_counted_call(name);
+  }
+  ~CallCount() {
+    if (entered) leave_counted_call();
+  }
+  CallCount(const CallCount &) = delete;
+  CallCount &operator=(const CallCount &) = delete;
+
+  private:
+  bool entered;
+};
+
+// Clear every table and start counting
+void start_counting();
+
+// Stop counting and merge the tables of every thread
+Counts stop_counting();
+
+/**
+ * The source with the count and self time of each line in front of it, then the functions by self time.
+ *
+ * Lines with no statement show "-", lines whose statements never ran show "#####".
+ */
+std::string annotate_source(const Counts &counts, std::string_view source, size_t top = 20);
+
+// The counts as JSON: {"lines": [{"line", "count", "self_ns"}], "functions": [{"name", "calls", "self_ns", "total_ns"}]}
+std::string counts_json(const Counts &counts);
+
+#endif//MONKE_CPP_COUNTS_H
@@ -8,11 +8,24 @@
 #include <typeinfo>
 #include <variant>
 
+#include "allocation.h"
 #include "ast.h"
+#include "builtins.h"
+#include "counts.h"
+#include "event_log.h"
+#include "hash_table.h"
 #include "eval.h"
+#include "intern.h"
+#include "inline_cache.h"
+#include "isolate.h"
+#include "jit.h"
+#include "memo.h"
+#include "parallel.h"
 #include "lexer.h"
 #include "object.h"
 #include "parser.h"
+#include "profiler.h"
+#include "trace.h"
 
 ObjectResult eval_program(std::string input) {
   auto *l = new Lexer(input);
@@ -24,19 +37,47 @@ ObjectResult eval_program(std::string input) {
   return evaluate(program);
 }
 
+ObjectResult eval_program(std::string input, std::shared_ptr<Environment> env) {
+  auto *l = new Lexer(input);
+  Parser p = Parser(l);
+  Program program = p.parse_program();
+  if (program.error.has_value()) {
+    return std::unexpected(program.error.value());
+  }
+  return evaluate(program, env);
+}
+
 ObjectResult eval(Statement &node, std::shared_ptr<Environment> env) {
   return std::visit([&](auto &&arg) { return eval(arg, env); }, node);
 }
 
 ObjectResult eval(LetStatement &node, std::shared_ptr<Environment> env) {
+  LineCount count(node.token.line);
   return eval(node.value, env).and_then([&](auto value) -> ObjectResult { env->set(node.name.string(), value); return ObjectResult (Null()); });
 }
 
+namespace {
+  // Evaluate a statement of a block where the parser put it, get_statements would copy the whole subtree first
+  ObjectResult eval_in_place(const std::pair<StatementType, void *> &stmt, std::shared_ptr<Environment> env) {
+    switch (stmt.first) {
+      case StatementType::LS:
+        return eval(*reinterpret_cast<LetStatement *>(stmt.second), env);
+      case StatementType::BS:
+        return eval(*reinterpret_cast<BlockStatement *>(stmt.second), env);
+      case StatementType::RS:
+        return eval(*reinterpret_cast<ReturnStatement *>(stmt.second), env);
+      case StatementType::ES:
+        return eval(*reinterpret_cast<ExpressionStatement *>(stmt.second), env);
+      default:
+        unimplemented();
+    }
+  }
+}// namespace
+
 ObjectResult eval(BlockStatement &node, std::shared_ptr<Environment> env) {
   auto result = ObjectResult(Object(Null()));
-  auto statements = node.get_statements();
-  for (auto &stmt: statements) {
-    result = eval(stmt, env);
+  for (auto &stmt: node.statements) {
+    result = eval_in_place(stmt, env);
     if (!result.has_value()) return result;
     if (std::holds_alternative<ReturnObject>(result.value())) {
       return result;
@@ -46,7 +87,11 @@ ObjectResult eval(BlockStatement &node, std::shared_ptr<Environment> env) {
 }
 
 ObjectResult eval(ReturnStatement &node, std::shared_ptr<Environment> env) {
-  return eval(node.return_value, env).and_then([&](auto obj) { return ObjectResult(ReturnObject(new Object(obj))); });
+  LineCount count(node.token.line);
+  return eval(node.return_value, env).and_then([&](auto obj) {
+    AllocationScope allocations(AllocationSite::ReturnValue);
+    return ObjectResult(ReturnObject(new Object(obj)));
+  });
 }
 
 bool is_truthy(Object obj) {
@@ -76,11 +121,72 @@ ObjectResult eval(Expression &node, std::shared_ptr<Environment> env) {
   return std::visit([&](auto &&arg) { return eval(arg, env); }, node);
 }
 
-//ObjectResult eval(ArrayLiteral &node, std::shared_ptr<Environment> env) {
-//  return std::unexpected();
-//}
+ObjectResult eval(ArrayLiteral &node, std::shared_ptr<Environment> env) {
+  std::vector<Object> values;
+  {
+    AllocationScope allocations(AllocationSite::Collection);
+    values.reserve(node.elements.size());
+  }
+  for (auto *element: node.elements) {
+    auto value = eval(*element, env);
+    if (!value.has_value()) return value;
+    values.push_back(std::move(value.value()));
+  }
+  AllocationScope allocations(AllocationSite::Collection);
+  return Array::from(std::move(values));
+}
+
+ObjectResult eval(HashLiteral &node, std::shared_ptr<Environment> env) {
+  std::optional<HashTable> table;
+  {
+    AllocationScope allocations(AllocationSite::Collection);
+    table.emplace(node.pairs.size());
+  }
+  for (auto &[key_node, value_node]: node.pairs) {
+    std::optional<HashKey> key;
+    if (auto *literal = std::get_if<StringLiteral>(key_node); literal != nullptr && literal->symbol != nullptr) {
+      key = HashKey::symbol(literal->symbol);
+    } else {
+      auto key_obj = eval(*key_node, env);
+      if (!key_obj.has_value()) return key_obj;
+      key = HashKey::of(key_obj.value());
+      if (!key.has_value()) return std::unexpected(unusable_key_error(key_obj.value()));
+    }
+    auto value = eval(*value_node, env);
+    if (!value.has_value()) return value;
+    AllocationScope allocations(AllocationSite::Collection);
+    table->insert(key.value(), std::move(value.value()));
+  }
+  AllocationScope allocations(AllocationSite::Collection);
+  return Hash(std::move(table.value()));
+}
+
+ObjectResult eval(IndexExpression &node, std::shared_ptr<Environment> env) {
+  // Index a bound array where it is rather than copying the binding out first
+  Object *left = nullptr;
+  ObjectResult res = Object(Null());
+  if (auto *ident = std::get_if<Identifier>(node.left)) {
+    left = env->find(ident->token.literal);
+  }
+  if (left == nullptr) {
+    res = eval(*node.left, env);
+    if (!res.has_value()) return res;
+    left = &res.value();
+  }
+  // A literal key was interned by the parser, so the lookup is a probe on its address
+  if (auto *hash = std::get_if<Hash>(left)) {
+    if (auto *literal = std::get_if<StringLiteral>(node.index); literal != nullptr && literal->symbol != nullptr) {
+      const auto *value = hash->find(HashKey::symbol(literal->symbol));
+      return value != nullptr ? *value : Object(Null());
+    }
+  }
+  auto index = eval(*node.index, env);
+  if (!index.has_value()) return index;
+  return eval_index_expression(*left, index.value());
+}
 
 ObjectResult eval(ExpressionStatement &node, std::shared_ptr<Environment> env) {
+  LineCount count(node.token.line);
   return eval(node.e, std::move(env));
 }
 
@@ -93,6 +199,7 @@ ObjectResult eval(FloatLiteral &node, std::shared_ptr<Environment>) {
 }
 
 ObjectResult eval(StringLiteral &node, std::shared_ptr<Environment>) {
+  if (node.symbol != nullptr) return String::symbol(node.symbol);
   return String(node.value);
 }
 
@@ -120,22 +227,22 @@ ObjectResult eval(InfixExpression &node, std::shared_ptr<Environment> env) {
           .and_then([&](auto obj) -> ObjectResult {
             // TODO : Can we destructure this?
             auto [left, right] = obj;
-            if (left.index() != right.index()) {
-              auto err = std::format("type mismatch: {} {} {}", get_type_name(left), node.op, get_type_name(right));
-              return std::unexpected(TypeError(err));
-            }
             return eval_infix_expression(node.op, left, right, env);
           });
 };
 ObjectResult eval(Identifier &node, std::shared_ptr<Environment> env) {
+  // Bindings shadow builtins
+  if (auto *obj = env->find(node.token.literal)) return *obj;
+  if (auto *builtin = find_builtin(node.token.literal)) return *builtin;
   return env->get(node.string());
 }
 
 
 ObjectResult eval(FunctionLiteral &node, std::shared_ptr<Environment> env) {
+  AllocationScope allocations(AllocationSite::Closure);
   std::vector<Identifier> params;
   std::transform(node.parameters.begin(), node.parameters.end(), std::back_inserter(params), [](Identifier *i) { return *i; });
-  return Function(params, *node.body, env);
+  return Function(params, *node.body, env, node.body);
 }
 
 std::vector<ObjectResult> eval_expressions(std::vector<Expression> &expressions, std::shared_ptr<Environment> env) {
@@ -149,25 +256,95 @@ std::vector<ObjectResult> eval_expressions(std::vector<Expression> &expressions,
 }
 
 ObjectResult eval(CallExpression &node, std::shared_ptr<Environment> env) {
-  // Either functionliteral or ident
-  auto res = eval(*node.function, env);
-  if (!res.has_value()) return res;
-  std::vector<Expression> arg_exes;
-  std::transform(node.arguments.begin(), node.arguments.end(), std::back_inserter(arg_exes), [](Expression *e) { return *e; });
-  auto args_ex = eval_expressions(arg_exes, env);
-  if (!args_ex.back().has_value()) return args_ex.back();
+  // Caches and tiers are shared by every thread running this code in the isolate, so pool threads leave them alone
+  bool tiered = !in_parallel_worker();
+  CallSiteCache &cache = tiered ? call_site_cache(node) : *node.cache;
+
+  // Either functionliteral or ident. Identifiers are resolved through the site's cache and used in place
+  Object *callee = nullptr;
+  ObjectResult res = Object(Null());
+  if (auto *ident = std::get_if<Identifier>(node.function); ident != nullptr && tiered) {
+    callee = cache.resolve(ident->token.literal, *env);
+  }
+  if (callee == nullptr) {
+    res = eval(*node.function, env);
+    if (!res.has_value()) return res;
+    callee = &res.value();
+  }
 
   std::vector<Object> args;
-  std::transform(args_ex.begin(), args_ex.end(), std::back_inserter(args), [](const auto a) { return a.value(); });
+  {
+    AllocationScope allocations(AllocationSite::Arguments);
+    args.reserve(node.arguments.size());
+  }
+  for (auto *arg: node.arguments) {
+    auto arg_res = eval(*arg, env);
+    if (!arg_res.has_value()) return arg_res;
+    args.push_back(std::move(arg_res.value()));
+  }
+  ProfileFrame frame(node.callee_name);
+  CallCount count(node.callee_name);
+  AllocationFunction allocations(node.callee_name);
+  TraceScope trace(*node.callee_name, TraceCategory::Call);
+  log_event<EventLevel::Trace>(EventKind::Call, *node.callee_name, static_cast<int64_t>(args.size()));
+
+  // Builtins take the arguments where they are, no frame or tiering needed
+  if (auto *builtin = std::get_if<Builtin>(callee)) {
+    return call_builtin(*builtin, args);
+  }
+
+  auto *fn = std::get_if<Function>(callee);
+  if (fn == nullptr) {
+    // Bound by the host, see Isolate::call
+    if (auto *native = std::get_if<NativeFunction>(callee)) {
+      if (native->arity != args.size()) {
+        return std::unexpected(TypeError(std::format("wrong number of arguments: want={}, got={}", native->arity, args.size())));
+      }
+      return native->fn(args);
+    }
+    return std::unexpected(TypeError(std::format("not a function: {}", get_type_name(*callee))));
+  }
 
-  if (!std::holds_alternative<Function>(res.value())) {
-    unimplemented();// If this happens something has gone wrong
+  // A cache hit already knows the arity matches and how to lay out the frame
+  auto *entry = tiered ? cache.lookup(*fn, args.size()) : nullptr;
+  auto call = [&]() -> ObjectResult {
+    if (tiered && jit_config().enabled && fn->source != nullptr) {
+      static const std::string anonymous = "anonymous";
+      auto &profile = entry != nullptr ? *entry->profile : jit_profile(fn->source);
+      auto *ident = std::get_if<Identifier>(node.function);
+      if (auto native = jit_call(*fn, args, profile, ident != nullptr ? ident->token.literal : anonymous)) {
+        return native.value();
+      }
+    }
+    if (entry != nullptr) {
+      auto extended_env = extend_function_env(*fn, args, *entry);
+      auto evaluated = eval(fn->body, extended_env);
+      return unwrap_return_value(evaluated);
+    }
+    return apply_function(*fn, args);
+  };
+
+  if (tiered && memo_config().enabled) {
+    if (auto *table = memo_table(*fn, args)) {
+      if (auto *hit = table->find(args)) {
+        memo_stats().hits++;
+        return *hit;
+      }
+      memo_stats().misses++;
+      // The call may consume args, and the table may be refilled by recursive calls in the meantime
+      auto key = args;
+      auto result = call();
+      if (result.has_value() && !std::holds_alternative<Function>(result.value()) && !std::holds_alternative<NativeFunction>(result.value())) {
+        table->insert(std::move(key), result.value(), memo_config().capacity);
+      }
+      return result;
+    }
   }
-  auto fn = std::get<Function>(res.value());
-  return apply_function(fn, args);
+  return call();
 }
 
 std::shared_ptr<Environment> enclose_env(std::shared_ptr<Environment> outer) {
+  AllocationScope allocations(AllocationSite::Environment);
   std::shared_ptr<Environment> env = std::make_shared<Environment>(Environment());
   env->outer = outer;
   return env;
@@ -185,6 +362,18 @@ std::shared_ptr<Environment> extend_function_env(Function &fn, std::vector<Objec
   return env;
 }
 
+std::shared_ptr<Environment> extend_function_env(Function &fn, std::vector<Object> &args, const CalleeEntry &entry) {
+  auto env = enclose_env(fn.env);
+  {
+    AllocationScope allocations(AllocationSite::Binding);
+    env->env.reserve(entry.frame.size());
+  }
+  for (size_t i = 0; i < args.size(); i++) {
+    env->set(entry.frame[i], std::move(args[i]));
+  }
+  return env;
+}
+
 ObjectResult apply_function(Function &fn, std::vector<Object> &args) {
   auto extended_env = extend_function_env(fn, args);
   auto evaluated = eval(fn.body, extended_env);
@@ -201,11 +390,27 @@ ObjectResult unwrap_return_value(ObjectResult &obj_res) {
 }
 
 ObjectResult evaluate(Program &node) {
-  auto env = std::make_shared<Environment>(Environment());
+  std::shared_ptr<Environment> env;
+  {
+    AllocationScope allocations(AllocationSite::Environment);
+    env = std::make_shared<Environment>(Environment());
+  }
+  return evaluate(node, env);
+}
+
+ObjectResult evaluate(Program &node, std::shared_ptr<Environment> env) {
+  TraceScope trace("evaluate");
+  if (parallel_config().enabled && node.statements.size() > 1) {
+    return evaluate_parallel(node, env);
+  }
   auto result = ObjectResult(Object(Null()));
   for (auto &stmt: node.statements) {
     result = eval(stmt, env);
-    if (!result.has_value()) return result;
+    if (!result.has_value()) {
+      // Messages hold runtime values, so they are copied into the log rather than interned
+      if (event_enabled<EventLevel::Error>()) record_event_copy(EventLevel::Error, EventKind::Error, get_msg(result.error()), 0, 0);
+      return result;
+    }
     if (std::holds_alternative<ReturnObject>(result.value())) {
       return *std::get<ReturnObject>(result.value()).value;
     }
@@ -214,6 +419,11 @@ ObjectResult evaluate(Program &node) {
 }
 
 ObjectResult eval_infix_expression(std::string &op, Object &left, Object &right, std::shared_ptr<Environment> env) {
+  if (left.index() != right.index()) {
+    auto err = std::format("type mismatch: {} {} {}", get_type_name(left), op, get_type_name(right));
+    return std::unexpected(TypeError(err));
+  }
+
   /*
    * Infix operators for booleans
    */
@@ -231,10 +441,10 @@ ObjectResult eval_infix_expression(std::string &op, Object &left, Object &right,
    */
   if (std::holds_alternative<String>(left) && std::holds_alternative<String>(right)) {
     if (op == "==") {
-      return Boolean(std::get<String>(left).value == std::get<String>(right).value);
+      return Boolean(std::get<String>(left) == std::get<String>(right));
     }
     if (op == "+") {
-      return String(std::get<String>(left).value + std::get<String>(right).value);
+      return std::get<String>(left) + std::get<String>(right);
     }
   }
 
@@ -294,6 +504,30 @@ ObjectResult eval_infix_expression(std::string &op, Object &left, Object &right,
   return std::unexpected(TypeError(err));
 }
 
+ObjectResult eval_index_expression(Object &left, Object &index) {
+  auto *i = std::get_if<Integer>(&index);
+  if (auto *array = std::get_if<Array>(&left); array != nullptr && i != nullptr) {
+    if (i->value < 0 || static_cast<size_t>(i->value) >= array->size()) return Null();
+    return array->at(static_cast<size_t>(i->value));
+  }
+  if (auto *vec = std::get_if<Vec>(&left); vec != nullptr && i != nullptr) {
+    if (i->value < 0 || static_cast<size_t>(i->value) >= vec->size()) return Null();
+    return vec->at(static_cast<size_t>(i->value));
+  }
+  if (auto *s = std::get_if<String>(&left); s != nullptr && i != nullptr) {
+    if (i->value < 0 || static_cast<size_t>(i->value) >= s->size()) return Null();
+    return Char(s->value()[static_cast<size_t>(i->value)]);
+  }
+  if (auto *hash = std::get_if<Hash>(&left)) {
+    if (!HashKey::hashable(index)) return std::unexpected(unusable_key_error(index));
+    auto key = HashKey::find(index);
+    const auto *value = key.has_value() ? hash->find(key.value()) : nullptr;
+    return value != nullptr ? *value : Object(Null());
+  }
+  auto err = std::format("index operator not supported: {}[{}]", get_type_name(left), get_type_name(index));
+  return std::unexpected(TypeError(err));
+}
+
 ObjectResult eval_prefix_expression(std::string &op, Object &right, std::shared_ptr<Environment> env) {
   if (op == "!") {
     if (auto *b = std::get_if<Boolean>(&right)) {
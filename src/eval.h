@@ -7,12 +7,14 @@
 
 #include <optional>
 
+#include "inline_cache.h"
 #include "object.h"
 #include "parser.h"
 #include "ast.h"
 
 // Evaluation functions
 ObjectResult evaluate(Program &node);
+ObjectResult evaluate(Program &node, std::shared_ptr<Environment> env);
 ObjectResult eval(Statement &node, std::shared_ptr<Environment> env);
 ObjectResult eval(IntegerLiteral &node, std::shared_ptr<Environment> env);
 ObjectResult eval(FloatLiteral &node, std::shared_ptr<Environment> env);
@@ -30,15 +32,21 @@ ObjectResult eval(CharLiteral &node, std::shared_ptr<Environment> env);
 ObjectResult eval(CallExpression &node, std::shared_ptr<Environment> env);
 ObjectResult eval(IfExpression &node, std::shared_ptr<Environment> env);
 ObjectResult eval(FunctionLiteral &node, std::shared_ptr<Environment> env);
+ObjectResult eval(ArrayLiteral &node, std::shared_ptr<Environment> env);
+ObjectResult eval(HashLiteral &node, std::shared_ptr<Environment> env);
+ObjectResult eval(IndexExpression &node, std::shared_ptr<Environment> env);
 
 // Helper evaluation functions
 ObjectResult eval_program(std::string program);
+ObjectResult eval_program(std::string program, std::shared_ptr<Environment> env);
 ObjectResult eval_prefix_expression(std::string &op, Object &right, std::shared_ptr<Environment> env);
 ObjectResult eval_infix_expression(std::string &op, Object &left, Object &right, std::shared_ptr<Environment> env);
+ObjectResult eval_index_expression(Object &left, Object &index);
 std::vector<ObjectResult> eval_expressions(std::vector<Expression> &expressions, Environment &env);
 ObjectResult apply_function(Function &fn, std::vector<Object> &args);
 std::shared_ptr<Environment> extend_function_env(Function &fn, std::vector<Object> &args);
-std::shared_ptr<Environment> enclose_env(Environment* outer);
+std::shared_ptr<Environment> extend_function_env(Function &fn, std::vector<Object> &args, const CalleeEntry &entry);
+std::shared_ptr<Environment> enclose_env(std::shared_ptr<Environment> outer);
 ObjectResult unwrap_return_value(ObjectResult &obj);
 
 template <typename FROM, typename TO>
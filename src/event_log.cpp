@@ -0,0 +1,200 @@
+//
+// Per-thread event buffers and their binary dump.
+//
+// A dump is the magic "MONKEEV1", a table of the names the records use (a u32 count, then a u32 length and the bytes
+// of each), a u64 record count and that many 40 byte records: u64 nanoseconds since the first record, u32 thread,
+// u32 name index, i64 a, i64 b, u8 kind, u8 level and 6 bytes of padding. Numbers are in host byte order.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "event_log.h"
+#include "trace.h"
+
+std::atomic<bool> event_logging = false;
+
+namespace {
+  constexpr std::string_view MAGIC = "MONKEEV1";
+  constexpr size_t RECORD_SIZE = 40;
+
+  // Every thread's buffer, kept after the thread exits so its events can still be dumped
+  std::mutex buffers_mutex;
+  std::vector<std::unique_ptr<EventBuffer>> buffers;
+  thread_local EventBuffer *thread_buffer = nullptr;
+
+  EventBuffer &buffer_for_thread() {
+    if (thread_buffer == nullptr) {
+      std::lock_guard lock(buffers_mutex);
+      buffers.push_back(std::make_unique<EventBuffer>());
+      buffers.back()->thread = static_cast<uint32_t>(buffers.size());
+      thread_buffer = buffers.back().get();
+    }
+    return *thread_buffer;
+  }
+
+  template <typename T>
+  void put(std::string &out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+  }
+
+  // Reads from the front of data, failing once it runs out
+  class Reader {
+    public:
+    std::string_view data;
+    bool ok = true;
+
+    template <typename T>
+    T get() {
+      T value{};
+      if (data.size() < sizeof(T)) {
+        ok = false;
+        return value;
+      }
+      std::memcpy(&value, data.data(), sizeof(T));
+      data.remove_prefix(sizeof(T));
+      return value;
+    }
+
+    std::string_view bytes(size_t size) {
+      if (data.size() < size) {
+        ok = false;
+        return {};
+      }
+      auto out = data.substr(0, size);
+      data.remove_prefix(size);
+      return out;
+    }
+  };
+
+  const char *level_name(uint8_t level) {
+    switch (static_cast<EventLevel>(level)) {
+      case EventLevel::Trace:
+        return "trace";
+      case EventLevel::Debug:
+        return "debug";
+      case EventLevel::Info:
+        return "info";
+      case EventLevel::Warn:
+        return "warn";
+      case EventLevel::Error:
+        return "error";
+    }
+    return "?";
+  }
+
+  const char *kind_name(uint8_t kind) {
+    switch (static_cast<EventKind>(kind)) {
+      case EventKind::Start:
+        return "start";
+      case EventKind::Lex:
+        return "lex";
+      case EventKind::LookupMiss:
+        return "lookup_miss";
+      case EventKind::Call:
+        return "call";
+      case EventKind::Error:
+        return "error";
+    }
+    return "?";
+  }
+}// namespace
+
+void record_event(EventLevel level, EventKind kind, std::string_view name, int64_t a, int64_t b) {
+  auto &buffer = buffer_for_thread();
+  auto written = buffer.written.load(std::memory_order_relaxed);
+  buffer.records[written % EVENT_LOG_RECORDS] = {trace_clock(), name, a, b, kind, level};
+  buffer.written.store(written + 1, std::memory_order_release);
+}
+
+void record_event_copy(EventLevel level, EventKind kind, std::string_view name, int64_t a, int64_t b) {
+  auto &buffer = buffer_for_thread();
+  auto written = buffer.written.load(std::memory_order_relaxed);
+  auto slot = written % EVENT_LOG_RECORDS;
+  if (buffer.names.empty()) buffer.names.resize(EVENT_LOG_RECORDS);
+  // The record this slot held before is gone, so its copy may be overwritten too
+  buffer.names[slot] = name;
+  buffer.records[slot] = {trace_clock(), buffer.names[slot], a, b, kind, level};
+  buffer.written.store(written + 1, std::memory_order_release);
+}
+
+void start_event_log() {
+  {
+    std::lock_guard lock(buffers_mutex);
+    for (auto &buffer: buffers) buffer->written = 0;
+  }
+  event_logging = true;
+}
+
+std::string dump_event_log() {
+  event_logging = false;
+  std::vector<std::pair<uint32_t, EventRecord>> records;
+  {
+    std::lock_guard lock(buffers_mutex);
+    for (auto &buffer: buffers) {
+      auto written = buffer->written.load(std::memory_order_acquire);
+      auto kept = std::min<uint64_t>(written, EVENT_LOG_RECORDS);
+      for (auto i = written - kept; i < written; i++) records.emplace_back(buffer->thread, buffer->records[i % EVENT_LOG_RECORDS]);
+    }
+  }
+  std::stable_sort(records.begin(), records.end(), [](auto &a, auto &b) { return a.second.time < b.second.time; });
+
+  std::unordered_map<std::string_view, uint32_t> indices;
+  std::vector<std::string_view> names;
+  for (auto &[thread, record]: records) {
+    if (indices.emplace(record.name, static_cast<uint32_t>(names.size())).second) names.push_back(record.name);
+  }
+
+  std::string out(MAGIC);
+  put(out, static_cast<uint32_t>(names.size()));
+  for (auto name: names) {
+    put(out, static_cast<uint32_t>(name.size()));
+    out += name;
+  }
+  put(out, static_cast<uint64_t>(records.size()));
+  uint64_t first = records.empty() ? 0 : records.front().second.time;
+  for (auto &[thread, record]: records) {
+    put(out, record.time - first);
+    put(out, thread);
+    put(out, indices[record.name]);
+    put(out, record.a);
+    put(out, record.b);
+    put(out, static_cast<uint8_t>(record.kind));
+    put(out, static_cast<uint8_t>(record.level));
+    out.append(6, '\0');
+  }
+  return out;
+}
+
+std::optional<std::string> decode_event_log(std::string_view data) {
+  if (!data.starts_with(MAGIC)) return std::nullopt;
+  Reader in{data.substr(MAGIC.size())};
+
+  std::vector<std::string_view> names(in.get<uint32_t>());
+  for (auto &name: names) name = in.bytes(in.get<uint32_t>());
+  auto count = in.get<uint64_t>();
+  if (!in.ok || in.data.size() != count * RECORD_SIZE) return std::nullopt;
+
+  std::string out = std::format("{:>12} {:>6} {:>5} {:>11} {} {} {}\n", "us", "thread", "level", "kind", "name", "a", "b");
+  for (uint64_t i = 0; i < count; i++) {
+    auto time = in.get<uint64_t>();
+    auto thread = in.get<uint32_t>();
+    auto name = in.get<uint32_t>();
+    auto a = in.get<int64_t>();
+    auto b = in.get<int64_t>();
+    auto kind = in.get<uint8_t>();
+    auto level = in.get<uint8_t>();
+    in.bytes(6);
+    if (name >= names.size()) return std::nullopt;
+    out += std::format("{:>12.3f} {:>6} {:>5} {:>11} {} {} {}\n", static_cast<double>(time) / 1e3, thread, level_name(level),
+                       kind_name(kind), names[name], a, b);
+  }
+  return out;
+}
@@ -0,0 +1,111 @@
+//
+// Binary log of interpreter events: failed lookups, errors, calls and the like.
+//
+// Each thread appends fixed size records to its own ring buffer, so logging takes no locks and does no I/O; a full
+// buffer overwrites its oldest records. Events below MONKE_EVENT_LEVEL are compiled out, the rest cost one branch
+// while the log is not recording. dump_event_log writes the buffers in a compact binary form that
+// decode_event_log turns back into text, e.g. with `monke_cpp events FILE`.
+//
+
+#ifndef MONKE_CPP_EVENT_LOG_H
+#define MONKE_CPP_EVENT_LOG_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Least severe level compiled in, set by the build. Calls are logged at Trace, so they are left out by default
+#ifndef MONKE_EVENT_LEVEL
+#define MONKE_EVENT_LEVEL 1
+#endif
+
+// Records each thread keeps
+constexpr size_t EVENT_LOG_RECORDS = size_t(1) << 14;
+
+enum class EventLevel : uint8_t {
+  Trace,
+  Debug,
+  Info,
+  Warn,
+  Error,
+};
+
+enum class EventKind : uint8_t {
+  // The process started; a is the number of arguments
+  Start,
+  // A lexer was created; a is the length of its input
+  Lex,
+  // An identifier was not bound in any scope
+  LookupMiss,
+  // A call of a Monke function or builtin; a is the number of arguments
+  Call,
+  // Lexing or evaluation failed, name is the message
+  Error,
+};
+
+class EventRecord {
+  public:
+  // Nanoseconds on the steady clock
+  uint64_t time;
+  // Must outlive the log: a literal, an interned string or the buffer's own copy
+  std::string_view name;
+  int64_t a;
+  int64_t b;
+  EventKind kind;
+  EventLevel level;
+};
+
+// The records of one thread. Only that thread writes, readers must wait until it is done
+class EventBuffer {
+  public:
+  uint32_t thread;
+  std::array<EventRecord, EVENT_LOG_RECORDS> records;
+  // Copies of names logged with record_event_copy, by record slot. Allocated on first use
+  std::vector<std::string> names;
+  // Records ever written; the newest EVENT_LOG_RECORDS of them are still here
+  std::atomic<uint64_t> written = 0;
+};
+
+extern std::atomic<bool> event_logging;
+
+void record_event(EventLevel level, EventKind kind, std::string_view name, int64_t a, int64_t b);
+
+// Like record_event, but name is copied into the thread's buffer, so it may be a temporary
+void record_event_copy(EventLevel level, EventKind kind, std::string_view name, int64_t a, int64_t b);
+
+// Whether an event at level would be recorded. Check it before building a name that costs anything to make
+template <EventLevel level>
+inline bool event_enabled() {
+  if constexpr (static_cast<int>(level) >= MONKE_EVENT_LEVEL) {
+    return event_logging.load(std::memory_order_relaxed);
+  } else {
+    return false;
+  }
+}
+
+// Log an event if its level is compiled in and the log is recording
+template <EventLevel level>
+inline void log_event(EventKind kind, std::string_view name = {}, int64_t a = 0, int64_t b = 0) {
+  if (event_enabled<level>()) record_event(level, kind, name, a, b);
+}
+
+// Log an event with a name that does not outlive the call
+template <EventLevel level>
+inline void log_event_copy(EventKind kind, std::string_view name, int64_t a = 0, int64_t b = 0) {
+  if (event_enabled<level>()) record_event_copy(level, kind, name, a, b);
+}
+
+// Clear every buffer and start recording
+void start_event_log();
+
+// Stop recording and return what the buffers hold, oldest first
+std::string dump_event_log();
+
+// One line per record: microseconds since the first, thread, level, kind, name, a and b. nullopt if data is not a dump
+std::optional<std::string> decode_event_log(std::string_view data);
+
+#endif//MONKE_CPP_EVENT_LOG_H
@@ -0,0 +1,176 @@
+//
+// The open addressing table behind Hash values.
+//
+
+#include <bit>
+#include <format>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hash_table.h"
+#include "intern.h"
+#include "utils.h"
+
+namespace {
+  // Full slots hold the low seven bits of the hash, so only empty ones have the sign bit set
+  constexpr int8_t EMPTY = -128;
+
+  // Bit i is set when the group's control byte i equals tag
+  uint32_t match_byte(const int8_t *group, int8_t tag) {
+#if defined(__SSE2__)
+    auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < HashTable::GROUP_WIDTH; i++) mask |= static_cast<uint32_t>(group[i] == tag) << i;
+    return mask;
+#endif
+  }
+
+  uint32_t match_empty(const int8_t *group) {
+#if defined(__SSE2__)
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(group))));
+#else
+    return match_byte(group, EMPTY);
+#endif
+  }
+
+  int8_t h2(uint64_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+
+  // Triangular steps over a power of two number of groups visit every group once
+  class Probe {
+    public:
+    Probe(uint64_t hash, size_t groups) : mask(groups - 1), group((hash >> 7) & mask) {}
+    size_t mask;
+    size_t group;
+    size_t step = 0;
+    void next() { group = (group + ++step) & mask; }
+  };
+}// namespace
+
+bool HashKey::hashable(const Object &obj) {
+  return std::holds_alternative<Integer>(obj) || std::holds_alternative<Boolean>(obj) || std::holds_alternative<Char>(obj) ||
+         std::holds_alternative<String>(obj);
+}
+
+std::optional<HashKey> HashKey::of(const Object &obj) {
+  auto *s = std::get_if<String>(&obj);
+  if (s == nullptr) return find(obj);
+  if (s->interned() != nullptr) return symbol(s->interned());
+  // Interning every string a script builds would keep them all for good
+  auto shared = intern_shared(s->value());
+  auto key = symbol(shared.get());
+  key.owner = std::move(shared);
+  return key;
+}
+
+std::optional<HashKey> HashKey::find(const Object &obj) {
+  return std::visit(overloads{
+                            [](const Integer &i) -> std::optional<HashKey> { return HashKey{Kind::Integer, static_cast<uint64_t>(i.value)}; },
+                            [](const Boolean &b) -> std::optional<HashKey> { return HashKey{Kind::Boolean, b.value}; },
+                            [](const Char &c) -> std::optional<HashKey> { return HashKey{Kind::Char, static_cast<uint8_t>(c.value)}; },
+                            [](const String &s) -> std::optional<HashKey> {
+                              auto *interned = s.interned() != nullptr ? s.interned() : find_interned(s.value());
+                              if (interned == nullptr) return std::nullopt;
+                              return symbol(interned);
+                            },
+                            [](const auto &) -> std::optional<HashKey> { return std::nullopt; },
+                    },
+                    obj);
+}
+
+HashKey HashKey::symbol(const std::string *interned) {
+  return {Kind::String, reinterpret_cast<uintptr_t>(interned)};
+}
+
+Object HashKey::object() const {
+  switch (kind) {
+    case Kind::Integer:
+      return Integer(static_cast<int64_t>(bits));
+    case Kind::Boolean:
+      return Boolean(bits != 0);
+    case Kind::Char:
+      return Char(static_cast<char>(bits));
+    case Kind::String:
+      // A shared copy goes with the last key, so the value gets its own
+      if (owner != nullptr) return String(std::string_view(*owner));
+      return String::symbol(reinterpret_cast<const std::string *>(bits));
+  }
+  unimplemented();
+}
+
+uint64_t HashKey::hash() const {
+  // The 64 bit finalizer of MurmurHash3, so that small integers and aligned pointers spread over every bit
+  uint64_t x = bits ^ (static_cast<uint64_t>(kind) << 61);
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+HashTable::HashTable(size_t n) {
+  entries.reserve(n);
+  size_t wanted = 1;
+  while (wanted * GROUP_WIDTH * 7 < n * 8) wanted *= 2;
+  if (n > 0) rehash(wanted);
+}
+
+const Object *HashTable::find(const HashKey &key) const {
+  if (groups == 0) return nullptr;
+  auto slot = find_slot(key, key.hash());
+  return slot.has_value() ? &entries[slots[slot.value()]].second : nullptr;
+}
+
+void HashTable::insert(const HashKey &key, Object value) {
+  auto hash = key.hash();
+  if (groups > 0) {
+    if (auto slot = find_slot(key, hash)) {
+      entries[slots[slot.value()]].second = std::move(value);
+      return;
+    }
+  }
+  if ((entries.size() + 1) * 8 > groups * GROUP_WIDTH * 7) rehash(groups == 0 ? 1 : groups * 2);
+  auto slot = free_slot(hash);
+  control[slot] = h2(hash);
+  slots[slot] = static_cast<uint32_t>(entries.size());
+  entries.emplace_back(key, std::move(value));
+}
+
+std::optional<size_t> HashTable::find_slot(const HashKey &key, uint64_t hash) const {
+  for (Probe probe(hash, groups);; probe.next()) {
+    const int8_t *group = &control[probe.group * GROUP_WIDTH];
+    for (auto match = match_byte(group, h2(hash)); match != 0; match &= match - 1) {
+      size_t slot = probe.group * GROUP_WIDTH + static_cast<size_t>(std::countr_zero(match));
+      if (entries[slots[slot]].first == key) return slot;
+    }
+    if (match_empty(group) != 0) return std::nullopt;
+  }
+}
+
+size_t HashTable::free_slot(uint64_t hash) const {
+  for (Probe probe(hash, groups);; probe.next()) {
+    if (auto empty = match_empty(&control[probe.group * GROUP_WIDTH])) {
+      return probe.group * GROUP_WIDTH + static_cast<size_t>(std::countr_zero(empty));
+    }
+  }
+}
+
+void HashTable::rehash(size_t new_groups) {
+  groups = new_groups;
+  control.assign(groups * GROUP_WIDTH, EMPTY);
+  slots.assign(groups * GROUP_WIDTH, 0);
+  for (size_t i = 0; i < entries.size(); i++) {
+    auto hash = entries[i].first.hash();
+    auto slot = free_slot(hash);
+    control[slot] = h2(hash);
+    slots[slot] = static_cast<uint32_t>(i);
+  }
+}
+
+TypeError unusable_key_error(Object &obj) {
+  return TypeError(std::format("unusable as hash key: {}", get_type_name(obj)));
+}
@@ -0,0 +1,89 @@
+//
+// The open addressing table behind Hash values.
+//
+// Slots are grouped sixteen to a control group. Each slot has a control byte holding either EMPTY or the low seven bits
+// of its key's hash, so a probe compares a whole group's bytes against the wanted hash at once (one SSE2 compare where
+// available) and only looks at the keys of slots whose byte matched. Entries live in a dense vector in insertion order,
+// the slots only hold indices into it, which keeps the probed memory small and makes iteration order deterministic.
+//
+
+#ifndef MONKE_CPP_HASH_TABLE_H
+#define MONKE_CPP_HASH_TABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "object.h"
+
+/*
+ * An Integer, Boolean, Char or String used as a key.
+ *
+ * String keys refer to the unique copy of their characters (see intern.h), so keys compare and hash by their bits alone,
+ * without looking at any characters. Literal keys are interned; keys built at run time share their copy, which is
+ * freed with the last key using it.
+ */
+class HashKey {
+  public:
+  enum class Kind : uint8_t {
+    Integer,
+    Boolean,
+    Char,
+    String
+  };
+  Kind kind;
+  // The value, or the address of the string's unique copy
+  uint64_t bits;
+  // Keeps the copy of a string key built at run time alive, nullptr for every other key
+  std::shared_ptr<const std::string> owner = nullptr;
+
+  static bool hashable(const Object &obj);
+  // The key for obj, sharing a string that is not interned. nullopt if obj is not hashable
+  static std::optional<HashKey> of(const Object &obj);
+  // Like of, but never adds a string: a string that is neither interned nor shared is in no table, so it has no key
+  static std::optional<HashKey> find(const Object &obj);
+  // The key for an already interned string
+  static HashKey symbol(const std::string *interned);
+
+  Object object() const;
+  uint64_t hash() const;
+  bool operator==(const HashKey &other) const { return kind == other.kind && bits == other.bits; }
+};
+
+class HashTable {
+  public:
+  static constexpr size_t GROUP_WIDTH = 16;
+
+  HashTable() = default;
+  // Room for n entries before the first rehash
+  explicit HashTable(size_t n);
+
+  // nullptr if key is absent
+  const Object *find(const HashKey &key) const;
+  // Add key, or replace its value
+  void insert(const HashKey &key, Object value);
+  size_t size() const { return entries.size(); }
+  // Every entry, in the order its key was first inserted
+  const std::vector<std::pair<HashKey, Object>> &items() const { return entries; }
+
+  private:
+  std::vector<std::pair<HashKey, Object>> entries;
+  // One byte per slot
+  std::vector<int8_t> control;
+  // Index into entries per full slot
+  std::vector<uint32_t> slots;
+  // Always a power of two, so probing can mask instead of divide
+  size_t groups = 0;
+
+  std::optional<size_t> find_slot(const HashKey &key, uint64_t hash) const;
+  // An empty slot in the probe sequence for hash. There is always one, the table is kept at most 7/8 full
+  size_t free_slot(uint64_t hash) const;
+  void rehash(size_t new_groups);
+};
+
+// The error for using obj as a key
+TypeError unusable_key_error(Object &obj);
+
+#endif//MONKE_CPP_HASH_TABLE_H
@@ -0,0 +1,372 @@
+//
+// Heap snapshots and retained sizes.
+//
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <map>
+#include <unordered_map>
+#include <variant>
+
+#include "hash_table.h"
+#include "heap_snapshot.h"
+#include "persistent_map.h"
+#include "rope.h"
+
+namespace {
+  constexpr std::string_view SNAPSHOT_HEADER = "monke heap snapshot\n";
+
+  // What make_shared puts in front of the object: the vtable and both counts
+  constexpr size_t CONTROL_BLOCK = 2 * sizeof(void *);
+  // The next pointer and cached hash of an unordered_map node
+  constexpr size_t MAP_NODE = 2 * sizeof(void *);
+
+  constexpr HeapNodeKind KINDS[] = {
+          HeapNodeKind::Root, HeapNodeKind::Environment, HeapNodeKind::Binding, HeapNodeKind::Function,
+          HeapNodeKind::String, HeapNodeKind::Array, HeapNodeKind::Hash, HeapNodeKind::Boxed,
+  };
+
+  size_t string_heap(const std::string &s) {
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+  }
+
+  class SnapshotBuilder {
+    public:
+    HeapSnapshot snapshot;
+
+    explicit SnapshotBuilder(const std::vector<std::shared_ptr<Environment>> &roots) {
+      add(HeapNodeKind::Root, 0);
+      for (auto &root: roots) {
+        auto id = environment(root.get());
+        snapshot.nodes[0].edges.push_back(id);
+      }
+      // Iteratively, scope chains and ropes can be far deeper than the stack
+      while (!pending.empty()) {
+        auto [id, block] = std::move(pending.back());
+        pending.pop_back();
+        std::visit([&, id = id](auto &b) { expand(id, b); }, block);
+      }
+    }
+
+    private:
+    using Block = std::variant<const Environment *, const Rope *, Array, Hash, const Object *>;
+    std::unordered_map<const void *, uint32_t> ids;
+    // Function values are copied into every binding and element holding them, so they are told apart by their scope and code
+    std::map<std::pair<const void *, const void *>, uint32_t> functions;
+    // Nodes whose edges are yet to be found, with the block they stand for
+    std::vector<std::pair<uint32_t, Block>> pending;
+
+    uint32_t add(HeapNodeKind kind, uint64_t self_size) {
+      HeapNode node;
+      node.kind = kind;
+      node.self_size = self_size;
+      snapshot.nodes.push_back(std::move(node));
+      return static_cast<uint32_t>(snapshot.nodes.size() - 1);
+    }
+
+    // The node for a block, and whether it was just added
+    std::pair<uint32_t, bool> find_or_add(const void *address, HeapNodeKind kind, uint64_t self_size) {
+      if (auto it = ids.find(address); it != ids.end()) return {it->second, false};
+      auto id = add(kind, self_size);
+      ids[address] = id;
+      return {id, true};
+    }
+
+    uint32_t environment(const Environment *env) {
+      auto self_size = CONTROL_BLOCK + sizeof(Environment) + env->env.bucket_count() * sizeof(void *);
+      auto [id, added] = find_or_add(env, HeapNodeKind::Environment, self_size);
+      if (added) pending.emplace_back(id, env);
+      return id;
+    }
+
+    uint32_t rope(const Rope *r) {
+      auto [id, added] = find_or_add(r, HeapNodeKind::String, CONTROL_BLOCK + r->self_size());
+      if (added) pending.emplace_back(id, r);
+      return id;
+    }
+
+    // The node for the block a value refers to, nullopt if it is all inline
+    std::optional<uint32_t> value(const Object &object) {
+      if (auto *s = std::get_if<String>(&object)) {
+        if (auto *r = s->heap()) return rope(r);
+        return std::nullopt;
+      }
+      if (auto *fn = std::get_if<Function>(&object)) return function(*fn);
+      if (auto *array = std::get_if<Array>(&object)) {
+        // Elements are int64_t, double or Object in every other alternative
+        bool objects = array->elements->index() % 3 == 2;
+        auto element_size = objects ? sizeof(Object) : sizeof(int64_t);
+        auto self_size = CONTROL_BLOCK + sizeof(Array::Elements) + array->size() * element_size;
+        auto [id, added] = find_or_add(array->elements.get(), HeapNodeKind::Array, self_size);
+        if (added && objects) pending.emplace_back(id, *array);
+        return id;
+      }
+      if (auto *vec = std::get_if<Vec>(&object)) {
+        auto self_size = CONTROL_BLOCK + sizeof(Vec::Elements) + vec->size() * sizeof(int64_t);
+        return find_or_add(vec->elements.get(), HeapNodeKind::Array, self_size).first;
+      }
+      if (auto *hash = std::get_if<Hash>(&object)) {
+        auto self_size = CONTROL_BLOCK + sizeof(Hash::Storage) + hash->size() * (sizeof(HashKey) + sizeof(Object));
+        auto [id, added] = find_or_add(hash->storage.get(), HeapNodeKind::Hash, self_size);
+        if (added) pending.emplace_back(id, *hash);
+        return id;
+      }
+      if (auto *boxed = std::get_if<ReturnObject>(&object)) {
+        auto [id, added] = find_or_add(boxed->value, HeapNodeKind::Boxed, sizeof(Object));
+        if (added) pending.emplace_back(id, boxed->value);
+        return id;
+      }
+      return std::nullopt;
+    }
+
+    uint32_t function(const Function &fn) {
+      auto key = std::pair<const void *, const void *>(fn.env.get(), fn.source);
+      if (auto it = functions.find(key); it != functions.end()) return it->second;
+      auto self_size = fn.parameters.capacity() * sizeof(Identifier) +
+                       fn.body.statements.capacity() * sizeof(std::pair<StatementType, void *>);
+      auto id = add(HeapNodeKind::Function, self_size);
+      functions[key] = id;
+      snapshot.nodes[id].line = fn.source != nullptr ? fn.source->t.line : fn.body.t.line;
+      if (fn.env != nullptr) {
+        auto env = environment(fn.env.get());
+        snapshot.nodes[id].edges.push_back(env);
+      }
+      return id;
+    }
+
+    void edge(uint32_t from, std::optional<uint32_t> to) {
+      if (to.has_value()) snapshot.nodes[from].edges.push_back(to.value());
+    }
+
+    void expand(uint32_t id, const Environment *env) {
+      if (env->outer.has_value()) edge(id, environment(env->outer.value().get()));
+      for (auto &binding: env->env) {
+        auto self_size = sizeof(binding) + MAP_NODE + string_heap(binding.first);
+        auto [binding_id, added] = find_or_add(&binding, HeapNodeKind::Binding, self_size);
+        snapshot.nodes[binding_id].name = binding.first;
+        auto target = value(binding.second);
+        edge(binding_id, target);
+        if (target.has_value() && snapshot.nodes[target.value()].kind == HeapNodeKind::Function) {
+          snapshot.nodes[binding_id].line = snapshot.nodes[target.value()].line;
+        }
+        edge(id, binding_id);
+      }
+    }
+
+    void expand(uint32_t id, const Rope *r) {
+      if (auto left = r->left_half()) edge(id, rope(left.get()));
+      if (auto right = r->right_half()) edge(id, rope(right.get()));
+    }
+
+    void expand(uint32_t id, const Array &array) {
+      for (size_t i = 0; i < array.size(); i++) edge(id, value(array.at(i)));
+    }
+
+    void expand(uint32_t id, const Hash &hash) {
+      for (auto &[key, element]: hash.items()) edge(id, value(element));
+    }
+
+    void expand(uint32_t id, const Object *boxed) {
+      edge(id, value(*boxed));
+    }
+  };
+}// namespace
+
+const char *heap_node_kind_name(HeapNodeKind kind) {
+  switch (kind) {
+    case HeapNodeKind::Root:
+      return "root";
+    case HeapNodeKind::Environment:
+      return "environment";
+    case HeapNodeKind::Binding:
+      return "binding";
+    case HeapNodeKind::Function:
+      return "function";
+    case HeapNodeKind::String:
+      return "string";
+    case HeapNodeKind::Array:
+      return "array";
+    case HeapNodeKind::Hash:
+      return "hash";
+    case HeapNodeKind::Boxed:
+      return "boxed";
+  }
+  return "";
+}
+
+HeapSnapshot take_heap_snapshot(const std::vector<std::shared_ptr<Environment>> &roots) {
+  auto snapshot = SnapshotBuilder(roots).snapshot;
+  compute_retained_sizes(snapshot);
+  return snapshot;
+}
+
+void compute_retained_sizes(HeapSnapshot &snapshot) {
+  auto &nodes = snapshot.nodes;
+  if (nodes.empty()) return;
+  constexpr uint32_t NONE = UINT32_MAX;
+
+  // Postorder of a depth first search from the root
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> postorder(nodes.size(), NONE);
+  std::vector<bool> visited(nodes.size(), false);
+  std::vector<std::pair<uint32_t, size_t>> stack = {{0, 0}};
+  visited[0] = true;
+  while (!stack.empty()) {
+    auto [node, next] = stack.back();
+    if (next < nodes[node].edges.size()) {
+      stack.back().second++;
+      auto child = nodes[node].edges[next];
+      if (!visited[child]) {
+        visited[child] = true;
+        stack.emplace_back(child, 0);
+      }
+    } else {
+      postorder[node] = static_cast<uint32_t>(order.size());
+      order.push_back(node);
+      stack.pop_back();
+    }
+  }
+  std::vector<std::vector<uint32_t>> predecessors(nodes.size());
+  for (auto node: order) {
+    for (auto child: nodes[node].edges) predecessors[child].push_back(node);
+  }
+
+  // Cooper, Harvey and Kennedy's iterative algorithm, in reverse postorder until nothing changes
+  std::vector<uint32_t> dominator(nodes.size(), NONE);
+  dominator[0] = 0;
+  auto intersect = [&](uint32_t a, uint32_t b) {
+    while (a != b) {
+      while (postorder[a] < postorder[b]) a = dominator[a];
+      while (postorder[b] < postorder[a]) b = dominator[b];
+    }
+    return a;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto it = order.rbegin(); it != order.rend(); it++) {
+      if (*it == 0) continue;
+      uint32_t candidate = NONE;
+      for (auto predecessor: predecessors[*it]) {
+        if (dominator[predecessor] == NONE) continue;
+        candidate = candidate == NONE ? predecessor : intersect(predecessor, candidate);
+      }
+      if (dominator[*it] != candidate) {
+        dominator[*it] = candidate;
+        changed = true;
+      }
+    }
+  }
+
+  // A node finishes before its dominator, so postorder adds every subtree before its parent
+  for (size_t i = 0; i < nodes.size(); i++) {
+    nodes[i].dominator = dominator[i] == NONE ? 0 : dominator[i];
+    nodes[i].retained_size = visited[i] ? nodes[i].self_size : 0;
+  }
+  for (auto node: order) {
+    if (node != 0) nodes[nodes[node].dominator].retained_size += nodes[node].retained_size;
+  }
+}
+
+std::string write_heap_snapshot(const HeapSnapshot &snapshot) {
+  std::string out(SNAPSHOT_HEADER);
+  for (auto &node: snapshot.nodes) {
+    out += std::format("{}\t{}\t{}\t{}\t{}\t{}\t", heap_node_kind_name(node.kind), node.self_size, node.retained_size,
+                       node.dominator, node.line, node.name);
+    for (size_t i = 0; i < node.edges.size(); i++) out += std::format("{}{}", i == 0 ? "" : ",", node.edges[i]);
+    out += "\n";
+  }
+  return out;
+}
+
+std::optional<HeapSnapshot> read_heap_snapshot(std::string_view text) {
+  if (!text.starts_with(SNAPSHOT_HEADER)) return std::nullopt;
+  text.remove_prefix(SNAPSHOT_HEADER.size());
+  HeapSnapshot snapshot;
+  while (!text.empty()) {
+    auto end = std::min(text.find('\n'), text.size());
+    auto line = text.substr(0, end);
+    text.remove_prefix(std::min(end + 1, text.size()));
+
+    std::vector<std::string_view> fields;
+    for (size_t start = 0;;) {
+      auto tab = line.find('\t', start);
+      fields.push_back(line.substr(start, tab == std::string_view::npos ? std::string_view::npos : tab - start));
+      if (tab == std::string_view::npos) break;
+      start = tab + 1;
+    }
+    if (fields.size() != 7) return std::nullopt;
+    auto number = [](std::string_view field, auto &value) {
+      return std::from_chars(field.data(), field.data() + field.size(), value).ec == std::errc();
+    };
+    HeapNode node;
+    auto kind = std::find_if(std::begin(KINDS), std::end(KINDS), [&](auto k) { return fields[0] == heap_node_kind_name(k); });
+    if (kind == std::end(KINDS)) return std::nullopt;
+    node.kind = *kind;
+    if (!number(fields[1], node.self_size) || !number(fields[2], node.retained_size) || !number(fields[3], node.dominator) ||
+        !number(fields[4], node.line)) {
+      return std::nullopt;
+    }
+    node.name = fields[5];
+    for (size_t start = 0; start < fields[6].size();) {
+      auto comma = std::min(fields[6].find(',', start), fields[6].size());
+      uint32_t edge;
+      if (!number(fields[6].substr(start, comma - start), edge)) return std::nullopt;
+      node.edges.push_back(edge);
+      start = comma + 1;
+    }
+    snapshot.nodes.push_back(std::move(node));
+  }
+  for (auto &node: snapshot.nodes) {
+    if (node.dominator >= snapshot.nodes.size()) return std::nullopt;
+    for (auto edge: node.edges) {
+      if (edge >= snapshot.nodes.size()) return std::nullopt;
+    }
+  }
+  // Every dominator chain has to end at the root, or walking it would never stop. Nodes already known to get there end
+  // the walk early, so each is visited about once
+  std::vector<bool> rooted(snapshot.nodes.size(), false);
+  std::vector<uint32_t> chain;
+  for (uint32_t i = 1; i < snapshot.nodes.size(); i++) {
+    chain.clear();
+    for (auto at = i; at != 0 && !rooted[at]; at = snapshot.nodes[at].dominator) {
+      if (chain.size() == snapshot.nodes.size()) return std::nullopt;
+      chain.push_back(at);
+    }
+    for (auto at: chain) rooted[at] = true;
+  }
+  return snapshot;
+}
+
+std::string print_heap_retainers(const HeapSnapshot &snapshot, size_t top) {
+  auto &nodes = snapshot.nodes;
+  std::vector<uint32_t> bindings;
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    if (nodes[i].kind == HeapNodeKind::Binding) bindings.push_back(i);
+  }
+  std::sort(bindings.begin(), bindings.end(), [&](uint32_t a, uint32_t b) {
+    return nodes[a].retained_size != nodes[b].retained_size ? nodes[a].retained_size > nodes[b].retained_size : a < b;
+  });
+
+  std::string out = "";
+  out += std::format("heap: {} nodes, {} bytes reachable\n", nodes.size(), nodes.empty() ? 0 : nodes[0].retained_size);
+  out += std::format("{:>14} {:>10}  {:<32} {}\n", "retained", "self", "binding", "location");
+  for (size_t i = 0; i < std::min(top, bindings.size()); i++) {
+    auto &node = nodes[bindings[i]];
+    // The bindings and the nearest function this one is only reachable through
+    std::string path = node.name;
+    uint32_t holder = 0;
+    for (auto at = node.dominator; at != 0; at = nodes[at].dominator) {
+      if (nodes[at].kind == HeapNodeKind::Binding) path = nodes[at].name + "." + path;
+      if (nodes[at].kind == HeapNodeKind::Function && holder == 0) holder = at;
+    }
+    std::string location = "global";
+    if (node.line != 0) {
+      location = std::format("fn at line {}", node.line);
+    } else if (holder != 0) {
+      location = std::format("held by fn at line {}", nodes[holder].line);
+    }
+    out += std::format("{:>14} {:>10}  {:<32} {}\n", node.retained_size, node.self_size, path, location);
+  }
+  return out;
+}
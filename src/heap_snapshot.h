@@ -0,0 +1,76 @@
+//
+// Heap snapshots of what Monke values are reachable from a set of global scopes, and what each of them retains.
+//
+// The snapshot is a graph of the heap blocks the interpreter shares between values: scopes, bindings, closures,
+// string ropes, array and hash storage, and boxed return values. Values stored inline are part of the block holding
+// them. A node retains everything it dominates, i.e. everything that is only reachable through it, so its retained
+// size is what freeing it would free.
+//
+
+#ifndef MONKE_CPP_HEAP_SNAPSHOT_H
+#define MONKE_CPP_HEAP_SNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "object.h"
+
+enum class HeapNodeKind : uint8_t {
+  // The scopes the snapshot was taken from hang off it
+  Root,
+  Environment,
+  Binding,
+  Function,
+  String,
+  Array,
+  Hash,
+  // The value of a ReturnObject
+  Boxed,
+};
+
+class HeapNode {
+  public:
+  HeapNodeKind kind;
+  // The name of a binding
+  std::string name;
+  // Where a function was defined, zero if unknown
+  uint32_t line = 0;
+  // Bytes the block takes itself, estimated from the sizes of its parts
+  uint64_t self_size = 0;
+  uint64_t retained_size = 0;
+  // Index of the immediate dominator. The root is its own
+  uint32_t dominator = 0;
+  std::vector<uint32_t> edges;
+};
+
+class HeapSnapshot {
+  public:
+  // nodes[0] is the root
+  std::vector<HeapNode> nodes;
+};
+
+const char *heap_node_kind_name(HeapNodeKind kind);
+
+// Walk everything reachable from roots and compute the retained sizes. Nothing may run in those scopes meanwhile
+HeapSnapshot take_heap_snapshot(const std::vector<std::shared_ptr<Environment>> &roots);
+
+// Set the dominator and retained size of every node from the edges
+void compute_retained_sizes(HeapSnapshot &snapshot);
+
+// One tab separated line per node, which read_heap_snapshot reads back
+std::string write_heap_snapshot(const HeapSnapshot &snapshot);
+std::optional<HeapSnapshot> read_heap_snapshot(std::string_view text);
+
+/**
+ * The bindings that retain the most, with their path from the roots and the line of the function they belong to
+ *
+ * A path names the bindings on the way through the dominator tree, e.g. "cache.entries" for the entries binding of a
+ * scope only the closure bound to cache keeps alive.
+ */
+std::string print_heap_retainers(const HeapSnapshot &snapshot, size_t top = 20);
+
+#endif//MONKE_CPP_HEAP_SNAPSHOT_H
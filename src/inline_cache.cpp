@@ -0,0 +1,146 @@
+//
+// Per call site inline caches for the evaluator.
+//
+
+#include <format>
+
+#include "builtins.h"
+#include "inline_cache.h"
+#include "isolate.h"
+#include "jit.h"
+
+std::shared_ptr<CallSiteCache> make_call_site_cache() {
+  return std::make_shared<CallSiteCache>();
+}
+
+InlineCacheStats &inline_cache_stats() {
+  return current_isolate().inline_cache_stats;
+}
+
+void reset_inline_cache_stats() {
+  inline_cache_stats() = InlineCacheStats();
+}
+
+std::string print_inline_cache_stats(InlineCacheStats &stats) {
+  auto rate = [](uint64_t hits, uint64_t misses) -> double {
+    return hits + misses == 0 ? 0.0 : 100.0 * static_cast<double>(hits) / static_cast<double>(hits + misses);
+  };
+  std::string out = "";
+  out += std::format("resolution: {} hits, {} misses ({:.1f}% hit)\n", stats.resolution_hits, stats.resolution_misses, rate(stats.resolution_hits, stats.resolution_misses));
+  out += std::format("callee: {} hits, {} misses ({:.1f}% hit)\n", stats.callee_hits, stats.callee_misses, rate(stats.callee_hits, stats.callee_misses));
+  out += std::format("megamorphic calls: {}\n", stats.megamorphic_calls);
+  return out;
+}
+
+CallSiteCache &call_site_cache(CallExpression &node) {
+  auto &isolate = current_isolate();
+  if (node.cache->claim(isolate.id)) return *node.cache;
+  auto &sites = isolate.call_sites;
+  if (auto it = sites.find(node.cache->id); it != sites.end()) return it->second.cache;
+
+  // Drop the sites of freed programs once the map has doubled since it was last swept, so it only grows with the
+  // programs still alive
+  if (sites.size() >= 2 * isolate.swept_call_sites) {
+    std::erase_if(sites, [](const auto &site) { return site.second.site.expired(); });
+    isolate.swept_call_sites = sites.size();
+  }
+  auto &side = sites[node.cache->id];
+  side.site = node.cache;
+  return side.cache;
+}
+
+bool CallSiteCache::claim(uint64_t isolate) {
+  uint64_t current = owner.load(std::memory_order_relaxed);
+  if (current == isolate) return true;
+  return current == 0 && owner.compare_exchange_strong(current, isolate);
+}
+
+Object *CallSiteCache::resolve(const std::string &name, Environment &env) {
+  // The caller's own scope is usually a fresh function environment, so it is probed rather than cached
+  if (auto it = env.env.find(name); it != env.env.end()) return &it->second;
+  if (!env.outer.has_value()) return find_builtin(name);
+
+  auto &stats = inline_cache_stats();
+  Environment *anchor = env.outer.value().get();
+  if (resolution.slot != nullptr && resolution.anchor.get() == anchor) {
+    Environment *scope = anchor;
+    bool valid = true;
+    for (size_t i = 0; i < resolution.depth && valid; i++) {
+      valid = scope->version == resolution.versions[i];
+      // A builtin's entry checks every scope, the last of which has no outer
+      if (i + 1 < resolution.depth) scope = scope->outer.value().get();
+    }
+    if (valid) {
+      hits++;
+      stats.resolution_hits++;
+      return resolution.slot;
+    }
+  }
+  misses++;
+  stats.resolution_misses++;
+
+  // Walk the chain like Environment::get, remembering the version of every scope we pass through
+  std::array<uint64_t, RESOLUTION_DEPTH> versions = {};
+  size_t depth = 0;
+  Environment *scope = anchor;
+  while (true) {
+    if (auto it = scope->env.find(name); it != scope->env.end()) {
+      if (depth <= RESOLUTION_DEPTH) {
+        resolution.anchor = env.outer.value();
+        resolution.depth = depth;
+        resolution.versions = versions;
+        resolution.slot = &it->second;
+      }
+      return &it->second;
+    }
+    if (!scope->outer.has_value()) {
+      // Unbound everywhere, so it is a builtin until one of the scopes binds the name
+      auto *builtin = find_builtin(name);
+      if (builtin != nullptr && depth < RESOLUTION_DEPTH) {
+        versions[depth] = scope->version;
+        resolution.anchor = env.outer.value();
+        resolution.depth = depth + 1;
+        resolution.versions = versions;
+        resolution.slot = builtin;
+      }
+      return builtin;
+    }
+    if (depth < RESOLUTION_DEPTH) versions[depth] = scope->version;
+    depth++;
+    scope = scope->outer.value().get();
+  }
+}
+
+const CalleeEntry *CallSiteCache::lookup(Function &fn, size_t arity) {
+  auto &stats = inline_cache_stats();
+  if (megamorphic) {
+    stats.megamorphic_calls++;
+    return nullptr;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    if (fn.source != nullptr && callees[i].source == fn.source->id) {
+      hits++;
+      stats.callee_hits++;
+      return &callees[i];
+    }
+  }
+  misses++;
+  stats.callee_misses++;
+
+  // Hand built functions have no stable identity, and bad calls are left for the slow path to report
+  if (fn.source == nullptr || fn.parameters.size() != arity) return nullptr;
+  if (size == PIC_SIZE) {
+    megamorphic = true;
+    return nullptr;
+  }
+
+  auto &entry = callees[size++];
+  entry.source = fn.source->id;
+  entry.profile = &jit_profile(fn.source);
+  entry.frame.clear();
+  for (auto &param: fn.parameters) {
+    entry.frame.push_back(param.string());
+  }
+  return &entry;
+}
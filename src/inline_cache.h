@@ -0,0 +1,111 @@
+//
+// Per call site inline caches for the evaluator.
+//
+
+#ifndef MONKE_CPP_INLINE_CACHE_H
+#define MONKE_CPP_INLINE_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+class JitProfile;
+
+// Number of distinct callees a call site remembers before it is treated as megamorphic
+constexpr size_t PIC_SIZE = 4;
+
+// Deepest scope chain (counted from the caller's enclosing scope) a resolution entry will guard
+constexpr size_t RESOLUTION_DEPTH = 4;
+
+/*
+ * Where a callee identifier was found the last time the site ran.
+ *
+ * The lookup starts in the caller's scope, which is usually a fresh function environment, so the entry is
+ * anchored on the scope enclosing it instead. Bindings are never overwritten or removed, so the cached slot
+ * stays correct as long as the anchor is the same and no scope between it and the owner gained a binding.
+ */
+class ResolutionEntry {
+  public:
+  // Held (not just compared) so a freed scope can never be mistaken for a new one at the same address
+  std::shared_ptr<Environment> anchor;
+  // Scopes from the anchor out that did not bind the name; every scope when slot is a builtin
+  size_t depth = 0;
+  std::array<uint64_t, RESOLUTION_DEPTH> versions = {};
+  Object *slot = nullptr;
+};
+
+// What the call path needs to know about one callee body
+class CalleeEntry {
+  public:
+  // BlockStatement::id of the body, as a later program may put its body at the address of a freed one
+  uint64_t source = 0;
+  // Parameter names in argument order, precomputed so a call only has to bind them
+  std::vector<std::string> frame;
+  // Tiering state of the body, saves the JIT a table lookup per call
+  JitProfile *profile = nullptr;
+};
+
+class InlineCacheStats {
+  public:
+  uint64_t resolution_hits = 0;
+  uint64_t resolution_misses = 0;
+  uint64_t callee_hits = 0;
+  uint64_t callee_misses = 0;
+  // Calls through sites that have seen more than PIC_SIZE callees and no longer cache
+  uint64_t megamorphic_calls = 0;
+};
+
+class CallSiteCache {
+  public:
+  // Names the site in other isolates' side caches, see call_site_cache
+  const uint64_t id = next_node_id();
+  // Id of the isolate whose calls fill the cache, 0 until the site first runs
+  std::atomic<uint64_t> owner = 0;
+  ResolutionEntry resolution;
+  std::array<CalleeEntry, PIC_SIZE> callees;
+  size_t size = 0;
+  bool megamorphic = false;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+  // Whether calls from the isolate may use the cache. The first isolate to ask gets it
+  bool claim(uint64_t isolate);
+
+  /**
+   * Find the value bound to the callee identifier, starting from the caller's scope.
+   * @return a pointer into the owning environment, or nullptr if the name is unbound
+   */
+  Object *resolve(const std::string &name, Environment &env);
+
+  /**
+   * Find (or add) the entry for the callee's body.
+   * @return nullptr if the function cannot be cached or the site is megamorphic
+   */
+  const CalleeEntry *lookup(Function &fn, size_t arity);
+};
+
+// An isolate's own cache for a call site another isolate owns
+class SideCallSiteCache {
+  public:
+  // Expires when the program holding the site is freed, after which the entry is dropped
+  std::weak_ptr<const CallSiteCache> site;
+  CallSiteCache cache;
+};
+
+/**
+ * The cache the current isolate uses for a call site: the one in the tree if the isolate owns it, otherwise the
+ * isolate's own copy
+ */
+CallSiteCache &call_site_cache(CallExpression &node);
+
+// Counters summed over every call site
+InlineCacheStats &inline_cache_stats();
+void reset_inline_cache_stats();
+std::string print_inline_cache_stats(InlineCacheStats &stats);
+
+#endif//MONKE_CPP_INLINE_CACHE_H
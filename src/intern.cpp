@@ -0,0 +1,95 @@
+//
+// Process wide table of unique strings.
+//
+
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "intern.h"
+
+namespace {
+  class TransparentHash {
+    public:
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+  };
+
+  class Entry {
+    public:
+    const std::string *string;
+    std::weak_ptr<const std::string> shared;
+    // Set once the string is interned, so it is never freed
+    std::shared_ptr<const std::string> pinned;
+  };
+
+  // Keyed by a view of the entry's own string, which does not move when the map rehashes
+  class InternTable {
+    public:
+    std::shared_mutex mutex;
+    std::unordered_map<std::string_view, Entry, TransparentHash, std::equal_to<>> strings;
+  };
+
+  // Leaked so interned pointers outlive every static destructor that might still use them
+  InternTable &table() {
+    static auto *t = new InternTable();
+    return *t;
+  }
+
+  // Deleter of shared strings. Between the last reference going and this running, s may have been replaced by a new copy
+  void release(const std::string *s) {
+    auto &t = table();
+    {
+      std::unique_lock lock(t.mutex);
+      auto it = t.strings.find(*s);
+      if (it != t.strings.end() && it->second.string == s) t.strings.erase(it);
+    }
+    delete s;
+  }
+
+  // The live copy of s, or a new one. Needs the table locked for writing
+  std::shared_ptr<const std::string> acquire(InternTable &t, std::string_view s) {
+    auto it = t.strings.find(s);
+    if (it != t.strings.end()) {
+      if (auto alive = it->second.shared.lock()) return alive;
+      t.strings.erase(it);
+    }
+    std::shared_ptr<const std::string> copy(new std::string(s), release);
+    t.strings.emplace(*copy, Entry{copy.get(), copy, nullptr});
+    return copy;
+  }
+}// namespace
+
+const std::string *intern(std::string_view s) {
+  auto &t = table();
+  {
+    std::shared_lock lock(t.mutex);
+    auto it = t.strings.find(s);
+    if (it != t.strings.end() && it->second.pinned != nullptr) return it->second.string;
+  }
+  std::unique_lock lock(t.mutex);
+  auto copy = acquire(t, s);
+  t.strings.find(s)->second.pinned = copy;
+  return copy.get();
+}
+
+std::shared_ptr<const std::string> intern_shared(std::string_view s) {
+  auto &t = table();
+  {
+    std::shared_lock lock(t.mutex);
+    auto it = t.strings.find(s);
+    if (it != t.strings.end()) {
+      if (auto alive = it->second.shared.lock()) return alive;
+    }
+  }
+  std::unique_lock lock(t.mutex);
+  return acquire(t, s);
+}
+
+const std::string *find_interned(std::string_view s) {
+  auto &t = table();
+  std::shared_lock lock(t.mutex);
+  auto it = t.strings.find(s);
+  if (it == t.strings.end() || it->second.shared.expired()) return nullptr;
+  return it->second.string;
+}
@@ -0,0 +1,27 @@
+//
+// Process wide table of unique strings.
+//
+// An interned string is never freed or moved, so its address identifies its contents: two interned strings are equal
+// exactly when they are the same pointer. The table is shared by every isolate and safe to use from any thread.
+//
+// Strings made at run time, e.g. hash keys a script builds, are shared instead: they have a unique address while any
+// reference to them is alive, the same one intern gives for their contents, and are freed with the last reference.
+//
+
+#ifndef MONKE_CPP_INTERN_H
+#define MONKE_CPP_INTERN_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// The unique copy of s, added on first use
+const std::string *intern(std::string_view s);
+
+// The unique copy of s, kept only as long as the result or a copy of it is. Interned later, it is kept for good
+std::shared_ptr<const std::string> intern_shared(std::string_view s);
+
+// The unique copy of s if it is interned or shared, nullptr otherwise. Never adds to the table
+const std::string *find_interned(std::string_view s);
+
+#endif//MONKE_CPP_INTERN_H
@@ -0,0 +1,100 @@
+//
+// Independent interpreter instances.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+
+#include "compiled_program.h"
+#include "eval.h"
+#include "isolate.h"
+
+namespace {
+  std::atomic<uint64_t> next_id = 1;
+  thread_local Isolate *entered = nullptr;
+}// namespace
+
+Isolate::Isolate(IsolateConfig config) : id(next_id++), config(config), globals(std::make_shared<Environment>(Environment())) {}
+
+Isolate::~Isolate() {
+  // Functions bound at top level hold the global scope, break the cycle so both can be freed
+  globals->env.clear();
+}
+
+ObjectResult Isolate::run(Program &program) {
+  IsolateScope scope(*this);
+  return evaluate(program, globals);
+}
+
+ObjectResult Isolate::run(std::string source) {
+  auto *l = new Lexer(source);
+  Parser p = Parser(l);
+  Program program = p.parse_program();
+  if (program.error.has_value()) {
+    return std::unexpected(program.error.value());
+  }
+  return run(program);
+}
+
+ObjectResult Isolate::run(std::shared_ptr<const CompiledProgram> program) {
+  if (std::find(programs.begin(), programs.end(), program) == programs.end()) {
+    programs.push_back(program);
+  }
+  IsolateScope scope(*this);
+  return program->evaluate(globals);
+}
+
+ObjectResult Isolate::lookup(const std::string &name) {
+  auto it = globals->env.find(name);
+  if (it == globals->env.end()) {
+    if (auto *builtin = builtins.find(name)) return *builtin;
+    return std::unexpected(TypeError(std::format("identifier not found: {}", name)));
+  }
+  if (!std::holds_alternative<Function>(it->second) && !std::holds_alternative<NativeFunction>(it->second) && !std::holds_alternative<Builtin>(it->second)) {
+    return std::unexpected(TypeError(std::format("not a function: {}", get_type_name(it->second))));
+  }
+  return it->second;
+}
+
+ObjectResult Isolate::call(Object &fn, std::vector<Object> args) {
+  IsolateScope scope(*this);
+  if (auto *native = std::get_if<NativeFunction>(&fn)) {
+    if (native->arity != args.size()) {
+      return std::unexpected(TypeError(std::format("wrong number of arguments: want={}, got={}", native->arity, args.size())));
+    }
+    return native->fn(args);
+  }
+  if (auto *builtin = std::get_if<Builtin>(&fn)) {
+    return call_builtin(*builtin, args);
+  }
+
+  auto *function = std::get_if<Function>(&fn);
+  if (function == nullptr) {
+    return std::unexpected(TypeError(std::format("not a function: {}", get_type_name(fn))));
+  }
+  if (function->parameters.size() != args.size()) {
+    return std::unexpected(TypeError(std::format("wrong number of arguments: want={}, got={}", function->parameters.size(), args.size())));
+  }
+  if (config.jit.enabled && function->source != nullptr) {
+    static const std::string host = "host";
+    if (auto native = jit_call(*function, args, jit_profile(function->source), host)) {
+      return native.value();
+    }
+  }
+  return apply_function(*function, args);
+}
+
+IsolateScope::IsolateScope(Isolate &isolate) : previous(entered) {
+  entered = &isolate;
+}
+
+IsolateScope::~IsolateScope() {
+  entered = previous;
+}
+
+Isolate &current_isolate() {
+  if (entered != nullptr) return *entered;
+  static Isolate process;
+  return process;
+}
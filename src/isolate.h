@@ -0,0 +1,105 @@
+//
+// Independent interpreter instances.
+//
+
+#ifndef MONKE_CPP_ISOLATE_H
+#define MONKE_CPP_ISOLATE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "builtins.h"
+#include "inline_cache.h"
+#include "jit.h"
+#include "memo.h"
+#include "object.h"
+#include "parallel.h"
+
+class CompiledProgram;
+
+class IsolateConfig {
+  public:
+  JitConfig jit;
+  MemoConfig memo;
+  ParallelConfig parallel;
+};
+
+/*
+ * An interpreter with its own global scope, configuration, statistics and tiering state.
+ *
+ * Isolates share no mutable state, so each one can run on its own thread. An isolate itself is single threaded: only one
+ * thread may run code in it at a time. Parsed programs are only read and may be run by any number of isolates at once;
+ * the cache in a call site belongs to the first isolate that runs it, other isolates keep theirs on the side.
+ *
+ * Code that does not enter an isolate runs in the process default one, which is what the free functions
+ * (`eval_program`, `jit_config`, ...) use.
+ */
+class Isolate {
+  public:
+  explicit Isolate(IsolateConfig config = IsolateConfig());
+  ~Isolate();
+  Isolate(const Isolate &) = delete;
+  Isolate &operator=(const Isolate &) = delete;
+
+  // Unique for the life of the process, unlike the address
+  const uint64_t id;
+  IsolateConfig config;
+  // Shared programs run so far. Functions they created may still be bound, so they must outlive everything below
+  std::vector<std::shared_ptr<const CompiledProgram>> programs;
+  // Bindings made by every program run so far, like the REPL
+  std::shared_ptr<Environment> globals;
+  // Looked up when a name is not bound in the program's scopes. The host may add its own
+  BuiltinRegistry builtins;
+
+  InlineCacheStats inline_cache_stats;
+  JitStats jit_stats;
+  MemoStats memo_stats;
+  ParallelStats parallel_stats;
+  // By BlockStatement::id, so a program parsed where a freed one was does not pick up its state
+  std::unordered_map<uint64_t, JitProfile> jit_profiles;
+  std::unordered_map<uint64_t, MemoTable> memo_tables;
+  // Caches for call sites owned by another isolate, by CallSiteCache::id of the site's cache in the tree
+  std::unordered_map<uint64_t, SideCallSiteCache> call_sites;
+  // Size of call_sites after it was last swept for freed programs
+  size_t swept_call_sites = 0;
+  std::unique_ptr<WorkStealingPool> pool;
+
+  /**
+   * Evaluate a program in this isolate's global scope on the calling thread
+   */
+  ObjectResult run(Program &program);
+  ObjectResult run(std::string source);
+  ObjectResult run(std::shared_ptr<const CompiledProgram> program);
+
+  /**
+   * Find a function bound at top level, e.g. by a program run earlier, or a builtin, so the host can call it
+   * @return TypeError if the name is unbound or not bound to a function
+   */
+  ObjectResult lookup(const std::string &name);
+
+  /**
+   * Call a function with host provided arguments. Takes the same path as a call from Monke code, including the JIT,
+   * but checks the arguments instead of trusting the parser
+   */
+  ObjectResult call(Object &fn, std::vector<Object> args);
+};
+
+// Makes an isolate current on this thread for as long as it lives
+class IsolateScope {
+  public:
+  explicit IsolateScope(Isolate &isolate);
+  ~IsolateScope();
+  IsolateScope(const IsolateScope &) = delete;
+  IsolateScope &operator=(const IsolateScope &) = delete;
+
+  private:
+  Isolate *previous;
+};
+
+Isolate &current_isolate();
+
+#endif//MONKE_CPP_ISOLATE_H
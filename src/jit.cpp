@@ -0,0 +1,490 @@
+//
+// Baseline template JIT for hot integer functions.
+//
+// Every supported AST node has a fixed x86-64 byte template. Code generation copies the templates for a function
+// body into a buffer and patches their immediate, displacement and branch holes. Expressions leave their value in
+// rax and use the machine stack for temporaries, parameters and lets live in rbp relative slots.
+//
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define MONKE_JIT_X86_64
+#endif
+
+#include "isolate.h"
+#include "jit.h"
+
+JitConfig &jit_config() {
+  return current_isolate().config.jit;
+}
+
+JitStats &jit_stats() {
+  return current_isolate().jit_stats;
+}
+
+void reset_jit_stats() {
+  jit_stats() = JitStats();
+}
+
+std::string print_jit_stats(JitStats &stats) {
+  std::string out = "";
+  out += std::format("compiled: {} ({} bytes), failed: {}\n", stats.compiled, stats.code_bytes, stats.failed);
+  out += std::format("native calls: {}, bailouts: {}\n", stats.native_calls, stats.bailouts);
+  return out;
+}
+
+JitProfile &jit_profile(const BlockStatement *source) {
+  return current_isolate().jit_profiles[source->id];
+}
+
+namespace {
+  // Static type of a compiled expression. Null values may only be discarded, Never means control left the function
+  enum class JitType {
+    Int,
+    Bool,
+    Null,
+    Never
+  };
+
+  class Label {
+    public:
+    size_t target = 0;
+    // Offsets of the rel32 holes that jump here
+    std::vector<size_t> uses;
+  };
+
+  class Assembler {
+    public:
+    std::vector<uint8_t> code;
+
+    void copy(std::initializer_list<uint8_t> stencil) {
+      code.insert(code.end(), stencil);
+    }
+
+    void imm32(int32_t value) {
+      for (size_t i = 0; i < 4; i++) code.push_back(static_cast<uint8_t>(static_cast<uint32_t>(value) >> (8 * i)));
+    }
+
+    void imm64(int64_t value) {
+      for (size_t i = 0; i < 8; i++) code.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+    }
+
+    // Copy a branch template and leave its rel32 hole for the label
+    void branch(std::initializer_list<uint8_t> stencil, Label &label) {
+      copy(stencil);
+      label.uses.push_back(code.size());
+      imm32(0);
+    }
+
+    void bind(Label &label) {
+      label.target = code.size();
+    }
+
+    void resolve(Label &label) {
+      for (auto use: label.uses) {
+        auto rel = static_cast<int32_t>(static_cast<int64_t>(label.target) - static_cast<int64_t>(use + 4));
+        std::memcpy(&code[use], &rel, sizeof(rel));
+      }
+    }
+
+    void patch32(size_t at, int32_t value) {
+      std::memcpy(&code[at], &value, sizeof(value));
+    }
+  };
+
+  class Compiler {
+    public:
+    Compiler(Function &fn) : fn(fn) {}
+
+    Function &fn;
+    Assembler a;
+    Label entry, ret, bail;
+    // Variable name to rbp offset and type
+    std::unordered_map<std::string, std::pair<int32_t, JitType>> locals;
+    // Top level lets that have not been reached yet. Reading one would have to fall through to the outer scope
+    std::unordered_set<std::string> pending;
+    size_t slots = 1;
+
+    // Slot 0 ([rbp - 8]) holds the out pointer
+    int32_t next_slot() {
+      return -8 * static_cast<int32_t>(++slots);
+    }
+
+    void load(int32_t offset) {
+      a.copy({0x48, 0x8B, 0x85});// mov rax, [rbp + disp32]
+      a.imm32(offset);
+    }
+
+    void store(int32_t offset) {
+      a.copy({0x48, 0x89, 0x85});// mov [rbp + disp32], rax
+      a.imm32(offset);
+    }
+
+    void constant(int64_t value) {
+      a.copy({0x48, 0xB8});// mov rax, imm64
+      a.imm64(value);
+    }
+
+    bool compile() {
+      if (fn.parameters.size() > JIT_MAX_PARAMS) return false;
+
+      a.bind(entry);
+      a.copy({0x55});            // push rbp
+      a.copy({0x48, 0x89, 0xE5});// mov rbp, rsp
+      a.copy({0x48, 0x81, 0xEC});// sub rsp, imm32
+      size_t frame_hole = a.code.size();
+      a.imm32(0);
+      a.copy({0x48, 0x89, 0xB5});// mov [rbp + disp32], rsi
+      a.imm32(-8);
+
+      for (size_t i = 0; i < fn.parameters.size(); i++) {
+        auto name = fn.parameters[i].string();
+        if (locals.contains(name)) return false;
+        auto offset = next_slot();
+        a.copy({0x48, 0x8B, 0x87});// mov rax, [rdi + disp32]
+        a.imm32(static_cast<int32_t>(8 * i));
+        store(offset);
+        locals[name] = {offset, JitType::Int};
+      }
+
+      auto statements = fn.body.get_statements();
+      for (auto &stmt: statements) {
+        if (auto *let = std::get_if<LetStatement>(&stmt)) {
+          auto name = let->name.string();
+          if (locals.contains(name) || pending.contains(name)) return false;
+          pending.insert(name);
+        }
+      }
+
+      auto type = block(fn.body, true);
+      if (!type.has_value() || (type.value() != JitType::Int && type.value() != JitType::Never)) return false;
+
+      a.bind(ret);
+      a.copy({0x48, 0x8B, 0x8D});// mov rcx, [rbp + disp32]
+      a.imm32(-8);
+      a.copy({0x48, 0x89, 0x01});// mov [rcx], rax
+      a.copy({0x31, 0xC0});      // xor eax, eax
+      a.copy({0xC9, 0xC3});      // leave; ret
+
+      a.bind(bail);
+      a.copy({0xB8});// mov eax, imm32
+      a.imm32(1);
+      a.copy({0xC9, 0xC3});// leave; ret
+
+      a.resolve(entry);
+      a.resolve(ret);
+      a.resolve(bail);
+      a.patch32(frame_hole, static_cast<int32_t>((8 * slots + 15) / 16 * 16));
+      return true;
+    }
+
+    std::optional<JitType> block(BlockStatement &node, bool top) {
+      auto type = JitType::Null;
+      auto statements = node.get_statements();
+      for (auto &stmt: statements) {
+        auto t = statement(stmt, top);
+        if (!t.has_value()) return std::nullopt;
+        type = t.value();
+        // Anything after a return is unreachable
+        if (type == JitType::Never) break;
+      }
+      return type;
+    }
+
+    std::optional<JitType> statement(Statement &node, bool top) {
+      return std::visit(overloads{
+                                [&](LetStatement &let) -> std::optional<JitType> {
+                                  // Lets in nested blocks bind conditionally, which a static slot cannot express
+                                  if (!top) return std::nullopt;
+                                  auto t = expression(let.value);
+                                  if (!t.has_value() || (t.value() != JitType::Int && t.value() != JitType::Bool)) return std::nullopt;
+                                  auto name = let.name.string();
+                                  auto offset = next_slot();
+                                  store(offset);
+                                  locals[name] = {offset, t.value()};
+                                  pending.erase(name);
+                                  return JitType::Null;
+                                },
+                                [&](ReturnStatement &r) -> std::optional<JitType> {
+                                  if (expression(r.return_value) != JitType::Int) return std::nullopt;
+                                  a.branch({0xE9}, ret);// jmp rel32
+                                  return JitType::Never;
+                                },
+                                [&](ExpressionStatement &e) -> std::optional<JitType> {
+                                  return expression(e.e);
+                                },
+                                [&](BlockStatement &) -> std::optional<JitType> {
+                                  return std::nullopt;
+                                },
+                        },
+                        node);
+    }
+
+    std::optional<JitType> expression(Expression &node) {
+      return std::visit(overloads{
+                                [&](IntegerLiteral &i) -> std::optional<JitType> {
+                                  constant(i.val);
+                                  return JitType::Int;
+                                },
+                                [&](BooleanLiteral &b) -> std::optional<JitType> {
+                                  constant(b.value ? 1 : 0);
+                                  return JitType::Bool;
+                                },
+                                [&](Identifier &i) { return identifier(i); },
+                                [&](PrefixExpression &p) { return prefix(p); },
+                                [&](InfixExpression &i) { return infix(i); },
+                                [&](IfExpression &i) { return if_expression(i); },
+                                [&](CallExpression &c) { return call(c); },
+                                [&](auto &) -> std::optional<JitType> { return std::nullopt; },
+                        },
+                        node);
+    }
+
+    // Globals are read at compile time. Only bindings directly in the closure scope qualify,
+    // anything further out could still be shadowed by a later let in between
+    Object *global(const std::string &name) {
+      if (locals.contains(name) || pending.contains(name)) return nullptr;
+      auto it = fn.env->env.find(name);
+      if (it == fn.env->env.end()) return nullptr;
+      return &it->second;
+    }
+
+    std::optional<JitType> identifier(Identifier &node) {
+      auto name = node.string();
+      if (auto it = locals.find(name); it != locals.end()) {
+        load(it->second.first);
+        return it->second.second;
+      }
+      auto *obj = global(name);
+      if (obj == nullptr) return std::nullopt;
+      if (auto *i = std::get_if<Integer>(obj)) {
+        constant(i->value);
+        return JitType::Int;
+      }
+      if (auto *b = std::get_if<Boolean>(obj)) {
+        constant(b->value ? 1 : 0);
+        return JitType::Bool;
+      }
+      return std::nullopt;
+    }
+
+    std::optional<JitType> prefix(PrefixExpression &node) {
+      auto t = expression(*node.right);
+      if (node.op == "-" && t == JitType::Int) {
+        a.copy({0x48, 0xF7, 0xD8});// neg rax
+        return JitType::Int;
+      }
+      if (node.op == "!" && t == JitType::Bool) {
+        a.copy({0x48, 0x83, 0xF0, 0x01});// xor rax, 1
+        return JitType::Bool;
+      }
+      return std::nullopt;
+    }
+
+    // Compare rax with rcx and leave the flag in rax
+    void compare(uint8_t setcc) {
+      a.copy({0x48, 0x39, 0xC8});// cmp rax, rcx
+      a.copy({0x0F, setcc, 0xC0});// setcc al
+      a.copy({0x0F, 0xB6, 0xC0});// movzx eax, al
+    }
+
+    std::optional<JitType> infix(InfixExpression &node) {
+      auto left = expression(*node.left);
+      if (left != JitType::Int && left != JitType::Bool) return std::nullopt;
+      a.copy({0x50});// push rax
+      auto right = expression(*node.right);
+      // Mismatched operands are a type error in the interpreter
+      if (right != left) return std::nullopt;
+      a.copy({0x48, 0x89, 0xC1});// mov rcx, rax
+      a.copy({0x58});            // pop rax
+
+      if (left == JitType::Bool) {
+        if (node.op == "==") compare(0x94);// sete
+        else if (node.op == "!=") compare(0x95);// setne
+        else return std::nullopt;
+        return JitType::Bool;
+      }
+
+      if (node.op == "+") {
+        a.copy({0x48, 0x01, 0xC8});// add rax, rcx
+      } else if (node.op == "-") {
+        a.copy({0x48, 0x29, 0xC8});// sub rax, rcx
+      } else if (node.op == "*") {
+        a.copy({0x48, 0x0F, 0xAF, 0xC1});// imul rax, rcx
+      } else if (node.op == "/") {
+        // Division by zero and INT64_MIN / -1 trap, leave them to the interpreter
+        a.copy({0x48, 0x85, 0xC9});// test rcx, rcx
+        a.branch({0x0F, 0x84}, bail);// jz rel32
+        a.copy({0x48, 0x83, 0xF9, 0xFF});// cmp rcx, -1
+        a.branch({0x0F, 0x84}, bail);// je rel32
+        a.copy({0x48, 0x99});// cqo
+        a.copy({0x48, 0xF7, 0xF9});// idiv rcx
+      } else if (node.op == "<") {
+        compare(0x9C);// setl
+        return JitType::Bool;
+      } else if (node.op == ">") {
+        compare(0x9F);// setg
+        return JitType::Bool;
+      } else {
+        return std::nullopt;
+      }
+      return JitType::Int;
+    }
+
+    std::optional<JitType> if_expression(IfExpression &node) {
+      // Integers are always truthy, so only real booleans are worth branching on
+      if (expression(*node.condition) != JitType::Bool) return std::nullopt;
+      Label otherwise, end;
+      a.copy({0x48, 0x85, 0xC0});// test rax, rax
+      a.branch({0x0F, 0x84}, otherwise);// jz rel32
+
+      auto consequence = block(*node.consequence, false);
+      if (!consequence.has_value()) return std::nullopt;
+      if (!node.alternative.has_value()) {
+        a.bind(otherwise);
+        a.resolve(otherwise);
+        return JitType::Null;
+      }
+
+      a.branch({0xE9}, end);// jmp rel32
+      a.bind(otherwise);
+      auto alternative = block(*node.alternative.value(), false);
+      if (!alternative.has_value()) return std::nullopt;
+      a.bind(end);
+      a.resolve(otherwise);
+      a.resolve(end);
+
+      if (consequence.value() == JitType::Never) return alternative;
+      if (alternative.value() == JitType::Never) return consequence;
+      if (consequence.value() == alternative.value()) return consequence;
+      return JitType::Null;
+    }
+
+    std::optional<JitType> call(CallExpression &node) {
+      auto *ident = std::get_if<Identifier>(node.function);
+      if (ident == nullptr) return std::nullopt;
+      auto *obj = global(ident->string());
+      if (obj == nullptr) return std::nullopt;
+      auto *callee = std::get_if<Function>(obj);
+      if (callee == nullptr || callee->source == nullptr) return std::nullopt;
+      if (callee->parameters.size() != node.arguments.size()) return std::nullopt;
+
+      bool self = callee->source == fn.source && callee->env == fn.env;
+      JitEntry target = nullptr;
+      if (!self) {
+        auto &profile = jit_profile(callee->source);
+        if (profile.state != JitState::Compiled || profile.env != callee->env) return std::nullopt;
+        target = profile.entry;
+      }
+
+      // Build the argument buffer on the stack below a result slot. Arguments are pushed last first so
+      // the first one ends up at the lowest address, order does not matter as compiled code is pure
+      auto size = static_cast<int32_t>(8 * node.arguments.size());
+      a.copy({0x48, 0x83, 0xEC, 0x08});// sub rsp, 8
+      for (auto it = node.arguments.rbegin(); it != node.arguments.rend(); it++) {
+        if (expression(**it) != JitType::Int) return std::nullopt;
+        a.copy({0x50});// push rax
+      }
+      a.copy({0x48, 0x89, 0xE7});      // mov rdi, rsp
+      a.copy({0x48, 0x8D, 0xB4, 0x24});// lea rsi, [rsp + disp32]
+      a.imm32(size);
+      if (self) {
+        a.branch({0xE8}, entry);// call rel32
+      } else {
+        a.copy({0x48, 0xB8});// mov rax, imm64
+        a.imm64(reinterpret_cast<int64_t>(target));
+        a.copy({0xFF, 0xD0});// call rax
+      }
+      a.copy({0x85, 0xC0});         // test eax, eax
+      a.branch({0x0F, 0x85}, bail); // jnz rel32
+      a.copy({0x48, 0x81, 0xC4});   // add rsp, imm32
+      a.imm32(size);
+      a.copy({0x58});// pop rax
+      return JitType::Int;
+    }
+  };
+
+  void write_perf_map(const void *start, size_t size, const std::string &name) {
+#ifdef MONKE_JIT_X86_64
+    // The map is per process, isolates on other threads may be compiling too
+    static std::mutex mutex;
+    std::lock_guard lock(mutex);
+    std::ofstream map(std::format("/tmp/perf-{}.map", getpid()), std::ios::app);
+    map << std::format("{:x} {:x} monke::{}\n", reinterpret_cast<uintptr_t>(start), size, name);
+#endif
+  }
+
+  // Copy finished code into its own executable mapping. Code is never freed, compiled functions live as long as the process
+  std::optional<JitEntry> install(std::vector<uint8_t> &code) {
+#ifdef MONKE_JIT_X86_64
+    auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = (code.size() + page - 1) / page * page;
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return std::nullopt;
+    std::memcpy(mem, code.data(), code.size());
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+      munmap(mem, size);
+      return std::nullopt;
+    }
+    return reinterpret_cast<JitEntry>(mem);
+#else
+    return std::nullopt;
+#endif
+  }
+}// namespace
+
+std::optional<JitEntry> jit_compile(Function &fn, const std::string &name) {
+  Compiler compiler(fn);
+  if (!compiler.compile()) return std::nullopt;
+  auto entry = install(compiler.a.code);
+  if (!entry.has_value()) return std::nullopt;
+  jit_stats().code_bytes += compiler.a.code.size();
+  if (jit_config().perf_map) write_perf_map(reinterpret_cast<const void *>(entry.value()), compiler.a.code.size(), name);
+  return entry;
+}
+
+std::optional<ObjectResult> jit_call(Function &fn, std::vector<Object> &args, JitProfile &profile, const std::string &name) {
+  auto &stats = jit_stats();
+  if (profile.state == JitState::Counting) {
+    if (++profile.calls < jit_config().threshold) return std::nullopt;
+    auto entry = jit_compile(fn, name);
+    if (!entry.has_value()) {
+      profile.state = JitState::Failed;
+      stats.failed++;
+      return std::nullopt;
+    }
+    profile.state = JitState::Compiled;
+    profile.entry = entry.value();
+    profile.env = fn.env;
+    stats.compiled++;
+  }
+  if (profile.state != JitState::Compiled || profile.env != fn.env || args.size() != fn.parameters.size()) return std::nullopt;
+
+  // Type guards: compiled code only understands integers
+  int64_t raw[JIT_MAX_PARAMS];
+  for (size_t i = 0; i < args.size(); i++) {
+    auto *i_arg = std::get_if<Integer>(&args[i]);
+    if (i_arg == nullptr) {
+      stats.bailouts++;
+      return std::nullopt;
+    }
+    raw[i] = i_arg->value;
+  }
+
+  int64_t out = 0;
+  if (profile.entry(raw, &out) != 0) {
+    stats.bailouts++;
+    return std::nullopt;
+  }
+  stats.native_calls++;
+  return ObjectResult(Integer(out));
+}
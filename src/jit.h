@@ -0,0 +1,85 @@
+//
+// Baseline template JIT for hot integer functions.
+//
+
+#ifndef MONKE_CPP_JIT_H
+#define MONKE_CPP_JIT_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+// Calls a function must receive before it is compiled
+constexpr uint64_t JIT_DEFAULT_THRESHOLD = 1000;
+
+// Compiled functions take their arguments from a fixed size buffer
+constexpr size_t JIT_MAX_PARAMS = 8;
+
+/*
+ * Native entry point of a compiled function. Reads the arguments from args and writes the result to out.
+ * Returns 0 on success; anything else means the call has to be redone by the interpreter. Compiled code is
+ * side effect free, so bailing out of the middle of a call is always safe.
+ */
+typedef int64_t (*JitEntry)(const int64_t *args, int64_t *out);
+
+class JitConfig {
+  public:
+  bool enabled = true;
+  uint64_t threshold = JIT_DEFAULT_THRESHOLD;
+  // Append every compiled function to /tmp/perf-<pid>.map so perf can symbolize it
+  bool perf_map = false;
+};
+
+class JitStats {
+  public:
+  uint64_t compiled = 0;
+  uint64_t failed = 0;
+  uint64_t native_calls = 0;
+  uint64_t bailouts = 0;
+  uint64_t code_bytes = 0;
+};
+
+enum class JitState {
+  Counting,
+  Compiled,
+  Failed
+};
+
+// Tiering state of one function body
+class JitProfile {
+  public:
+  uint64_t calls = 0;
+  JitState state = JitState::Counting;
+  JitEntry entry = nullptr;
+  // The code resolves globals at compile time, so it is only valid for closures over this scope
+  std::shared_ptr<Environment> env;
+};
+
+JitConfig &jit_config();
+JitStats &jit_stats();
+void reset_jit_stats();
+std::string print_jit_stats(JitStats &stats);
+
+/**
+ * Tiering state for a function body in the current isolate, created on first use. References stay valid for the life of the isolate.
+ */
+JitProfile &jit_profile(const BlockStatement *source);
+
+/**
+ * Count a call and run it natively if the function is (or just became) compiled and the arguments pass the type guards
+ * @param name used to label the code in the perf map
+ * @return nullopt if the interpreter has to evaluate the call
+ */
+std::optional<ObjectResult> jit_call(Function &fn, std::vector<Object> &args, JitProfile &profile, const std::string &name);
+
+/**
+ * Compile fn into executable memory. Only pure integer code is supported:
+ * parameters, top level lets, integer and boolean arithmetic, if/else, return and calls to itself or other compiled functions.
+ */
+std::optional<JitEntry> jit_compile(Function &fn, const std::string &name);
+
+#endif//MONKE_CPP_JIT_H
@@ -3,10 +3,11 @@
 //
 
 #include <optional>
+#include <sstream>
 #include <vector>
 #include <functional>
-#include <spdlog/spdlog.h>
 
+#include "event_log.h"
 #include "lexer.h"
 bool is_digit(char c){
     return '0' <= c && c <= '9';
@@ -40,7 +41,7 @@ std::pair<std::string, size_t> get_position(std::string &input, size_t position)
     return std::make_pair(line, line.length() + 1);
 }
 Lexer::Lexer(std::string input) : input(input), position(0), read_position(0), c('\0') {
-    SPDLOG_TRACE("Lexer initialized");
+    log_event<EventLevel::Trace>(EventKind::Lex, "lexer", static_cast<int64_t>(this->input.size()));
     read_char();
 
     // Initialize the lexers
@@ -106,7 +107,7 @@ auto Lexer::lex_tick() -> std::optional<LexerResult > {
     Token t = Token(CHAR, c);
     read_char();
     if (c != '\'') {
-        SPDLOG_ERROR("Expected char to end with '");
+        log_event<EventLevel::Error>(EventKind::Error, "Expected ' after char", static_cast<int64_t>(position - 1));
         return std::unexpected(LexerError("Expected ' after char", input, position - 1));
     }
     read_char();
@@ -166,10 +167,14 @@ auto Lexer::lex_illegal() -> std::optional<LexerResult > {
 }
 LexerResult Lexer::next_token(){
     skip_whitespace();
-    return run_lexers();
+    auto start = line;
+    auto t = run_lexers();
+    if (t.has_value()) t.value().line = start;
+    return t;
 }
 
 void Lexer::read_char() {
+    if (c == '\n') line++;
     if (read_position >= input.size()){
         c = '\0';
     } else {
@@ -66,6 +66,8 @@ class Lexer {
   size_t position;
   size_t read_position;
   char c;
+  // Line of c
+  uint32_t line = 1;
 
   std::vector<std::function<std::optional<LexerResult>()>> lexers;
   std::unordered_map<char, token_t> char_map = {
@@ -77,6 +79,7 @@ class Lexer {
           {'[', LBRACKET},
           {']', RBRACKET},
           {',', COMMA},
+          {':', COLON},
           {'+', PLUS},
           {'-', MINUS},
           {'*', ASTERISK},
@@ -3,22 +3,235 @@
 #include <memory>
 #include <sstream>
 
+#include "allocation.h"
+#include "counts.h"
 #include "eval.h"
+#include "event_log.h"
+#include "heap_snapshot.h"
+#include "inline_cache.h"
+#include "jit.h"
+#include "memo.h"
 #include "object.h"
-
-#include <spdlog/spdlog.h>
+#include "parallel.h"
+#include "profiler.h"
+#include "script_bench.h"
+#include "trace.h"
+#include "transpiler.h"
 
 int main(int argc, char **argv) {
-  SPDLOG_INFO("Starting main");
+  // Flags may appear anywhere, everything else is the program to run
+  bool ic_stats = false;
+  bool jit_stats_ = false;
+  bool memo_stats_ = false;
+  bool alloc_stats = false;
+  // Set when transpiling; empty means write the C++ to stdout
+  std::optional<std::string> emit_cpp = std::nullopt;
+  // Where to write the collapsed stacks when profiling
+  std::optional<std::string> profile_output = std::nullopt;
+  // Where to write the Chrome trace when tracing
+  std::optional<std::string> trace_output = std::nullopt;
+  bool trace_calls = false;
+  // Set when counting; empty means only print the annotated listing, otherwise also write the counts as JSON there
+  std::optional<std::string> count_output = std::nullopt;
+  // For `monke_cpp bench`: where to save the results and the baseline to compare them against
+  ScriptBenchOptions bench_options;
+  std::optional<std::string> bench_save = std::nullopt;
+  std::optional<std::string> bench_compare = std::nullopt;
+  // Percent the median run or the allocated bytes may grow by before the comparison fails
+  double bench_threshold = 5.0;
+  // Where to write a heap snapshot of the global scope at exit
+  std::optional<std::string> heap_snapshot = std::nullopt;
+  // Retainers `monke_cpp heap` lists
+  size_t heap_top = 20;
+  // Where to write the binary event log
+  std::optional<std::string> events_output = std::nullopt;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--ic-stats") {
+      ic_stats = true;
+    } else if (arg == "--no-jit") {
+      jit_config().enabled = false;
+    } else if (arg == "--perf-map") {
+      jit_config().perf_map = true;
+    } else if (arg == "--jit-stats") {
+      jit_stats_ = true;
+    } else if (arg == "--memo") {
+      memo_config().enabled = true;
+    } else if (arg.starts_with("--memo-capacity=")) {
+      memo_config().enabled = true;
+      memo_config().capacity = std::stoull(arg.substr(std::string("--memo-capacity=").size()));
+    } else if (arg == "--memo-stats") {
+      memo_stats_ = true;
+    } else if (arg == "--alloc-stats") {
+      alloc_stats = true;
+    } else if (arg == "--parallel") {
+      parallel_config().enabled = true;
+    } else if (arg.starts_with("--parallel=")) {
+      parallel_config().enabled = true;
+      parallel_config().threads = std::stoull(arg.substr(std::string("--parallel=").size()));
+    } else if (arg.starts_with("--profile=")) {
+      profile_output = arg.substr(std::string("--profile=").size());
+    } else if (arg.starts_with("--profile-frequency=")) {
+      profiler_config().frequency = std::stoull(arg.substr(std::string("--profile-frequency=").size()));
+    } else if (arg.starts_with("--trace=")) {
+      trace_output = arg.substr(std::string("--trace=").size());
+    } else if (arg == "--trace-calls") {
+      trace_calls = true;
+    } else if (arg == "--count") {
+      count_output = "";
+    } else if (arg.starts_with("--count=")) {
+      count_output = arg.substr(std::string("--count=").size());
+    } else if (arg.starts_with("--warmup=")) {
+      bench_options.warmup = std::stoull(arg.substr(std::string("--warmup=").size()));
+    } else if (arg.starts_with("--runs=")) {
+      bench_options.runs = std::stoull(arg.substr(std::string("--runs=").size()));
+    } else if (arg.starts_with("--save=")) {
+      bench_save = arg.substr(std::string("--save=").size());
+    } else if (arg.starts_with("--compare=")) {
+      bench_compare = arg.substr(std::string("--compare=").size());
+    } else if (arg.starts_with("--threshold=")) {
+      bench_threshold = std::stod(arg.substr(std::string("--threshold=").size()));
+    } else if (arg.starts_with("--heap-snapshot=")) {
+      heap_snapshot = arg.substr(std::string("--heap-snapshot=").size());
+    } else if (arg.starts_with("--top=")) {
+      heap_top = std::stoull(arg.substr(std::string("--top=").size()));
+    } else if (arg.starts_with("--events=")) {
+      events_output = arg.substr(std::string("--events=").size());
+    } else if (arg == "--emit-cpp") {
+      emit_cpp = "";
+    } else if (arg.starts_with("--emit-cpp=")) {
+      emit_cpp = arg.substr(std::string("--emit-cpp=").size());
+    } else {
+      positional.push_back(arg);
+    }
+  }
+
+  // Translate every program given into one C++ file instead of running them
+  if (emit_cpp.has_value()) {
+    std::vector<Program> programs;
+    for (auto &file: positional) {
+      auto *l = new Lexer(read_file(file));
+      Parser p = Parser(l);
+      programs.push_back(p.parse_program());
+      if (programs.back().error.has_value()) {
+        std::cerr << file << ": " << programs.back().error.value().get_msg() << std::endl;
+        return 1;
+      }
+    }
+    auto cpp = transpile(programs, positional);
+    if (!cpp.has_value()) {
+      std::cerr << get_msg(cpp.error()) << std::endl;
+      return 1;
+    }
+    if (emit_cpp.value().empty()) {
+      std::cout << cpp.value();
+    } else {
+      std::ofstream(emit_cpp.value()) << cpp.value();
+    }
+    return 0;
+  }
+
+  // Time repeated runs of a script instead of running it once
+  if (!positional.empty() && positional[0] == "bench") {
+    if (positional.size() != 2 || bench_options.runs == 0) {
+      std::cerr << "usage: monke_cpp bench [--warmup=W] [--runs=N] [--save=FILE] [--compare=FILE] [--threshold=PERCENT] script" << std::endl;
+      return 1;
+    }
+    auto result = bench_script(read_file(positional[1]), bench_options);
+    if (!result.has_value()) {
+      std::cerr << get_msg(result.error()) << std::endl;
+      return 1;
+    }
+    std::cout << print_script_bench(result.value());
+    if (bench_save.has_value()) std::ofstream(bench_save.value()) << script_bench_json(result.value());
+    if (!bench_compare.has_value()) return 0;
+    auto baseline = parse_script_bench_json(read_file(bench_compare.value()));
+    if (!baseline.has_value()) {
+      std::cerr << bench_compare.value() << ": not a saved benchmark" << std::endl;
+      return 1;
+    }
+    auto [comparison, regressed] = compare_script_bench(baseline.value(), result.value(), bench_threshold);
+    std::cout << comparison;
+    return regressed ? 1 : 0;
+  }
+
+  // List what retains the most in a snapshot written by --heap-snapshot
+  if (!positional.empty() && positional[0] == "heap") {
+    if (positional.size() != 2) {
+      std::cerr << "usage: monke_cpp heap [--top=N] snapshot" << std::endl;
+      return 1;
+    }
+    auto snapshot = read_heap_snapshot(read_file(positional[1]));
+    if (!snapshot.has_value()) {
+      std::cerr << positional[1] << ": not a heap snapshot" << std::endl;
+      return 1;
+    }
+    std::cout << print_heap_retainers(snapshot.value(), heap_top);
+    return 0;
+  }
+
+  // Print an event log written by --events
+  if (!positional.empty() && positional[0] == "events") {
+    if (positional.size() != 2) {
+      std::cerr << "usage: monke_cpp events log" << std::endl;
+      return 1;
+    }
+    std::ifstream file(positional[1], std::ios::binary);
+    auto events = decode_event_log(std::string(std::istreambuf_iterator<char>(file), {}));
+    if (!events.has_value()) {
+      std::cerr << positional[1] << ": not an event log" << std::endl;
+      return 1;
+    }
+    std::cout << events.value();
+    return 0;
+  }
+
+  if (events_output.has_value()) {
+    start_event_log();
+    log_event<EventLevel::Info>(EventKind::Start, "main", argc);
+  }
+  if (profile_output.has_value() && !start_profiler()) {
+    std::cerr << "could not start the profiler" << std::endl;
+    return 1;
+  }
+  if (trace_output.has_value()) start_tracing(trace_calls);
+  if (alloc_stats) start_allocation_tracking();
+  if (count_output.has_value()) {
+    // Compiled functions do not run their statements through the tree walker, so they would count nothing
+    jit_config().enabled = false;
+    start_counting();
+  }
+  auto write_reports = [&](std::string_view source, std::shared_ptr<Environment> env) {
+    if (heap_snapshot.has_value()) std::ofstream(heap_snapshot.value()) << write_heap_snapshot(take_heap_snapshot({env}));
+    if (trace_output.has_value()) std::ofstream(trace_output.value()) << stop_tracing();
+    if (events_output.has_value()) std::ofstream(events_output.value(), std::ios::binary) << dump_event_log();
+    if (alloc_stats) std::cerr << print_allocation_report(stop_allocation_tracking());
+    if (count_output.has_value()) {
+      auto counts = stop_counting();
+      std::cerr << annotate_source(counts, source);
+      if (!count_output.value().empty()) std::ofstream(count_output.value()) << counts_json(counts);
+    }
+    if (!profile_output.has_value()) return;
+    auto profile = stop_profiler();
+    std::ofstream(profile_output.value()) << folded_stacks(profile);
+    std::cerr << print_profile(profile);
+  };
+
   // Check if we want the REPL or to parse a program
-  if (argc == 2) {
-    std::string input = read_file(argv[1]);
-    auto out = eval_program(input);
+  if (positional.size() == 1) {
+    std::string input = read_file(positional[0]);
+    auto env = std::make_shared<Environment>(Environment());
+    auto out = eval_program(input, env);
     if (!out.has_value()) {
       std::cout << get_msg(out.error()) << std::endl;
     } else {
       std::cout << inspect(out.value()) << std::endl;
     }
+    if (ic_stats) std::cerr << print_inline_cache_stats(inline_cache_stats());
+    if (jit_stats_) std::cerr << print_jit_stats(jit_stats());
+    if (memo_stats_) std::cerr << print_memo_stats(memo_stats());
+    write_reports(input, env);
     return 0;
   }
 
@@ -30,6 +243,13 @@ int main(int argc, char **argv) {
     std::string input;
     std::getline(std::cin, input);
     if (input == "exit") break;
+    if (input.starts_with(":snapshot ")) {
+      auto file = input.substr(std::string(":snapshot ").size());
+      auto snapshot = take_heap_snapshot({env});
+      std::ofstream(file) << write_heap_snapshot(snapshot);
+      std::cout << print_heap_retainers(snapshot, heap_top);
+      continue;
+    }
 
     // TODO: Add inputs for help, clear, etc
     auto *l = new Lexer(input);
@@ -50,5 +270,10 @@ int main(int argc, char **argv) {
       }
     }
   }
+  if (ic_stats) std::cerr << print_inline_cache_stats(inline_cache_stats());
+  if (jit_stats_) std::cerr << print_jit_stats(jit_stats());
+  if (memo_stats_) std::cerr << print_memo_stats(memo_stats());
+  // REPL lines are numbered from 1 each, so only the functions are reported
+  write_reports("", env);
   return 0;
 }
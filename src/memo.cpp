@@ -0,0 +1,327 @@
+//
+// Memoization of calls to pure functions.
+//
+
+#include <algorithm>
+#include <format>
+
+#include "builtins.h"
+#include "isolate.h"
+#include "memo.h"
+
+namespace {
+  class PurityAnalysis {
+    public:
+    PurityInfo info;
+    // Parameters and let bound names. Blocks share their function's scope, so one set covers the whole body
+    std::vector<std::string> locals;
+
+    bool is_local(const std::string &name) {
+      return std::find(locals.begin(), locals.end(), name) != locals.end();
+    }
+
+    void capture(const std::string &name) {
+      if (is_local(name)) return;
+      if (std::find(info.captures.begin(), info.captures.end(), name) == info.captures.end()) {
+        info.captures.push_back(name);
+      }
+    }
+
+    void block(BlockStatement &node) {
+      auto statements = node.get_statements();
+      for (auto &stmt: statements) {
+        statement(stmt);
+      }
+    }
+
+    void statement(Statement &node) {
+      std::visit(overloads{
+                         [&](LetStatement &let) {
+                           expression(let.value);
+                           locals.push_back(let.name.string());
+                         },
+                         [&](ReturnStatement &ret) { expression(ret.return_value); },
+                         [&](ExpressionStatement &e) { expression(e.e); },
+                         [&](BlockStatement &b) { block(b); },
+                 },
+                 node);
+    }
+
+    void expression(Expression &node) {
+      std::visit(overloads{
+                         [&](IntegerLiteral &) {},
+                         [&](FloatLiteral &) {},
+                         [&](StringLiteral &) {},
+                         [&](CharLiteral &) {},
+                         [&](BooleanLiteral &) {},
+                         [&](Identifier &i) { capture(i.string()); },
+                         [&](PrefixExpression &p) { expression(*p.right); },
+                         [&](InfixExpression &i) {
+                           expression(*i.left);
+                           expression(*i.right);
+                         },
+                         [&](ArrayLiteral &a) {
+                           for (auto *element: a.elements) {
+                             expression(*element);
+                           }
+                         },
+                         [&](HashLiteral &h) {
+                           for (auto &[key, value]: h.pairs) {
+                             expression(*key);
+                             expression(*value);
+                           }
+                         },
+                         [&](IndexExpression &i) {
+                           expression(*i.left);
+                           expression(*i.index);
+                         },
+                         [&](IfExpression &i) {
+                           expression(*i.condition);
+                           block(*i.consequence);
+                           if (i.alternative.has_value()) block(*i.alternative.value());
+                         },
+                         [&](CallExpression &c) {
+                           // Calling a local means calling a function value we know nothing about
+                           auto *ident = std::get_if<Identifier>(c.function);
+                           if (ident == nullptr || is_local(ident->string())) {
+                             info.pure = false;
+                             return;
+                           }
+                           capture(ident->string());
+                           if (std::find(info.callees.begin(), info.callees.end(), ident->string()) == info.callees.end()) {
+                             info.callees.push_back(ident->string());
+                           }
+                           for (auto *arg: c.arguments) {
+                             expression(*arg);
+                           }
+                         },
+                         // Closures and anything newer than this analysis are not worth caching
+                         [&](auto &) { info.pure = false; },
+                 },
+                 node);
+    }
+  };
+
+  bool is_key(const Object &obj) {
+    return std::holds_alternative<Integer>(obj) || std::holds_alternative<Float>(obj) || std::holds_alternative<Boolean>(obj) ||
+           std::holds_alternative<Char>(obj) || std::holds_alternative<String>(obj);
+  }
+
+  // Find a binding like eval(Identifier), without its error reporting
+  Object *resolve(const std::string &name, Environment *scope) {
+    if (auto *obj = scope->find(name)) return obj;
+    return find_builtin(name);
+  }
+
+  uint64_t generation(Environment *scope) {
+    uint64_t sum = scope->version;
+    while (scope->outer.has_value()) {
+      scope = scope->outer.value().get();
+      sum += scope->version;
+    }
+    return sum;
+  }
+
+  MemoTable &table_for(const BlockStatement *source) {
+    return current_isolate().memo_tables[source->id];
+  }
+
+  // Everything the results of a function depend on, see MemoTable
+  class Dependencies {
+    public:
+    std::vector<std::shared_ptr<Environment>> scopes;
+    std::vector<uint64_t> generations;
+    std::vector<Object *> slots;
+    // Functions already visited, so recursion ends
+    std::vector<std::pair<const BlockStatement *, const Environment *>> seen;
+  };
+
+  // Resolve the captures of fn and, transitively, of the functions it calls. fn's own come first
+  void collect(Function &fn, Dependencies &deps) {
+    std::pair<const BlockStatement *, const Environment *> id = {fn.source, fn.env.get()};
+    if (std::find(deps.seen.begin(), deps.seen.end(), id) != deps.seen.end()) return;
+    deps.seen.push_back(id);
+    if (std::find(deps.scopes.begin(), deps.scopes.end(), fn.env) == deps.scopes.end()) {
+      deps.scopes.push_back(fn.env);
+      deps.generations.push_back(generation(fn.env.get()));
+    }
+
+    auto &table = table_for(fn.source);
+    if (!table.info.has_value()) table.info = analyze_purity(fn.parameters, fn.body);
+    auto &info = table.info.value();
+    // Never memoized, neither is anything calling it
+    if (!info.pure) return;
+    for (auto &name: info.captures) {
+      deps.slots.push_back(resolve(name, fn.env.get()));
+    }
+    for (auto &name: info.callees) {
+      auto *callee = std::get_if<Function>(resolve(name, fn.env.get()));
+      if (callee != nullptr && callee->source != nullptr) collect(*callee, deps);
+    }
+  }
+
+  bool up_to_date(MemoTable &table, Function &fn) {
+    if (table.scopes.empty() || table.scopes.front() != fn.env) return false;
+    for (size_t i = 0; i < table.scopes.size(); i++) {
+      if (generation(table.scopes[i].get()) != table.generations[i]) return false;
+    }
+    return true;
+  }
+
+  /*
+   * Bring the table for fn up to date with fn's bindings and decide whether fn is pure.
+   *
+   * A verdict and the cached results depend on the bindings of every function fn calls, not just its own: a callee may
+   * read a capture that has been shadowed since. They are dropped when any of those captures resolves to another slot.
+   *
+   * depth is the number of verdicts in progress further up. One reached again while in progress counts as pure for now,
+   * and low is lowered to its depth: a verdict that relied on one further up is left Unknown, as that may still turn out
+   * impure, and is made again on the next call.
+   */
+  MemoTable *prepare(Function &fn, size_t depth, size_t &low) {
+    auto &table = table_for(fn.source);
+    if (!table.info.has_value()) table.info = analyze_purity(fn.parameters, fn.body);
+    if (!table.info->pure) return nullptr;
+    // Reached through a callee while the verdict is being made, but bound in another scope: refreshing the table would
+    // drop the state the caller is still using
+    if (table.checking.has_value() && !up_to_date(table, fn)) return nullptr;
+
+    if (!up_to_date(table, fn)) {
+      Dependencies deps;
+      collect(fn, deps);
+      if (table.scopes.empty() || table.scopes.front() != fn.env || table.slots != deps.slots) {
+        if (!table.entries.empty()) memo_stats().invalidations++;
+        table.clear();
+        table.info = analyze_purity(fn.parameters, fn.body);
+        table.slots = std::move(deps.slots);
+      }
+      table.scopes = std::move(deps.scopes);
+      table.generations = std::move(deps.generations);
+    }
+    auto &info = table.info.value();
+
+    if (table.checking.has_value()) {
+      low = std::min(low, table.checking.value());
+      return &table;
+    }
+    if (table.purity == Purity::Unknown) {
+      table.checking = depth;
+      // The earliest verdict in progress this one relied on
+      size_t reached = depth;
+      bool pure = true;
+      bool known = true;
+      for (auto &name: info.callees) {
+        auto i = std::find(info.captures.begin(), info.captures.end(), name) - info.captures.begin();
+        auto *slot = table.slots[i];
+        // Unbound for now, so the call fails anyway; decide once it is bound
+        if (slot == nullptr) {
+          known = false;
+          pure = false;
+          break;
+        }
+        if (auto *builtin = std::get_if<Builtin>(slot)) {
+          if (builtin->pure) continue;
+          pure = false;
+          break;
+        }
+        auto *callee = std::get_if<Function>(slot);
+        if (callee == nullptr || callee->source == nullptr || prepare(*callee, depth + 1, reached) == nullptr) {
+          pure = false;
+          break;
+        }
+      }
+      table.checking = std::nullopt;
+      if (known && (!pure || reached >= depth)) table.purity = pure ? Purity::Pure : Purity::Impure;
+      low = std::min(low, reached);
+      if (!pure) return nullptr;
+    }
+    return table.purity == Purity::Impure ? nullptr : &table;
+  }
+}// namespace
+
+PurityInfo analyze_purity(std::vector<Identifier> &parameters, BlockStatement &body) {
+  PurityAnalysis analysis;
+  for (auto &param: parameters) {
+    analysis.locals.push_back(param.string());
+  }
+  analysis.block(body);
+  return analysis.info;
+}
+
+size_t MemoKeyHash::operator()(const std::vector<Object> &key) const {
+  size_t hash = key.size();
+  for (auto &obj: key) {
+    size_t h = std::visit(overloads{
+                                  [](const Integer &i) { return std::hash<int64_t>()(i.value); },
+                                  [](const Float &f) { return std::hash<double>()(f.value); },
+                                  [](const Boolean &b) { return std::hash<bool>()(b.value); },
+                                  [](const Char &c) { return std::hash<char>()(c.value); },
+                                  [](const String &s) { return std::hash<std::string_view>()(s.value()); },
+                                  [](const auto &) { return size_t(0); },
+                          },
+                          obj);
+    hash ^= h + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2) + obj.index();
+  }
+  return hash;
+}
+
+const Object *MemoTable::find(const std::vector<Object> &args) {
+  auto it = index.find(args);
+  if (it == index.end()) return nullptr;
+  entries.splice(entries.begin(), entries, it->second);
+  return &it->second->second;
+}
+
+void MemoTable::insert(std::vector<Object> args, Object result, size_t capacity) {
+  if (capacity == 0 || index.contains(args)) return;
+  if (entries.size() >= capacity) {
+    index.erase(entries.back().first);
+    entries.pop_back();
+    memo_stats().evictions++;
+  }
+  entries.emplace_front(std::move(args), std::move(result));
+  index.emplace(entries.front().first, entries.begin());
+}
+
+void MemoTable::clear() {
+  entries.clear();
+  index.clear();
+  purity = Purity::Unknown;
+  info = std::nullopt;
+  scopes.clear();
+  generations.clear();
+  slots.clear();
+}
+
+MemoConfig &memo_config() {
+  return current_isolate().config.memo;
+}
+
+MemoStats &memo_stats() {
+  return current_isolate().memo_stats;
+}
+
+void reset_memo_stats() {
+  memo_stats() = MemoStats();
+}
+
+std::string print_memo_stats(MemoStats &stats) {
+  auto total = stats.hits + stats.misses;
+  auto rate = total == 0 ? 0.0 : 100.0 * static_cast<double>(stats.hits) / static_cast<double>(total);
+  std::string out = "";
+  out += std::format("memo: {} hits, {} misses ({:.1f}% hit)\n", stats.hits, stats.misses, rate);
+  out += std::format("memo evictions: {}, invalidations: {}\n", stats.evictions, stats.invalidations);
+  out += std::format("memo skipped calls: {}\n", stats.skipped);
+  return out;
+}
+
+MemoTable *memo_table(Function &fn, const std::vector<Object> &args) {
+  if (fn.source == nullptr || !std::all_of(args.begin(), args.end(), is_key)) {
+    memo_stats().skipped++;
+    return nullptr;
+  }
+  size_t low = 0;
+  auto *table = prepare(fn, 0, low);
+  if (table == nullptr) memo_stats().skipped++;
+  return table;
+}
@@ -0,0 +1,105 @@
+//
+// Memoization of calls to pure functions.
+//
+
+#ifndef MONKE_CPP_MEMO_H
+#define MONKE_CPP_MEMO_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// Results a function remembers before the least recently used one is dropped
+constexpr size_t MEMO_DEFAULT_CAPACITY = 4096;
+
+class MemoConfig {
+  public:
+  // Off by default: a cached call skips the body entirely, which is only unobservable for pure code
+  bool enabled = false;
+  size_t capacity = MEMO_DEFAULT_CAPACITY;
+};
+
+class MemoStats {
+  public:
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  // Tables dropped because a captured binding may have been shadowed since they were filled
+  uint64_t invalidations = 0;
+  // Calls that could not be memoized: impure callee or arguments that are not scalars
+  uint64_t skipped = 0;
+};
+
+/*
+ * What the static analysis found out about a function body.
+ *
+ * A body is pure if it only binds locals, computes with operators and if/else, and calls functions by name. The names
+ * called are only known at run time, so they are kept and checked against the functions they are bound to on first call.
+ */
+class PurityInfo {
+  public:
+  bool pure = true;
+  // Identifiers the body reads from enclosing scopes, in first use order
+  std::vector<std::string> captures;
+  // The captures that are called, e.g. the function itself for recursion
+  std::vector<std::string> callees;
+};
+
+PurityInfo analyze_purity(std::vector<Identifier> &parameters, BlockStatement &body);
+
+// Scalar argument lists are the cache keys
+class MemoKeyHash {
+  public:
+  size_t operator()(const std::vector<Object> &key) const;
+};
+
+enum class Purity {
+  Unknown,
+  Pure,
+  Impure
+};
+
+// Memo cache of one function body
+class MemoTable {
+  public:
+  Purity purity = Purity::Unknown;
+  // Set while the verdict is being worked out, to the number of verdicts already in progress then. Recursive calls count
+  // as pure until it is made
+  std::optional<size_t> checking = std::nullopt;
+  std::optional<PurityInfo> info = std::nullopt;
+  // The scope the cached results were computed in, then the scopes of the functions it calls directly or through other
+  // functions, with the sum of the versions of each chain when the captures were last resolved
+  std::vector<std::shared_ptr<Environment>> scopes;
+  std::vector<uint64_t> generations;
+  // Where the captures of the function and of every function it calls were bound. Bindings are never overwritten, so
+  // the results stay valid until one of them resolves to a different slot
+  std::vector<Object *> slots;
+
+  // Most recently used first
+  std::list<std::pair<std::vector<Object>, Object>> entries;
+  std::unordered_map<std::vector<Object>, decltype(entries)::iterator, MemoKeyHash> index;
+
+  const Object *find(const std::vector<Object> &args);
+  void insert(std::vector<Object> args, Object result, size_t capacity);
+  // Drop the results, the verdict and the analysis, e.g. because a capture was shadowed
+  void clear();
+};
+
+MemoConfig &memo_config();
+MemoStats &memo_stats();
+void reset_memo_stats();
+std::string print_memo_stats(MemoStats &stats);
+
+/**
+ * The memo table for a call to fn with args, after checking that fn is pure and that args can be used as a key
+ * @return nullptr if the call has to be evaluated normally
+ */
+MemoTable *memo_table(Function &fn, const std::vector<Object> &args);
+
+#endif//MONKE_CPP_MEMO_H
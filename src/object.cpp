@@ -5,6 +5,11 @@
 #include <variant>
 #include <format>
 
+#include "allocation.h"
+#include "event_log.h"
+#include "hash_table.h"
+#include "intern.h"
+#include "persistent_map.h"
 #include "utils.h"
 #include "object.h"
 
@@ -21,8 +26,90 @@ std::string Boolean::inspect() {
   return std::format("BooleanLiteral({})", value ? "true" : "false");
 }
 
+String::String(std::string value) {
+  AllocationScope allocations(AllocationSite::String);
+  if (value.size() <= INLINE_CAPACITY) {
+    *this = String(std::string_view(value));
+  } else {
+    contents = std::make_shared<const Rope>(std::move(value));
+  }
+}
+
+String::String(std::string_view value) {
+  AllocationScope allocations(AllocationSite::String);
+  if (value.size() <= INLINE_CAPACITY) {
+    Inline small;
+    small.length = static_cast<uint8_t>(value.size());
+    value.copy(small.chars, value.size());
+    contents = small;
+  } else {
+    contents = std::make_shared<const Rope>(std::string(value));
+  }
+}
+
+String String::symbol(const std::string *interned) {
+  String out("");
+  out.contents = interned;
+  return out;
+}
+
 std::string String::inspect() {
-  return std::format("String({})", value);
+  return std::format("String({})", value());
+}
+
+size_t String::size() const {
+  return std::visit(overloads{
+                            [](const Inline &small) -> size_t { return small.length; },
+                            [](const std::string *interned) { return interned->size(); },
+                            [](const std::shared_ptr<const Rope> &rope) { return rope->size(); },
+                    },
+                    contents);
+}
+
+std::string_view String::value() const {
+  return std::visit(overloads{
+                            [](const Inline &small) { return std::string_view(small.chars, small.length); },
+                            [](const std::string *interned) { return std::string_view(*interned); },
+                            [](const std::shared_ptr<const Rope> &rope) { return std::string_view(rope->flat()); },
+                    },
+                    contents);
+}
+
+const std::string *String::interned() const {
+  auto *interned = std::get_if<const std::string *>(&contents);
+  return interned != nullptr ? *interned : nullptr;
+}
+
+const Rope *String::heap() const {
+  auto *rope = std::get_if<std::shared_ptr<const Rope>>(&contents);
+  return rope != nullptr ? rope->get() : nullptr;
+}
+
+std::shared_ptr<const Rope> String::rope() const {
+  AllocationScope allocations(AllocationSite::String);
+  if (auto *rope = std::get_if<std::shared_ptr<const Rope>>(&contents)) return *rope;
+  return std::make_shared<const Rope>(std::string(value()));
+}
+
+String String::operator+(const String &other) const {
+  AllocationScope allocations(AllocationSite::String);
+  size_t length = size() + other.size();
+  if (length < Rope::FLAT_LIMIT) {
+    std::string joined;
+    joined.reserve(length);
+    joined += value();
+    joined += other.value();
+    return String(std::move(joined));
+  }
+  return String(Rope::concat(rope(), other.rope()));
+}
+
+bool String::operator==(const String &other) const {
+  auto *symbol = interned();
+  auto *other_symbol = other.interned();
+  // Interning keeps one copy of each string, so different symbols always have different characters
+  if (symbol != nullptr && other_symbol != nullptr) return symbol == other_symbol;
+  return size() == other.size() && value() == other.value();
 }
 
 std::string Char::inspect() {
@@ -47,6 +134,244 @@ std::string Function::inspect() {
 
 }
 
+std::string Builtin::inspect() {
+  return std::format("Builtin({})", *name);
+}
+
+namespace {
+  Object box(int64_t value) { return Integer(value); }
+  Object box(double value) { return Float(value); }
+  Object box(const Object &value) { return value; }
+
+  // Whether value can be stored among elements of type T without boxing them
+  template<typename T>
+  bool fits(const Object &value) {
+    if constexpr (std::is_same_v<T, int64_t>) return std::holds_alternative<Integer>(value);
+    if constexpr (std::is_same_v<T, double>) return std::holds_alternative<Float>(value);
+    return true;
+  }
+
+  template<typename T>
+  T unbox(Object value) {
+    if constexpr (std::is_same_v<T, int64_t>) return std::get<Integer>(value).value;
+    if constexpr (std::is_same_v<T, double>) return std::get<Float>(value).value;
+    if constexpr (std::is_same_v<T, Object>) return value;
+  }
+
+  template<typename T>
+  void append_to(std::vector<T> &v, T value) { v.push_back(std::move(value)); }
+  template<typename T>
+  void append_to(PersistentVector<T> &v, T value) { v.push_in_place(std::move(value)); }
+  template<typename T>
+  void assign_to(std::vector<T> &v, size_t i, T value) { v[i] = std::move(value); }
+  template<typename T>
+  void assign_to(PersistentVector<T> &v, size_t i, T value) { v.set_in_place(i, std::move(value)); }
+
+  template<typename T>
+  Array::Elements persistent(const std::vector<T> &v) { return PersistentVector<T>::from(v); }
+  template<typename T>
+  Array::Elements persistent(const PersistentVector<T> &v) { return v; }
+
+  template<typename T>
+  std::vector<T> range(const std::vector<T> &v, size_t from, size_t to) { return std::vector<T>(v.begin() + from, v.begin() + to); }
+  template<typename T>
+  std::vector<T> range(const PersistentVector<T> &v, size_t from, size_t to) {
+    std::vector<T> out;
+    out.reserve(to - from);
+    for (size_t i = from; i < to; i++) out.push_back(v[i]);
+    return out;
+  }
+}// namespace
+
+// Made non-const, so own() may change elements nothing else holds
+Array::Array(Elements elements) : elements(std::make_shared<Elements>(std::move(elements))) {}
+
+Array Array::from(std::vector<Object> values) {
+  bool integers = std::all_of(values.begin(), values.end(), [](Object &v) { return std::holds_alternative<Integer>(v); });
+  bool floats = !values.empty() && std::all_of(values.begin(), values.end(), [](Object &v) { return std::holds_alternative<Float>(v); });
+  if (integers) {
+    std::vector<int64_t> unboxed;
+    unboxed.reserve(values.size());
+    for (auto &v: values) {
+      unboxed.push_back(std::get<Integer>(v).value);
+    }
+    return Array(std::move(unboxed));
+  }
+  if (floats) {
+    std::vector<double> unboxed;
+    unboxed.reserve(values.size());
+    for (auto &v: values) {
+      unboxed.push_back(std::get<Float>(v).value);
+    }
+    return Array(std::move(unboxed));
+  }
+  return Array(std::move(values));
+}
+
+size_t Array::size() const {
+  return std::visit([](auto &v) { return v.size(); }, *elements);
+}
+
+Object Array::at(size_t i) const {
+  return std::visit([&](auto &v) { return box(v[i]); }, *elements);
+}
+
+bool Array::contiguous() const {
+  return std::holds_alternative<std::vector<int64_t>>(*elements) || std::holds_alternative<std::vector<double>>(*elements) ||
+         std::holds_alternative<std::vector<Object>>(*elements);
+}
+
+Array Array::flatten() const {
+  if (contiguous()) return *this;
+  return std::visit(overloads{
+                            [](const auto &v) -> Array { return Array(v.to_vector()); },
+                            [](const std::vector<int64_t> &v) -> Array { return Array(v); },
+                            [](const std::vector<double> &v) -> Array { return Array(v); },
+                            [](const std::vector<Object> &v) -> Array { return Array(v); },
+                    },
+                    *elements);
+}
+
+Array::Elements &Array::own() {
+  if (elements.use_count() != 1) elements = std::make_shared<Elements>(*elements);
+  // Created non-const by the constructor and held by nothing else, so no other array sees the change
+  return const_cast<Elements &>(*elements);
+}
+
+Array Array::push(const Object &value) const {
+  auto out = *this;
+  out.append(value);
+  return out;
+}
+
+void Array::append(Object value) {
+  bool unboxed = std::visit([&](auto &v) { return fits<typename std::remove_cvref_t<decltype(v)>::value_type>(value); }, *elements);
+  if (!unboxed) {
+    // Mixing types boxes everything, unless there was nothing to mix with
+    if (size() == 0) {
+      *this = from({std::move(value)});
+      return;
+    }
+    std::vector<Object> boxed;
+    boxed.reserve(size() + 1);
+    for (size_t i = 0; i < size(); i++) {
+      boxed.push_back(at(i));
+    }
+    elements = contiguous() ? std::make_shared<Elements>(std::move(boxed)) : std::make_shared<Elements>(PersistentVector<Object>::from(boxed));
+  } else if (elements.use_count() != 1 && contiguous() && size() >= CONTIGUOUS_LIMIT) {
+    // Copying would cost as much as the switch, which makes the next updates cheap
+    elements = std::make_shared<Elements>(std::visit([](auto &v) { return persistent(v); }, *elements));
+  }
+  std::visit([&](auto &v) { append_to(v, unbox<typename std::remove_cvref_t<decltype(v)>::value_type>(std::move(value))); }, own());
+}
+
+void Array::assign(size_t i, Object value) {
+  bool unboxed = std::visit([&](auto &v) { return fits<typename std::remove_cvref_t<decltype(v)>::value_type>(value); }, *elements);
+  if (!unboxed) {
+    std::vector<Object> boxed;
+    boxed.reserve(size());
+    for (size_t j = 0; j < size(); j++) {
+      boxed.push_back(at(j));
+    }
+    elements = contiguous() ? std::make_shared<Elements>(std::move(boxed)) : std::make_shared<Elements>(PersistentVector<Object>::from(boxed));
+  } else if (elements.use_count() != 1 && contiguous() && size() >= CONTIGUOUS_LIMIT) {
+    elements = std::make_shared<Elements>(std::visit([](auto &v) { return persistent(v); }, *elements));
+  }
+  std::visit([&](auto &v) { assign_to(v, i, unbox<typename std::remove_cvref_t<decltype(v)>::value_type>(std::move(value))); }, own());
+}
+
+Array Array::slice(size_t from, size_t to) const {
+  to = std::min(to, size());
+  from = std::min(from, to);
+  return std::visit([&](auto &v) { return Array(range(v, from, to)); }, *elements);
+}
+
+std::string Array::inspect() {
+  std::vector<std::string> values;
+  for (size_t i = 0; i < size(); i++) {
+    values.push_back(::inspect(at(i)));
+  }
+  return std::format("Array([{}])", str_join(values, ", "));
+}
+
+bool Array::operator==(const Array &other) const {
+  if (other.size() != size()) return false;
+  for (size_t i = 0; i < size(); i++) {
+    if (!(other.at(i) == at(i))) return false;
+  }
+  return true;
+}
+
+Vec::Vec(Elements elements) : elements(std::make_shared<const Elements>(std::move(elements))) {}
+
+size_t Vec::size() const {
+  return std::visit([](auto &v) { return v.size(); }, *elements);
+}
+
+Object Vec::at(size_t i) const {
+  return std::visit(overloads{
+                            [&](const std::vector<int64_t> &v) -> Object { return Integer(v[i]); },
+                            [&](const std::vector<double> &v) -> Object { return Float(v[i]); },
+                    },
+                    *elements);
+}
+
+std::string Vec::inspect() {
+  std::vector<std::string> values;
+  for (size_t i = 0; i < size(); i++) {
+    values.push_back(std::visit([&](auto &v) { return std::format("{}", v[i]); }, *elements));
+  }
+  return std::format("Vec([{}])", str_join(values, ", "));
+}
+
+Hash::Hash(HashTable table) : storage(std::make_shared<Storage>(std::move(table))) {}
+
+size_t Hash::size() const {
+  return std::visit([](auto &map) { return map.size(); }, *storage);
+}
+
+const Object *Hash::find(const HashKey &key) const {
+  return std::visit([&](auto &map) { return map.find(key); }, *storage);
+}
+
+std::vector<std::pair<HashKey, Object>> Hash::items() const {
+  return std::visit(overloads{
+                            [](const HashTable &table) { return table.items(); },
+                            [](const PersistentMap &map) { return map.items().to_vector(); },
+                    },
+                    *storage);
+}
+
+Hash::Storage &Hash::own() {
+  if (storage.use_count() != 1) storage = std::make_shared<Storage>(*storage);
+  // See Array::own
+  return const_cast<Storage &>(*storage);
+}
+
+void Hash::insert(const HashKey &key, Object value) {
+  if (auto *table = std::get_if<HashTable>(storage.get()); table != nullptr && storage.use_count() != 1 && table->size() >= TABLE_LIMIT) {
+    storage = std::make_shared<Storage>(PersistentMap(*table));
+  }
+  std::visit([&](auto &map) { map.insert(key, std::move(value)); }, own());
+}
+
+std::string Hash::inspect() {
+  std::vector<std::string> pairs;
+  for (const auto &[key, value]: items()) {
+    pairs.push_back(std::format("{}: {}", ::inspect(key.object()), ::inspect(value)));
+  }
+  return std::format("Hash({{{}}})", str_join(pairs, ", "));
+}
+
+bool Hash::operator==(const Hash &other) const {
+  if (other.size() != size()) return false;
+  for (const auto &[key, value]: items()) {
+    const auto *found = other.find(key);
+    if (found == nullptr || !(*found == value)) return false;
+  }
+  return true;
+}
+
 std::string inspect(Object obj) {
   return std::visit([](auto &&arg) {return arg.inspect(); }, obj);
 }
@@ -65,6 +390,11 @@ std::string get_type_name(Object &obj){
                     [](Null) { return "Null"; },
                     [](ReturnObject) { return "ReturnObject"; },
                     [](Function) { return "Function"; },
+                    [](NativeFunction) { return "Function"; },
+                    [](Builtin) { return "Builtin"; },
+                    [](Array) { return "Array"; },
+                    [](Vec) { return "Vec"; },
+                    [](Hash) { return "Hash"; },
                       },
                     obj);
   unimplemented();
@@ -76,19 +406,25 @@ ObjectResult Environment::get(std::string ident) {
   }
 
   if (outer.has_value()){
-    auto out = outer.value()->get(ident);
-    if (out.has_value()) {
-      return out.value();
-    }
+    return outer.value()->get(ident);
   }
 
-  auto err = std::format("identifier not found: {}", ident);
-  std::cout << err << std::endl;
-  return std::unexpected(TypeError(err));
+  log_event_copy<EventLevel::Debug>(EventKind::LookupMiss, ident);
+  return std::unexpected(TypeError(std::format("identifier not found: {}", ident)));
+}
+
+Object *Environment::find(const std::string &ident) {
+  Environment *scope = this;
+  while (true) {
+    if (auto it = scope->env.find(ident); it != scope->env.end()) return &it->second;
+    if (!scope->outer.has_value()) return nullptr;
+    scope = scope->outer.value().get();
+  }
 }
 
 void Environment::set(std::string ident, Object obj) {
-  env.insert({ident, obj});
+  AllocationScope allocations(AllocationSite::Binding);
+  if (env.try_emplace(std::move(ident), std::move(obj)).second) version++;
 }
 
 std::string print_env(Environment &env) {
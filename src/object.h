@@ -7,13 +7,20 @@
 
 #include <cstdint>
 #include <expected>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <variant>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
 
 #include "ast.h"
+#include "intern.h"
 #include "lexer.h"
+#include "persistent_vector.h"
+#include "rope.h"
 
 class Environment;
 
@@ -25,12 +32,25 @@ class String;
 class Char;
 class ReturnObject;
 class Function;
-typedef std::variant<Float, Integer, String, Char, Boolean, Null, ReturnObject, Function> Object;
+class NativeFunction;
+class Builtin;
+class Array;
+class Vec;
+class Hash;
+typedef std::variant<Float, Integer, String, Char, Boolean, Null, ReturnObject, Function, NativeFunction, Builtin, Array, Vec, Hash> Object;
+
+class HashKey;
+class HashTable;
+class PersistentMap;
 
 class TypeError;
 typedef std::variant<TypeError, LexerError> Error;
 typedef std::expected<Object, Error> ObjectResult;
 
+// Calling convention of builtins: the caller's evaluated arguments, in place. They are not used after the call, so a
+// builtin may move out of them
+typedef ObjectResult (*BuiltinFunction)(std::span<Object> args);
+
 std::string get_type_name(Object &obj_res);
 
 class TypeError {
@@ -44,13 +64,126 @@ class TypeError {
 class Function {
   public:
       Function(std::vector<Identifier> parameters, BlockStatement body, std::shared_ptr<Environment> env) : parameters(parameters), body(body), env(env){};
+      Function(std::vector<Identifier> parameters, BlockStatement body, std::shared_ptr<Environment> env, const BlockStatement *source) : parameters(parameters), body(body), env(env), source(source){};
       std::vector<Identifier> parameters;
       BlockStatement body;
       std::shared_ptr<Environment> env;
+      // The parser owned body this function was created from. Unlike `body` it is stable across copies,
+      // so it identifies the function's code (nullptr for functions built by hand)
+      const BlockStatement *source = nullptr;
       std::string inspect();
     bool operator==(const Function &) const { return true; };
 };
 
+// A function implemented in C++, e.g. a closure emitted by the transpiler. Behaves like Function to Monke code
+class NativeFunction {
+  public:
+  NativeFunction(size_t arity, std::function<ObjectResult(std::vector<Object> &)> fn) : arity(arity), fn(std::move(fn)){};
+  size_t arity;
+  std::function<ObjectResult(std::vector<Object> &)> fn;
+  std::string inspect() { return "Fn"; };
+  bool operator==(const NativeFunction &) const { return true; };
+};
+
+// A natively implemented function registered by name, see builtins.h
+class Builtin {
+  public:
+  Builtin(std::string_view name, std::optional<size_t> arity, bool pure, BuiltinFunction fn) : name(intern(name)), arity(arity), pure(pure), fn(fn){};
+  // Interned, so it stays valid after the registry that defined the builtin is gone
+  const std::string *name;
+  // nullopt for builtins taking any number of arguments
+  std::optional<size_t> arity;
+  // No observable effects, so calls may be cached or reordered
+  bool pure;
+  BuiltinFunction fn;
+  std::string inspect();
+  bool operator==(const Builtin &other) const { return other.fn == fn; };
+};
+
+/*
+ * An immutable sequence of values.
+ *
+ * While every element is an Integer, or every element a Float, they are stored unboxed; an array holding anything
+ * else, or a mix, stores boxed Objects. Literals and small arrays keep their elements in one contiguous vector. Updating
+ * a larger array that another array still shares switches it to a PersistentVector, so that each later update copies
+ * O(log32 n) elements rather than all of them. The elements are shared between copies, so passing an array around
+ * never copies them.
+ */
+class Array {
+  public:
+  typedef std::variant<std::vector<int64_t>, std::vector<double>, std::vector<Object>,
+                       PersistentVector<int64_t>, PersistentVector<double>, PersistentVector<Object>>
+          Elements;
+  // Shared arrays up to this size are copied by updates instead of switching to a PersistentVector
+  static constexpr size_t CONTIGUOUS_LIMIT = 32;
+  explicit Array(Elements elements);
+  // The most compact representation holding values
+  static Array from(std::vector<Object> values);
+  std::shared_ptr<const Elements> elements;
+  size_t size() const;
+  // i must be in range
+  Object at(size_t i) const;
+  // The elements are one vector rather than a PersistentVector
+  bool contiguous() const;
+  // The same values in contiguous elements
+  Array flatten() const;
+  // A new array with value appended. Stays unboxed as long as value has the elements' type
+  Array push(const Object &value) const;
+  // Append value to this array. Done in place when no other array shares the elements, which nothing else can observe,
+  // so building an array nobody else holds is amortized O(1) per element
+  void append(Object value);
+  // Replace element i, which must be in range. In place under the same condition as append
+  void assign(size_t i, Object value);
+  // A new array with the elements in [from, to), both clamped to the size
+  Array slice(size_t from, size_t to) const;
+  std::string inspect();
+  bool operator==(const Array &other) const;
+
+  private:
+  // The elements, copied first if another array shares them
+  Elements &own();
+};
+
+// A packed vector of numbers for the vectorized builtins (sum, dot, map_add, ...). Immutable and shared like Array, but never boxed
+class Vec {
+  public:
+  typedef std::variant<std::vector<int64_t>, std::vector<double>> Elements;
+  explicit Vec(Elements elements);
+  std::shared_ptr<const Elements> elements;
+  size_t size() const;
+  // i must be in range
+  Object at(size_t i) const;
+  std::string inspect();
+  bool operator==(const Vec &other) const { return *other.elements == *elements; };
+};
+
+/*
+ * An immutable map from Integer, Boolean, Char or String keys to values.
+ *
+ * Literals build a HashTable, the fastest to look keys up in. Adding to a larger hash that another hash still shares
+ * switches it to a PersistentMap, which later additions share structure with rather than copy. Copies share the storage.
+ */
+class Hash {
+  public:
+  typedef std::variant<HashTable, PersistentMap> Storage;
+  // Shared tables up to this size are copied by updates instead of switching to a PersistentMap
+  static constexpr size_t TABLE_LIMIT = 32;
+  explicit Hash(HashTable table);
+  std::shared_ptr<const Storage> storage;
+  size_t size() const;
+  // nullptr if key is absent
+  const Object *find(const HashKey &key) const;
+  // Every entry, in the order its key was first inserted
+  std::vector<std::pair<HashKey, Object>> items() const;
+  // Bind key to value in this hash. In place when no other hash shares the storage, like Array::append
+  void insert(const HashKey &key, Object value);
+  std::string inspect();
+  bool operator==(const Hash &other) const;
+
+  private:
+  Storage &own();
+};
+
 class ReturnObject {
   public:
   Object *value;
@@ -84,12 +217,43 @@ class Float{
   bool operator==(const Float &other) const { return other.value == value; }
 };
 
+/*
+ * An immutable string.
+ *
+ * Strings up to INLINE_CAPACITY characters live in the value itself. Evaluating a string literal refers to the copy
+ * interned by the parser (see intern.h) rather than copying it, and two interned strings are equal exactly when they
+ * are the same symbol. + links long operands in a Rope instead of copying them, see rope.h.
+ */
 class String {
   public:
-  std::string value;
+  static constexpr size_t INLINE_CAPACITY = 22;
+  String(std::string value);
+  String(std::string_view value);
+  String(const char *value) : String(std::string_view(value)) {}
+  explicit String(std::shared_ptr<const Rope> rope) : contents(std::move(rope)) {}
+  // interned must come from intern()
+  static String symbol(const std::string *interned);
   std::string inspect();
-  String(std::string value) : value(value) {}
-  bool operator==(const String &other) const { return other.value == value; }
+  size_t size() const;
+  // The characters, flattening a rope on first use. Only valid while this value is alive and not assigned to: inline
+  // characters are viewed where they are, inside the value itself
+  std::string_view value() const;
+  // The interned copy this refers to, or nullptr if it holds its own characters
+  const std::string *interned() const;
+  // The rope holding the characters, or nullptr if they are inline or interned
+  const Rope *heap() const;
+  String operator+(const String &other) const;
+  bool operator==(const String &other) const;
+
+  private:
+  class Inline {
+    public:
+    uint8_t length;
+    char chars[INLINE_CAPACITY];
+  };
+  std::variant<Inline, const std::string *, std::shared_ptr<const Rope>> contents;
+
+  std::shared_ptr<const Rope> rope() const;
 };
 
 class Char {
@@ -115,7 +279,12 @@ class Environment {
   public:
   std::optional<std::shared_ptr<Environment>> outer;
   std::unordered_map<std::string, Object> env;
+  // Bumped whenever a new binding is added. Bindings are never overwritten or removed,
+  // so an unchanged version means every previous lookup through this scope still holds
+  uint64_t version = 0;
   ObjectResult get(std::string ident);
+  // The binding for ident in this scope or an enclosing one, nullptr if there is none. Unlike get this does not copy or report
+  Object *find(const std::string &ident);
   void set(std::string ident, Object obj);
 };
 
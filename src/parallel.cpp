@@ -0,0 +1,378 @@
+//
+// Parallel evaluation of independent top level statements.
+//
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+#include "builtins.h"
+#include "eval.h"
+#include "isolate.h"
+#include "parallel.h"
+
+namespace {
+  thread_local bool worker_thread = false;
+
+  class StatementAnalysis {
+    public:
+    StatementInfo info;
+    // Number of function literals we are inside. Their lets and returns only touch the call's own scope
+    size_t functions = 0;
+
+    // Whether the statement calls anything while it runs, which may run any function literal in it. Calls inside a
+    // literal only happen once something calls the literal
+    bool calls = false;
+
+    void use(const std::string &name) {
+      if (std::find(info.uses.begin(), info.uses.end(), name) == info.uses.end()) {
+        info.uses.push_back(name);
+      }
+      if (functions == 0 && std::find(info.reads.begin(), info.reads.end(), name) == info.reads.end()) {
+        info.reads.push_back(name);
+      }
+    }
+
+    void block(BlockStatement &node) {
+      auto statements = node.get_statements();
+      for (auto &stmt: statements) {
+        statement(stmt);
+      }
+    }
+
+    void statement(Statement &node) {
+      std::visit(overloads{
+                         [&](LetStatement &let) {
+                           // Blocks share the enclosing scope, so outside a function this binds a global
+                           if (functions == 0) info.serial = true;
+                           expression(let.value);
+                         },
+                         [&](ReturnStatement &ret) {
+                           if (functions == 0) info.serial = true;
+                           expression(ret.return_value);
+                         },
+                         [&](ExpressionStatement &e) { expression(e.e); },
+                         [&](BlockStatement &b) { block(b); },
+                 },
+                 node);
+    }
+
+    void expression(Expression &node) {
+      std::visit(overloads{
+                         [&](IntegerLiteral &) {},
+                         [&](FloatLiteral &) {},
+                         [&](StringLiteral &) {},
+                         [&](CharLiteral &) {},
+                         [&](BooleanLiteral &) {},
+                         [&](Identifier &i) { use(i.string()); },
+                         [&](PrefixExpression &p) { expression(*p.right); },
+                         [&](InfixExpression &i) {
+                           expression(*i.left);
+                           expression(*i.right);
+                         },
+                         [&](ArrayLiteral &a) {
+                           for (auto *element: a.elements) {
+                             expression(*element);
+                           }
+                         },
+                         [&](HashLiteral &h) {
+                           for (auto &[key, value]: h.pairs) {
+                             expression(*key);
+                             expression(*value);
+                           }
+                         },
+                         [&](IndexExpression &i) {
+                           expression(*i.left);
+                           expression(*i.index);
+                         },
+                         [&](IfExpression &i) {
+                           expression(*i.condition);
+                           block(*i.consequence);
+                           if (i.alternative.has_value()) block(*i.alternative.value());
+                         },
+                         [&](FunctionLiteral &f) {
+                           functions++;
+                           block(*f.body);
+                           functions--;
+                         },
+                         [&](CallExpression &c) {
+                           if (functions == 0) calls = true;
+                           expression(*c.function);
+                           for (auto *arg: c.arguments) {
+                             expression(*arg);
+                           }
+                         },
+                         // Nothing is known about it, so keep it in program order
+                         [&](auto &) { info.serial = true; },
+                 },
+                 node);
+    }
+  };
+
+  WorkStealingPool &pool() {
+    auto &instance = current_isolate().pool;
+    auto threads = parallel_config().threads;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (instance == nullptr || instance->size() != threads) {
+      instance = std::make_unique<WorkStealingPool>(threads);
+    }
+    return *instance;
+  }
+}// namespace
+
+StatementInfo analyze_statement(Statement &node) {
+  StatementAnalysis analysis;
+  std::visit(overloads{
+                     [&](LetStatement &let) {
+                       analysis.info.defines = let.name.string();
+                       analysis.expression(let.value);
+                     },
+                     [&](ReturnStatement &ret) {
+                       analysis.info.serial = true;
+                       analysis.expression(ret.return_value);
+                     },
+                     [&](ExpressionStatement &e) { analysis.expression(e.e); },
+                     [&](BlockStatement &b) {
+                       analysis.info.serial = true;
+                       analysis.block(b);
+                     },
+             },
+             node);
+  if (analysis.calls) analysis.info.reads = analysis.info.uses;
+  return analysis.info;
+}
+
+std::vector<std::vector<size_t>> statement_dependencies(std::vector<StatementInfo> &infos) {
+  std::unordered_map<std::string, std::vector<size_t>> definers;
+  for (size_t i = 0; i < infos.size(); i++) {
+    if (infos[i].defines.has_value()) definers[infos[i].defines.value()].push_back(i);
+  }
+
+  std::vector<std::set<size_t>> deps(infos.size());
+  std::optional<size_t> last_serial = std::nullopt;
+  for (size_t j = 0; j < infos.size(); j++) {
+    // The first binding of a name wins, so later ones have to wait for it
+    if (infos[j].defines.has_value()) {
+      for (auto i: definers[infos[j].defines.value()]) {
+        if (i < j) deps[j].insert(i);
+      }
+    }
+
+    // Follow calls: the names a function's body uses are looked up when j calls it
+    std::vector<std::string> names = infos[j].reads;
+    std::set<std::string> seen(names.begin(), names.end());
+    while (!names.empty()) {
+      auto name = names.back();
+      names.pop_back();
+      auto it = definers.find(name);
+      if (it != definers.end()) {
+        for (auto i: it->second) {
+          if (i > j) {
+            deps[i].insert(j);
+          }
+        }
+      }
+      // The binding j sees is the first one made before it. Without one the name is a builtin, and one with effects (puts)
+      // has to happen in program order
+      if (it == definers.end() || it->second.front() >= j) {
+        auto *builtin = find_builtin(name);
+        if (builtin != nullptr && !std::get<Builtin>(*builtin).pure) infos[j].serial = true;
+        continue;
+      }
+      auto i = it->second.front();
+      deps[j].insert(i);
+      for (auto &used: infos[i].uses) {
+        if (seen.insert(used).second) names.push_back(used);
+      }
+    }
+
+    if (infos[j].serial) {
+      for (size_t i = 0; i < j; i++) {
+        deps[j].insert(i);
+      }
+      last_serial = j;
+    } else if (last_serial.has_value()) {
+      deps[j].insert(last_serial.value());
+    }
+  }
+
+  std::vector<std::vector<size_t>> out;
+  for (auto &d: deps) {
+    out.emplace_back(d.begin(), d.end());
+  }
+  return out;
+}
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+  for (size_t i = 0; i < threads; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back([this, i]() { work(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker: workers) {
+    worker.join();
+  }
+}
+
+void WorkStealingPool::run(std::vector<std::function<void()>> &tasks) {
+  if (tasks.empty()) return;
+  {
+    std::lock_guard lock(mutex);
+    pending += tasks.size();
+  }
+  for (size_t i = 0; i < tasks.size(); i++) {
+    auto &queue = *queues[i % queues.size()];
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(tasks[i]));
+  }
+  {
+    std::lock_guard lock(mutex);
+    epoch++;
+  }
+  wake.notify_all();
+
+  std::unique_lock lock(mutex);
+  done.wait(lock, [&]() { return pending == 0; });
+  parallel_stats().steals += steals;
+  steals = 0;
+}
+
+std::optional<std::function<void()>> WorkStealingPool::take(size_t self) {
+  {
+    auto &own = *queues[self];
+    std::lock_guard lock(own.mutex);
+    if (!own.tasks.empty()) {
+      auto task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return task;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); i++) {
+    auto &victim = *queues[(self + i) % queues.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      auto task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      std::lock_guard stats_lock(mutex);
+      steals++;
+      return task;
+    }
+  }
+  return std::nullopt;
+}
+
+void WorkStealingPool::work(size_t self) {
+  worker_thread = true;
+  uint64_t seen = 0;
+  while (true) {
+    if (auto task = take(self)) {
+      (*task)();
+      std::lock_guard lock(mutex);
+      if (--pending == 0) done.notify_all();
+      continue;
+    }
+    std::unique_lock lock(mutex);
+    wake.wait(lock, [&]() { return stopping || epoch != seen; });
+    if (stopping) return;
+    seen = epoch;
+  }
+}
+
+ParallelConfig &parallel_config() {
+  return current_isolate().config.parallel;
+}
+
+ParallelStats &parallel_stats() {
+  return current_isolate().parallel_stats;
+}
+
+void reset_parallel_stats() {
+  parallel_stats() = ParallelStats();
+}
+
+bool in_parallel_worker() {
+  return worker_thread;
+}
+
+ObjectResult evaluate_parallel(Program &node, std::shared_ptr<Environment> env) {
+  auto &statements = node.statements;
+  std::vector<StatementInfo> infos;
+  for (auto &stmt: statements) {
+    infos.push_back(analyze_statement(stmt));
+  }
+  auto deps = statement_dependencies(infos);
+
+  // Dependencies always point backwards, so one pass assigns every statement its wave
+  std::vector<size_t> level(statements.size(), 0);
+  size_t levels = 0;
+  for (size_t j = 0; j < statements.size(); j++) {
+    for (auto i: deps[j]) {
+      level[j] = std::max(level[j], level[i] + 1);
+    }
+    levels = std::max(levels, level[j] + 1);
+  }
+  std::vector<std::vector<size_t>> waves(levels);
+  for (size_t j = 0; j < statements.size(); j++) {
+    waves[level[j]].push_back(j);
+  }
+
+  // A let's value is computed in its wave and bound after it. Serial statements are always alone in theirs and bind themselves
+  std::vector<ObjectResult> results(statements.size(), ObjectResult(Object(Null())));
+  auto run = [&](size_t j) {
+    auto *let = std::get_if<LetStatement>(&statements[j]);
+    results[j] = let != nullptr && !infos[j].serial ? eval(let->value, env) : eval(statements[j], env);
+  };
+
+  // First statement that failed or returned; sequential evaluation would not have got past it
+  size_t stop = statements.size();
+  for (auto &wave: waves) {
+    std::vector<size_t> ready;
+    for (auto j: wave) {
+      if (j < stop) ready.push_back(j);
+    }
+    if (ready.empty()) continue;
+    parallel_stats().waves++;
+
+    if (ready.size() == 1) {
+      run(ready[0]);
+    } else {
+      std::vector<std::function<void()>> tasks;
+      auto *isolate = &current_isolate();
+      for (auto j: ready) {
+        tasks.push_back([&run, j, isolate]() {
+          IsolateScope scope(*isolate);
+          run(j);
+        });
+      }
+      parallel_stats().parallel_statements += tasks.size();
+      pool().run(tasks);
+    }
+
+    for (auto j: ready) {
+      if (!results[j].has_value() || std::holds_alternative<ReturnObject>(results[j].value())) {
+        stop = std::min(stop, j);
+        continue;
+      }
+      if (auto *let = std::get_if<LetStatement>(&statements[j]); let != nullptr && !infos[j].serial) {
+        env->set(let->name.string(), results[j].value());
+        results[j] = Object(Null());
+      }
+    }
+  }
+
+  if (stop < statements.size()) {
+    auto &result = results[stop];
+    if (result.has_value()) return *std::get<ReturnObject>(result.value()).value;
+    return result;
+  }
+  return statements.empty() ? ObjectResult(Object(Null())) : results.back();
+}
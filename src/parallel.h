@@ -0,0 +1,118 @@
+//
+// Parallel evaluation of independent top level statements.
+//
+
+#ifndef MONKE_CPP_PARALLEL_H
+#define MONKE_CPP_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "object.h"
+
+class ParallelConfig {
+  public:
+  bool enabled = false;
+  // 0 means one worker per hardware thread
+  size_t threads = 0;
+};
+
+class ParallelStats {
+  public:
+  // Groups of statements whose dependencies were all satisfied at the same time
+  uint64_t waves = 0;
+  // Statements handed to the pool rather than run on the evaluating thread
+  uint64_t parallel_statements = 0;
+  uint64_t steals = 0;
+};
+
+/*
+ * How one top level statement interacts with the others.
+ *
+ * Uses are every identifier the statement mentions, including inside function literals: a function bound at top level
+ * reads the global scope whenever it is called, so calling it uses everything its body uses. Reads are the ones looked
+ * up while the statement itself runs, which is all of them as soon as it calls anything.
+ */
+class StatementInfo {
+  public:
+  std::optional<std::string> defines = std::nullopt;
+  std::vector<std::string> uses;
+  std::vector<std::string> reads;
+  // Writes the global scope or may end the program while running, so it has to run on its own
+  bool serial = false;
+};
+
+StatementInfo analyze_statement(Statement &node);
+
+/**
+ * Order constraints between the statements of a program: deps[j] lists the earlier statements j has to wait for.
+ *
+ * Statement j waits for the statements binding the names it reads (directly or through functions it calls), for earlier
+ * bindings of the name it binds itself, and for everything before it if either of them is serial. A statement that binds
+ * a name an earlier one used unbound waits for that one too, so it still sees the name unbound. A statement that may call
+ * a builtin with effects is marked serial.
+ */
+std::vector<std::vector<size_t>> statement_dependencies(std::vector<StatementInfo> &infos);
+
+// Worker threads each own a deque, take work from its back and steal from the front of the others' when it runs dry
+class WorkStealingPool {
+  public:
+  explicit WorkStealingPool(size_t threads);
+  ~WorkStealingPool();
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  size_t size() { return workers.size(); }
+
+  // Run every task on the pool and return once all of them have finished
+  void run(std::vector<std::function<void()>> &tasks);
+
+  private:
+  class Queue {
+    public:
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  // Tasks submitted but not finished
+  size_t pending = 0;
+  // Bumped on every submission so sleeping workers can tell they have work
+  uint64_t epoch = 0;
+  bool stopping = false;
+  // Counted under mutex, added to the stats once a run is over
+  uint64_t steals = 0;
+
+  void work(size_t self);
+  std::optional<std::function<void()>> take(size_t self);
+};
+
+ParallelConfig &parallel_config();
+ParallelStats &parallel_stats();
+void reset_parallel_stats();
+
+// True on pool threads. The call site caches, JIT and memo tables of an isolate are single threaded, so calls there take the plain path
+bool in_parallel_worker();
+
+/**
+ * Evaluate a program like `evaluate`, running statements whose dependencies are satisfied concurrently.
+ *
+ * Statements run in waves. Within a wave the global scope is only read; values are bound in statement order once the
+ * wave is over. The result, including which error is reported, is the one sequential evaluation produces.
+ */
+ObjectResult evaluate_parallel(Program &node, std::shared_ptr<Environment> env);
+
+#endif//MONKE_CPP_PARALLEL_H
@@ -5,14 +5,20 @@
 
 #include <algorithm>
 
+#include "allocation.h"
 #include "ast.h"
+#include "counts.h"
 #include "token.h"
+#include "trace.h"
 #include <format>
 #include <functional>
 #include <optional>
 #include <variant>
 
 Parser::Parser(Lexer *l) : l(l) {
+  // The whole input is lexed up front
+  TraceScope trace("lex");
+  AllocationScope allocations(AllocationSite::Parse);
   auto t = l->next_token();
   while (t.has_value()) {
     tokens.push_back(t.value());
@@ -70,6 +76,7 @@ bool Parser::expect_peek(token_t t) {
 }
 
 std::optional<Statement> Parser::parse_statement() {
+  declare_counted_line(cur_token.line);
   switch (cur_token.ttype) {
     case ::LET:
       return parse_let_statement();
@@ -82,6 +89,7 @@ std::optional<Statement> Parser::parse_statement() {
 
 std::optional<Statement> Parser::parse_expression_statement() {
   ExpressionStatement stmt = ExpressionStatement();
+  stmt.token = cur_token;
   auto expr_opt = parse_expression(precedence::lowest);
   if (peek_token_is(token_t::SEMICOLON)) {
     next_token();
@@ -142,28 +150,47 @@ std::optional<Expression> Parser::parse_int_literal() {
 }
 
 std::optional<Expression> Parser::parse_array_literal() {
-  /*
-  std::vector<std::shared_ptr<Expression>> values;
+  Token t = cur_token;
+  std::vector<Expression *> elements;
+  if (peek_token_is(RBRACKET)) {
+    next_token();
+    return ArrayLiteral(t, elements);
+  }
 
-  // Move past bracket
   next_token();
+  auto element = parse_expression(precedence::lowest);
+  if (!element.has_value()) return std::nullopt;
+  elements.push_back(new Expression(element.value()));
 
-  if (peek_token_is(RBRACKET)) {
+  while (peek_token_is(COMMA)) {
+    next_token();
     next_token();
-    return ArrayLiteral(cur_token, values);
+    element = parse_expression(precedence::lowest);
+    if (!element.has_value()) return std::nullopt;
+    elements.push_back(new Expression(element.value()));
   }
 
-  while (peek_token_is(RBRACKET) == false) {
+  if (!expect_peek(RBRACKET)) return std::nullopt;
+
+  return ArrayLiteral(t, elements);
+}
+
+std::optional<Expression> Parser::parse_hash_literal() {
+  Token t = cur_token;
+  std::vector<std::pair<Expression *, Expression *>> pairs;
+  while (!peek_token_is(RBRACE)) {
+    next_token();
+    auto key = parse_expression(precedence::lowest);
+    if (!key.has_value()) return std::nullopt;
+    if (!expect_peek(COLON)) return std::nullopt;
+    next_token();
     auto value = parse_expression(precedence::lowest);
     if (!value.has_value()) return std::nullopt;
-    auto ptr = // TODO : Figure out how to do this correctly
-    values.push_back(value.value());
-    if (peek_token_is(RBRACKET)) break;
-    next_token();
-    if (!expect_peek(COMMA)) return std::nullopt;
+    pairs.emplace_back(new Expression(key.value()), new Expression(value.value()));
+    if (!peek_token_is(RBRACE) && !expect_peek(COMMA)) return std::nullopt;
   }
-  */
-  return std::nullopt;
+  next_token();
+  return HashLiteral(t, pairs);
 }
 
 std::optional<Expression> Parser::parse_float() {
@@ -354,8 +381,10 @@ std::optional<Expression> Parser::prefix_parse_fns(token_t t) {
       return parse_float();
     case ::FUNCTION:
       return parse_function_expression();
-    case ::RBRACKET:
+    case ::LBRACKET:
       return parse_array_literal();
+    case ::LBRACE:
+      return parse_hash_literal();
     default:
       errors.push_back(std::format("No prefix parse function for {} found", get_token_name(t)));
       return std::nullopt;
@@ -369,6 +398,15 @@ std::optional<Expression> Parser::parse_call_expression(Expression left) {
   return CallExpression(t, new Expression(left), args.value());
 }
 
+std::optional<Expression> Parser::parse_index_expression(Expression left) {
+  Token t = cur_token;
+  next_token();
+  auto index = parse_expression(precedence::lowest);
+  if (!index.has_value()) return std::nullopt;
+  if (!expect_peek(RBRACKET)) return std::nullopt;
+  return IndexExpression(t, new Expression(left), new Expression(index.value()));
+}
+
 std::optional<std::vector<Expression *>> Parser::parse_call_arguments() {
   std::vector<Expression *> args;
   if (peek_token_is(RPAREN)) {
@@ -411,6 +449,10 @@ std::optional<std::function<std::optional<Expression>(Expression)>> Parser::infi
       return [&](Expression e) -> std::optional<Expression> {
         return parse_call_expression(e);
       };
+    case ::LBRACKET:
+      return [&](Expression e) -> std::optional<Expression> {
+        return parse_index_expression(e);
+      };
     default:
       return std::nullopt;
   }
@@ -452,6 +494,8 @@ std::optional<Statement> Parser::parse_let_statement() {
 }
 
 Program Parser::parse_program() {
+  TraceScope trace("parse");
+  AllocationScope allocations(AllocationSite::Parse);
   Program *p = new Program();
   if (error.has_value()) {
     p->error = error;
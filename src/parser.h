@@ -49,6 +49,7 @@ public:
     std::optional<Expression> parse_char();
     std::optional<Expression> parse_float();
     std::optional<Expression> parse_array_literal();
+    std::optional<Expression> parse_hash_literal();
     std::optional<Expression> parse_int_literal();
     std::optional<Expression> parse_prefix_expression();
     std::optional<Expression> parse_grouped_expression();
@@ -57,6 +58,7 @@ public:
     std::optional<std::vector<Identifier*>> parse_function_parameters();
     std::optional<Expression> parse_infix_expression(Expression left);
     std::optional<Expression> parse_call_expression(Expression left);
+    std::optional<Expression> parse_index_expression(Expression left);
     std::optional<std::vector<Expression *>> parse_call_arguments();
     std::optional<std::function<std::optional<Expression>(Expression)>> infix_parse_fns(token_t t);
 
@@ -0,0 +1,93 @@
+//
+// A persistent map from HashKeys to values.
+//
+
+#include <bit>
+
+#include "persistent_map.h"
+
+namespace {
+  constexpr size_t HASH_BITS = 64;
+  constexpr size_t BITS = 5;
+  constexpr uint64_t MASK = (1 << BITS) - 1;
+}// namespace
+
+PersistentMap::PersistentMap(const HashTable &table) {
+  for (const auto &[key, value]: table.items()) insert(key, value);
+}
+
+const Object *PersistentMap::find(const HashKey &key) const {
+  auto index = find_index(key);
+  return index.has_value() ? &entries[index.value()].second : nullptr;
+}
+
+void PersistentMap::insert(const HashKey &key, Object value) {
+  auto existing = insert_index(root, key, key.hash(), static_cast<uint32_t>(entries.size()), 0);
+  if (existing.has_value()) {
+    entries.set_in_place(existing.value(), {key, std::move(value)});
+  } else {
+    entries.push_in_place({key, std::move(value)});
+  }
+}
+
+std::optional<uint32_t> PersistentMap::find_index(const HashKey &key) const {
+  auto hash = key.hash();
+  const Node *node = root.get();
+  for (size_t shift = 0; node != nullptr; shift += BITS) {
+    if (shift >= HASH_BITS) {
+      for (const auto &slot: node->slots) {
+        auto &entry = std::get<std::pair<HashKey, uint32_t>>(slot);
+        if (entry.first == key) return entry.second;
+      }
+      return std::nullopt;
+    }
+    uint32_t bit = uint32_t(1) << ((hash >> shift) & MASK);
+    if ((node->bitmap & bit) == 0) return std::nullopt;
+    auto &slot = node->slots[static_cast<size_t>(std::popcount(node->bitmap & (bit - 1)))];
+    if (auto *entry = std::get_if<std::pair<HashKey, uint32_t>>(&slot)) {
+      if (entry->first == key) return entry->second;
+      return std::nullopt;
+    }
+    node = std::get<std::shared_ptr<Node>>(slot).get();
+  }
+  return std::nullopt;
+}
+
+std::optional<uint32_t> PersistentMap::insert_index(std::shared_ptr<Node> &node, const HashKey &key, uint64_t hash, uint32_t index, size_t shift) {
+  // Copy the node unless this map is the only one holding it
+  if (node == nullptr) {
+    node = std::make_shared<Node>();
+  } else if (node.use_count() != 1) {
+    node = std::make_shared<Node>(*node);
+  }
+
+  if (shift >= HASH_BITS) {
+    for (auto &slot: node->slots) {
+      auto &entry = std::get<std::pair<HashKey, uint32_t>>(slot);
+      if (entry.first == key) return entry.second;
+    }
+    node->slots.emplace_back(std::pair(key, index));
+    return std::nullopt;
+  }
+
+  uint32_t bit = uint32_t(1) << ((hash >> shift) & MASK);
+  auto position = static_cast<size_t>(std::popcount(node->bitmap & (bit - 1)));
+  if ((node->bitmap & bit) == 0) {
+    node->bitmap |= bit;
+    node->slots.insert(node->slots.begin() + static_cast<ptrdiff_t>(position), std::pair(key, index));
+    return std::nullopt;
+  }
+
+  auto &slot = node->slots[position];
+  if (auto *child = std::get_if<std::shared_ptr<Node>>(&slot)) {
+    return insert_index(*child, key, hash, index, shift + BITS);
+  }
+  auto existing = std::get<std::pair<HashKey, uint32_t>>(slot);
+  if (existing.first == key) return existing.second;
+  // Both keys have the same bits up to here, so they move down into a new node together
+  std::shared_ptr<Node> child;
+  insert_index(child, existing.first, existing.first.hash(), existing.second, shift + BITS);
+  insert_index(child, key, hash, index, shift + BITS);
+  slot = std::move(child);
+  return std::nullopt;
+}
@@ -0,0 +1,56 @@
+//
+// A persistent map from HashKeys to values: a hash array mapped trie indexing a persistent vector of entries.
+//
+// The trie maps a key to the position of its entry and the entries stay in insertion order, like HashTable's, so both
+// representations of a Hash iterate the same way. Updates copy the O(log32 n) trie nodes and vector nodes on their path
+// and share the rest; nodes with a single holder are modified in place, see persistent_vector.h.
+//
+
+#ifndef MONKE_CPP_PERSISTENT_MAP_H
+#define MONKE_CPP_PERSISTENT_MAP_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "hash_table.h"
+#include "persistent_vector.h"
+
+class PersistentMap {
+  public:
+  PersistentMap() = default;
+  explicit PersistentMap(const HashTable &table);
+
+  size_t size() const { return entries.size(); }
+  // nullptr if key is absent
+  const Object *find(const HashKey &key) const;
+  // Add key, or replace its value
+  void insert(const HashKey &key, Object value);
+  // Every entry, in the order its key was first inserted
+  const PersistentVector<std::pair<HashKey, Object>> &items() const { return entries; }
+
+  private:
+  class Node;
+  // A key with the position of its entry, or a subtrie for the keys sharing this one's hash bits so far
+  typedef std::variant<std::pair<HashKey, uint32_t>, std::shared_ptr<Node>> Slot;
+  class Node {
+    public:
+    // Bit i is set when a slot holds the keys whose next five hash bits are i. Unused once the hash bits run out,
+    // where a node is a plain list of the keys whose hashes are equal
+    uint32_t bitmap = 0;
+    // One per set bit, in bit order
+    std::vector<Slot> slots;
+  };
+
+  std::shared_ptr<Node> root;
+  PersistentVector<std::pair<HashKey, Object>> entries;
+
+  std::optional<uint32_t> find_index(const HashKey &key) const;
+  // The position of key's entry if it was already there, otherwise index is recorded for it
+  static std::optional<uint32_t> insert_index(std::shared_ptr<Node> &node, const HashKey &key, uint64_t hash, uint32_t index, size_t shift);
+};
+
+#endif//MONKE_CPP_PERSISTENT_MAP_H
@@ -0,0 +1,154 @@
+//
+// A persistent vector: a 32-way trie of leaves plus a separate tail leaf, in the style of Clojure's PersistentVector.
+//
+// Updating a shared vector copies only the nodes on the path to the changed element, O(log32 n) of them, and shares
+// everything else with the previous version. Nodes are reference counted and a node with a single holder can only be
+// reached through the vector updating it, so the in place operations modify such nodes directly. A vector that is the
+// sole owner of its nodes (one being built, or one whose previous version is gone) therefore updates like a transient,
+// without copying anything, while an update through a copy never disturbs the original.
+//
+
+#ifndef MONKE_CPP_PERSISTENT_VECTOR_H
+#define MONKE_CPP_PERSISTENT_VECTOR_H
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+template<typename T>
+class PersistentVector {
+  public:
+  typedef T value_type;
+  static constexpr size_t BITS = 5;
+  static constexpr size_t WIDTH = size_t(1) << BITS;
+  static constexpr size_t MASK = WIDTH - 1;
+
+  PersistentVector() = default;
+
+  static PersistentVector from(std::span<const T> values) {
+    PersistentVector out;
+    for (const auto &value: values) out.push_in_place(value);
+    return out;
+  }
+
+  size_t size() const { return count; }
+
+  // i must be in range
+  const T &operator[](size_t i) const { return leaf_for(i).values[i & MASK]; }
+
+  PersistentVector push(T value) const {
+    auto out = *this;
+    out.push_in_place(std::move(value));
+    return out;
+  }
+
+  // i must be in range
+  PersistentVector set(size_t i, T value) const {
+    auto out = *this;
+    out.set_in_place(i, std::move(value));
+    return out;
+  }
+
+  void push_in_place(T value) {
+    if (count - tail_offset() < WIDTH) {
+      own(tail).values.push_back(std::move(value));
+      count++;
+      return;
+    }
+    // The tail is full, it moves into the trie and a new one starts
+    auto full = std::move(tail);
+    tail = std::make_shared<Node>();
+    tail->values.reserve(WIDTH);
+    tail->values.push_back(std::move(value));
+    if (root == nullptr) {
+      root = std::make_shared<Node>();
+      root->children.push_back(std::move(full));
+    } else if ((count >> BITS) > (size_t(1) << shift)) {
+      auto grown = std::make_shared<Node>();
+      grown->children.push_back(std::move(root));
+      grown->children.push_back(new_path(shift, std::move(full)));
+      root = std::move(grown);
+      shift += BITS;
+    } else {
+      push_tail(root, shift, std::move(full));
+    }
+    count++;
+  }
+
+  void set_in_place(size_t i, T value) {
+    if (i >= tail_offset()) {
+      own(tail).values[i - tail_offset()] = std::move(value);
+      return;
+    }
+    auto *node = &root;
+    for (size_t level = shift; level > 0; level -= BITS) {
+      node = &own(*node).children[(i >> level) & MASK];
+    }
+    own(*node).values[i & MASK] = std::move(value);
+  }
+
+  std::vector<T> to_vector() const {
+    std::vector<T> out;
+    out.reserve(count);
+    for (size_t i = 0; i < count; i += WIDTH) {
+      auto &values = leaf_for(i).values;
+      out.insert(out.end(), values.begin(), values.end());
+    }
+    return out;
+  }
+
+  private:
+  // A branch uses children, a leaf values
+  class Node {
+    public:
+    std::vector<std::shared_ptr<Node>> children;
+    std::vector<T> values;
+  };
+
+  size_t count = 0;
+  // Bits of an index consumed above the leaves
+  size_t shift = BITS;
+  // nullptr until the first tail is pushed into it
+  std::shared_ptr<Node> root;
+  std::shared_ptr<Node> tail = std::make_shared<Node>();
+
+  // Index of the first element in the tail
+  size_t tail_offset() const { return count < WIDTH ? 0 : ((count - 1) >> BITS) << BITS; }
+
+  const Node &leaf_for(size_t i) const {
+    if (i >= tail_offset()) return *tail;
+    const Node *node = root.get();
+    for (size_t level = shift; level > 0; level -= BITS) {
+      node = node->children[(i >> level) & MASK].get();
+    }
+    return *node;
+  }
+
+  // node itself if nothing else holds it, otherwise a copy now held in its place
+  static Node &own(std::shared_ptr<Node> &node) {
+    if (node.use_count() != 1) node = std::make_shared<Node>(*node);
+    return *node;
+  }
+
+  static std::shared_ptr<Node> new_path(size_t level, std::shared_ptr<Node> leaf) {
+    if (level == 0) return leaf;
+    auto node = std::make_shared<Node>();
+    node->children.push_back(new_path(level - BITS, std::move(leaf)));
+    return node;
+  }
+
+  void push_tail(std::shared_ptr<Node> &node, size_t level, std::shared_ptr<Node> leaf) {
+    auto &branch = own(node);
+    size_t sub = ((count - 1) >> level) & MASK;
+    if (level == BITS) {
+      branch.children.push_back(std::move(leaf));
+    } else if (sub < branch.children.size()) {
+      push_tail(branch.children[sub], level - BITS, std::move(leaf));
+    } else {
+      branch.children.push_back(new_path(level - BITS, std::move(leaf)));
+    }
+  }
+};
+
+#endif//MONKE_CPP_PERSISTENT_VECTOR_H
@@ -0,0 +1,148 @@
+//
+// Sampling profiler for Monke code.
+//
+
+#include <algorithm>
+#include <format>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <signal.h>
+#include <sys/time.h>
+
+#include "profiler.h"
+#include "utils.h"
+
+thread_local ShadowStack shadow_stack;
+std::atomic<bool> profiler_running = false;
+
+namespace {
+  // Samples back to back, each its depth plus one followed by its frames. Zero marks where the written samples end
+  std::vector<uintptr_t> buffer;
+  std::atomic<size_t> used = 0;
+  std::atomic<uint64_t> dropped = 0;
+  // Handlers between checking that the profiler runs and finishing their sample
+  std::atomic<int> sampling = 0;
+  uint64_t interval = 0;
+
+  void sample(int) {
+    sampling.fetch_add(1);
+    if (profiler_running.load()) {
+      size_t depth = std::min(shadow_stack.depth.load(std::memory_order_relaxed), PROFILER_MAX_DEPTH);
+      std::atomic_signal_fence(std::memory_order_acquire);
+      size_t start = used.fetch_add(depth + 1, std::memory_order_relaxed);
+      if (start + depth + 1 > buffer.size()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        buffer[start] = depth + 1;
+        for (size_t i = 0; i < depth; i++) buffer[start + 1 + i] = reinterpret_cast<uintptr_t>(shadow_stack.frames[i]);
+      }
+    }
+    sampling.fetch_sub(1);
+  }
+
+  itimerval timer_every(uint64_t microseconds) {
+    itimerval timer{};
+    timer.it_interval.tv_sec = static_cast<time_t>(microseconds / 1000000);
+    timer.it_interval.tv_usec = static_cast<suseconds_t>(microseconds % 1000000);
+    timer.it_value = timer.it_interval;
+    return timer;
+  }
+}// namespace
+
+ProfilerConfig &profiler_config() {
+  // The timer and its signal belong to the process, so there is one profiler for every isolate
+  static ProfilerConfig config;
+  return config;
+}
+
+bool start_profiler() {
+  auto &config = profiler_config();
+  if (profiler_running.load() || config.frequency == 0) return false;
+  buffer.assign(config.buffer_size, 0);
+  used = 0;
+  dropped = 0;
+  interval = std::max<uint64_t>(1000000 / config.frequency, 1);
+
+  // The handler stays installed once the profiler has run: a SIGPROF still pending after it stops would otherwise
+  // terminate the process
+  struct sigaction action {};
+  action.sa_handler = sample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr) != 0) return false;
+  profiler_running = true;
+  auto timer = timer_every(interval);
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    profiler_running = false;
+    return false;
+  }
+  return true;
+}
+
+Profile stop_profiler() {
+  Profile profile;
+  if (!profiler_running.load()) return profile;
+  auto off = timer_every(0);
+  setitimer(ITIMER_PROF, &off, nullptr);
+  profiler_running = false;
+  // Handlers that saw the profiler running may still be writing their sample on other threads
+  while (sampling.load() != 0) std::this_thread::yield();
+
+  profile.interval = interval;
+  profile.dropped = dropped.load();
+  size_t end = std::min(used.load(), buffer.size());
+  for (size_t at = 0; at < end && buffer[at] != 0; at += buffer[at]) {
+    std::vector<std::string> frames;
+    for (size_t i = 1; i < buffer[at]; i++) frames.push_back(*reinterpret_cast<const std::string *>(buffer[at + i]));
+    profile.stacks[frames.empty() ? PROFILER_TOP_LEVEL : str_join(frames, ";")]++;
+    profile.samples++;
+  }
+  buffer = std::vector<uintptr_t>();
+  return profile;
+}
+
+std::string folded_stacks(const Profile &profile) {
+  std::string out = "";
+  for (const auto &[stack, count]: profile.stacks) out += std::format("{} {}\n", stack, count);
+  return out;
+}
+
+std::string print_profile(const Profile &profile, size_t top) {
+  // Self counts the samples a function was the innermost frame of, total those it was anywhere in
+  std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> functions;
+  for (const auto &[stack, count]: profile.stacks) {
+    std::set<std::string> seen;
+    size_t start = 0;
+    while (true) {
+      auto end = stack.find(';', start);
+      auto name = stack.substr(start, end == std::string::npos ? std::string::npos : end - start);
+      if (seen.insert(name).second) functions[name].second += count;
+      if (end == std::string::npos) {
+        functions[name].first += count;
+        break;
+      }
+      start = end + 1;
+    }
+  }
+  std::vector<std::pair<std::string, std::pair<uint64_t, uint64_t>>> rows(functions.begin(), functions.end());
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+
+  auto milliseconds = [&](uint64_t samples) { return static_cast<double>(samples * profile.interval) / 1000.0; };
+  auto percent = [&](uint64_t samples) {
+    return profile.samples == 0 ? 0.0 : 100.0 * static_cast<double>(samples) / static_cast<double>(profile.samples);
+  };
+  std::string out = "";
+  out += std::format("profile: {} samples every {}us, {} dropped\n", profile.samples, profile.interval, profile.dropped);
+  out += std::format("{:>12} {:>7} {:>12} {:>7}  {}\n", "self ms", "self%", "total ms", "total%", "function");
+  for (size_t i = 0; i < std::min(top, rows.size()); i++) {
+    auto &[name, counts] = rows[i];
+    out += std::format("{:>12.1f} {:>6.1f}% {:>12.1f} {:>6.1f}%  {}\n", milliseconds(counts.first), percent(counts.first),
+                       milliseconds(counts.second), percent(counts.second), name);
+  }
+  return out;
+}
@@ -0,0 +1,97 @@
+//
+// Sampling profiler for Monke code.
+//
+// Calls push the callee's name on a per thread shadow stack. While the profiler runs, a SIGPROF timer interrupts the
+// process every interval of CPU time and the handler copies the interrupted thread's shadow stack into a preallocated
+// buffer. Nothing is aggregated until the profiler stops, so the handler never allocates or locks.
+//
+
+#ifndef MONKE_CPP_PROFILER_H
+#define MONKE_CPP_PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Samples per second of CPU time unless asked otherwise
+constexpr uint64_t PROFILER_DEFAULT_FREQUENCY = 1000;
+
+// Frames a sample keeps, counted from the outermost call. Deeper calls are attributed to the frame at this depth
+constexpr size_t PROFILER_MAX_DEPTH = 128;
+
+// Top level code is sampled under this name
+constexpr const char *PROFILER_TOP_LEVEL = "(top level)";
+
+class ProfilerConfig {
+  public:
+  uint64_t frequency = PROFILER_DEFAULT_FREQUENCY;
+  // Words of sample buffer, each sample takes its depth plus one. Samples that do not fit are counted as dropped
+  size_t buffer_size = size_t(1) << 21;
+};
+
+class Profile {
+  public:
+  // Collapsed stacks, outermost call first and separated by ';', to the number of samples that saw them
+  std::map<std::string, uint64_t> stacks;
+  uint64_t samples = 0;
+  uint64_t dropped = 0;
+  // Microseconds of CPU time each sample stands for
+  uint64_t interval = 0;
+};
+
+// The calls the current thread is in, innermost last
+class ShadowStack {
+  public:
+  std::array<const std::string *, PROFILER_MAX_DEPTH> frames;
+  // May exceed PROFILER_MAX_DEPTH, the frames past it are not recorded. Atomic so the signal handler reads a value the
+  // thread it interrupted has finished writing
+  std::atomic<size_t> depth = 0;
+};
+
+extern thread_local ShadowStack shadow_stack;
+extern std::atomic<bool> profiler_running;
+
+/*
+ * One call on the shadow stack, for as long as it is in scope.
+ *
+ * Free when the profiler is not running. name must outlive the profile, e.g. be interned.
+ */
+class ProfileFrame {
+  public:
+  explicit ProfileFrame(const std::string *name) : pushed(profiler_running.load(std::memory_order_relaxed)) {
+    if (!pushed) return;
+    auto depth = shadow_stack.depth.load(std::memory_order_relaxed);
+    if (depth < PROFILER_MAX_DEPTH) shadow_stack.frames[depth] = name;
+    std::atomic_signal_fence(std::memory_order_release);
+    shadow_stack.depth.store(depth + 1, std::memory_order_relaxed);
+  }
+  ~ProfileFrame() {
+    if (pushed) shadow_stack.depth.store(shadow_stack.depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+  }
+  ProfileFrame(const ProfileFrame &) = delete;
+  ProfileFrame &operator=(const ProfileFrame &) = delete;
+
+  private:
+  bool pushed;
+};
+
+ProfilerConfig &profiler_config();
+
+/**
+ * Start sampling every thread of the process at profiler_config().frequency
+ * @return false if the profiler is already running or the timer could not be set up
+ */
+bool start_profiler();
+
+// Stop sampling and gather what was collected since the start
+Profile stop_profiler();
+
+// The stacks in the collapsed format flamegraph.pl reads, one "frame;frame;frame count" line each
+std::string folded_stacks(const Profile &profile);
+
+// The top functions by samples spent in their own code, with the time spent in them and their callees
+std::string print_profile(const Profile &profile, size_t top = 20);
+
+#endif//MONKE_CPP_PROFILER_H
@@ -0,0 +1,98 @@
+//
+// Concatenation trees behind String values.
+//
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "rope.h"
+
+namespace {
+  // Guard the halves of concatenations, picked by address so that nodes need no mutex of their own
+  std::array<std::mutex, 64> halves_mutexes;
+
+  std::mutex &halves_mutex(const Rope *rope) {
+    return halves_mutexes[(reinterpret_cast<uintptr_t>(rope) >> 4) % halves_mutexes.size()];
+  }
+}// namespace
+
+Rope::Rope(std::string contents) : length(contents.size()), flattened(true), contents(std::move(contents)) {}
+
+Rope::Rope(std::shared_ptr<const Rope> left, std::shared_ptr<const Rope> right)
+    : length(left->size() + right->size()), left(std::move(left)), right(std::move(right)), flattened(false) {}
+
+Rope::~Rope() {
+  // Children only this node holds would be released recursively by their own destructors, and a rope built by
+  // appending one piece at a time is as deep as it is long. Take their children first so each dies with none left
+  std::vector<std::shared_ptr<const Rope>> pending;
+  pending.push_back(std::move(left));
+  pending.push_back(std::move(right));
+  while (!pending.empty()) {
+    auto node = std::move(pending.back());
+    pending.pop_back();
+    if (node == nullptr || node.use_count() != 1) continue;
+    // Ropes are always made by make_shared<Rope>, and nothing else can see this one
+    auto &owned = const_cast<Rope &>(*node);
+    pending.push_back(std::move(owned.left));
+    pending.push_back(std::move(owned.right));
+  }
+}
+
+std::shared_ptr<const Rope> Rope::concat(const std::shared_ptr<const Rope> &left, const std::shared_ptr<const Rope> &right) {
+  if (left->size() == 0) return right;
+  if (right->size() == 0) return left;
+  if (left->size() + right->size() < FLAT_LIMIT) return std::make_shared<Rope>(left->flat() + right->flat());
+  return std::make_shared<Rope>(left, right);
+}
+
+const std::string &Rope::flat() const {
+  if (!flattened.load(std::memory_order_acquire)) std::call_once(flattening, [this]() { flatten(); });
+  return contents;
+}
+
+size_t Rope::self_size() const {
+  size_t size = sizeof(Rope);
+  // Strings short enough to be stored in place allocate nothing
+  if (flattened.load(std::memory_order_acquire) && contents.capacity() > std::string().capacity()) size += contents.capacity() + 1;
+  return size;
+}
+
+void Rope::flatten() const {
+  std::string out;
+  out.reserve(length);
+  // Left to right, copying whole any subtree that is already flat. Another thread may flatten a node of it meanwhile
+  // and release that node's halves, so the nodes are held while they are walked
+  auto [first, second] = halves();
+  std::vector<std::shared_ptr<const Rope>> pending = {std::move(second), std::move(first)};
+  while (!pending.empty()) {
+    auto node = std::move(pending.back());
+    pending.pop_back();
+    if (!node->flattened.load(std::memory_order_acquire)) {
+      // Released only after the contents are published
+      auto [node_left, node_right] = node->halves();
+      if (node_left != nullptr) {
+        pending.push_back(std::move(node_right));
+        pending.push_back(std::move(node_left));
+        continue;
+      }
+    }
+    out += node->contents;
+  }
+  contents = std::move(out);
+  flattened.store(true, std::memory_order_release);
+
+  // Every character is in contents now. The halves are dropped outside the lock, as that may free a long chain
+  std::shared_ptr<const Rope> old_left;
+  std::shared_ptr<const Rope> old_right;
+  {
+    std::lock_guard lock(halves_mutex(this));
+    old_left.swap(left);
+    old_right.swap(right);
+  }
+}
+
+std::pair<std::shared_ptr<const Rope>, std::shared_ptr<const Rope>> Rope::halves() const {
+  std::lock_guard lock(halves_mutex(this));
+  return {left, right};
+}
@@ -0,0 +1,58 @@
+//
+// The contents of a String: a flat string, or the concatenation of two ropes.
+//
+// Concatenating two long ropes makes a node pointing at both instead of copying them, so building a string out of n
+// pieces is O(n) rather than O(n^2). A concatenation is flattened the first time its characters are needed and keeps
+// the result in place of its halves, which it releases: later flattening of ropes built on top of it copies that
+// instead of walking its subtree again, and a loop appending and reading holds one copy rather than one per prefix.
+// Nodes are otherwise immutable and may be shared between threads.
+//
+
+#ifndef MONKE_CPP_ROPE_H
+#define MONKE_CPP_ROPE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+class Rope {
+  public:
+  // Concatenations shorter than this are copied into one flat string rather than linked
+  static constexpr size_t FLAT_LIMIT = 64;
+
+  explicit Rope(std::string contents);
+  Rope(std::shared_ptr<const Rope> left, std::shared_ptr<const Rope> right);
+  // Releases a long chain of concatenations without recursing once per node
+  ~Rope();
+
+  static std::shared_ptr<const Rope> concat(const std::shared_ptr<const Rope> &left, const std::shared_ptr<const Rope> &right);
+
+  size_t size() const { return length; }
+  // The characters, flattening the rope on first use
+  const std::string &flat() const;
+
+  // For heap snapshots: the halves of a concatenation, nullptr once it is flat
+  std::shared_ptr<const Rope> left_half() const { return halves().first; }
+  std::shared_ptr<const Rope> right_half() const { return halves().second; }
+  // Bytes this node allocated, not counting its halves
+  size_t self_size() const;
+
+  private:
+  size_t length;
+  // nullptr for flat ropes. flatten releases them while other threads may be walking the rope, so they are read with
+  // halves()
+  mutable std::shared_ptr<const Rope> left;
+  mutable std::shared_ptr<const Rope> right;
+  // Set once contents holds every character; always set for flat ropes
+  mutable std::atomic<bool> flattened;
+  mutable std::once_flag flattening;
+  mutable std::string contents;
+
+  void flatten() const;
+  std::pair<std::shared_ptr<const Rope>, std::shared_ptr<const Rope>> halves() const;
+};
+
+#endif//MONKE_CPP_ROPE_H
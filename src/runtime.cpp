@@ -0,0 +1,65 @@
+//
+// Support library for C++ emitted by the transpiler (monke_cpp --emit-cpp).
+//
+
+#include <format>
+#include <iostream>
+
+#include "builtins.h"
+#include "hash_table.h"
+#include "runtime.h"
+
+ObjectResult monke_prefix(std::string op, Object right) {
+  return eval_prefix_expression(op, right, nullptr);
+}
+
+ObjectResult monke_infix(std::string op, Object left, Object right) {
+  return eval_infix_expression(op, left, right, nullptr);
+}
+
+ObjectResult monke_get(std::shared_ptr<Environment> &env, const std::string &name) {
+  if (auto *obj = env->find(name)) return *obj;
+  if (auto *builtin = find_builtin(name)) return *builtin;
+  return env->get(name);
+}
+
+ObjectResult monke_call(Object &callee, std::vector<Object> args) {
+  if (auto *builtin = std::get_if<Builtin>(&callee)) {
+    return call_builtin(*builtin, args);
+  }
+  auto *fn = std::get_if<NativeFunction>(&callee);
+  if (fn == nullptr) {
+    return std::unexpected(TypeError(std::format("not a function: {}", get_type_name(callee))));
+  }
+  if (fn->arity != args.size()) {
+    return std::unexpected(TypeError(std::format("wrong number of arguments: want={}, got={}", fn->arity, args.size())));
+  }
+  return fn->fn(args);
+}
+
+ObjectResult monke_hash(std::vector<std::pair<Object, Object>> pairs) {
+  HashTable table(pairs.size());
+  for (auto &[key_obj, value]: pairs) {
+    auto key = HashKey::of(key_obj);
+    if (!key.has_value()) return std::unexpected(unusable_key_error(key_obj));
+    table.insert(key.value(), std::move(value));
+  }
+  return Hash(std::move(table));
+}
+
+bool monke_is_return(Object &obj) {
+  return std::holds_alternative<ReturnObject>(obj);
+}
+
+int monke_run(std::vector<MonkeProgram> programs) {
+  for (auto program: programs) {
+    auto env = std::make_shared<Environment>(Environment());
+    auto out = program(env);
+    if (!out.has_value()) {
+      std::cout << get_msg(out.error()) << std::endl;
+    } else {
+      std::cout << inspect(out.value()) << std::endl;
+    }
+  }
+  return 0;
+}
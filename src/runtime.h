@@ -0,0 +1,42 @@
+//
+// Support library for C++ emitted by the transpiler (monke_cpp --emit-cpp).
+//
+// Generated code computes with the same Object and Environment types as the evaluator and defers to the
+// evaluator's operator implementations, so a transpiled program behaves exactly like `evaluate` on it.
+//
+
+#ifndef MONKE_CPP_RUNTIME_H
+#define MONKE_CPP_RUNTIME_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "eval.h"
+#include "object.h"
+
+// Evaluate the expression into a new Object called name, returning the error from the enclosing function if it failed.
+// Variadic so that lambdas with commas in their bodies can be passed as the expression
+#define MONKE_TRY(name, ...)                                                     \
+  auto name##_result = (__VA_ARGS__);                                            \
+  if (!name##_result.has_value()) return std::unexpected(name##_result.error()); \
+  Object name = std::move(name##_result.value());
+
+typedef ObjectResult (*MonkeProgram)(std::shared_ptr<Environment> env);
+
+ObjectResult monke_prefix(std::string op, Object right);
+ObjectResult monke_infix(std::string op, Object left, Object right);
+// Look up an identifier like the evaluator: bindings first, then builtins
+ObjectResult monke_get(std::shared_ptr<Environment> &env, const std::string &name);
+ObjectResult monke_call(Object &callee, std::vector<Object> args);
+// A hash literal from its evaluated keys and values, in source order
+ObjectResult monke_hash(std::vector<std::pair<Object, Object>> pairs);
+bool monke_is_return(Object &obj);
+
+/**
+ * Run each program in its own global environment and print its result the way `monke_cpp <file>` does
+ * @return process exit code
+ */
+int monke_run(std::vector<MonkeProgram> programs);
+
+#endif//MONKE_CPP_RUNTIME_H
@@ -0,0 +1,154 @@
+//
+// Repeated runs of one script in a single process.
+//
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <format>
+
+#include <sys/resource.h>
+
+#include "allocation.h"
+#include "compiled_program.h"
+#include "parser.h"
+#include "script_bench.h"
+#include "trace.h"
+
+namespace {
+  // Every number the JSON holds, in the order it is written
+  constexpr std::array<const char *, 13> JSON_KEYS = {
+          "runs", "wall_min_ns", "wall_median_ns", "wall_p99_ns", "lex_min_ns", "lex_median_ns", "lex_p99_ns",
+          "parse_min_ns", "parse_median_ns", "parse_p99_ns", "allocations", "allocated_bytes", "max_rss_kb",
+  };
+
+  // The fields for those keys, const or not as the result is
+  template <typename Result>
+  auto json_fields(Result &result) {
+    return std::array{&result.runs, &result.wall.min, &result.wall.median, &result.wall.p99, &result.lex.min, &result.lex.median,
+                      &result.lex.p99, &result.parse.min, &result.parse.median, &result.parse.p99, &result.allocations,
+                      &result.allocated_bytes, &result.max_rss};
+  }
+
+  std::string milliseconds(uint64_t nanoseconds) {
+    return std::format("{:.3f}", static_cast<double>(nanoseconds) / 1e6);
+  }
+
+  double change(uint64_t baseline, uint64_t current) {
+    if (baseline == 0) return 0.0;
+    return 100.0 * (static_cast<double>(current) - static_cast<double>(baseline)) / static_cast<double>(baseline);
+  }
+}// namespace
+
+Distribution Distribution::of(std::vector<uint64_t> samples) {
+  Distribution out;
+  if (samples.empty()) return out;
+  std::sort(samples.begin(), samples.end());
+  out.min = samples.front();
+  out.median = samples[samples.size() / 2];
+  // The smallest sample at least 99% of them are no larger than
+  out.p99 = samples[(samples.size() * 99 + 99) / 100 - 1];
+  return out;
+}
+
+std::expected<ScriptBenchResult, Error> bench_script(const std::string &source, const ScriptBenchOptions &options) {
+  auto compiled = CompiledProgram::compile(source);
+  if (!compiled.has_value()) return std::unexpected(compiled.error());
+  auto &program = compiled.value();
+
+  std::vector<uint64_t> wall, lex, parse;
+  for (size_t i = 0; i < options.warmup + options.runs; i++) {
+    auto start = trace_clock();
+    Lexer l(source);
+    Parser p(&l);
+    auto lexed = trace_clock();
+    Program front_end = p.parse_program();
+    auto parsed = trace_clock();
+    delete_nodes(front_end);
+
+    auto evaluating = trace_clock();
+    auto result = program->evaluate(std::make_shared<Environment>(Environment()));
+    auto evaluated = trace_clock();
+    if (!result.has_value()) return std::unexpected(result.error());
+    if (i < options.warmup) continue;
+    lex.push_back(lexed - start);
+    parse.push_back(parsed - lexed);
+    wall.push_back(evaluated - evaluating);
+  }
+
+  ScriptBenchResult out;
+  out.runs = options.runs;
+  out.wall = Distribution::of(std::move(wall));
+  out.lex = Distribution::of(std::move(lex));
+  out.parse = Distribution::of(std::move(parse));
+
+  start_allocation_tracking();
+  program->evaluate(std::make_shared<Environment>(Environment()));
+  auto allocations = stop_allocation_tracking();
+  for (auto &site: allocations.sites) {
+    out.allocations += site.count;
+    out.allocated_bytes += site.bytes;
+  }
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  out.max_rss = static_cast<uint64_t>(usage.ru_maxrss);
+  return out;
+}
+
+std::string print_script_bench(const ScriptBenchResult &result) {
+  std::string out = "";
+  out += std::format("{} runs\n", result.runs);
+  out += std::format("{:>8} {:>12} {:>12} {:>12}\n", "ms", "min", "median", "p99");
+  for (auto [name, distribution]: {std::pair{"eval", &result.wall}, {"lex", &result.lex}, {"parse", &result.parse}}) {
+    out += std::format("{:>8} {:>12} {:>12} {:>12}\n", name, milliseconds(distribution->min), milliseconds(distribution->median),
+                       milliseconds(distribution->p99));
+  }
+  out += std::format("allocations per run: {} totalling {} bytes\n", result.allocations, result.allocated_bytes);
+  out += std::format("peak RSS: {} KB\n", result.max_rss);
+  return out;
+}
+
+std::string script_bench_json(const ScriptBenchResult &result) {
+  auto fields = json_fields(result);
+  std::string out = "{";
+  for (size_t i = 0; i < JSON_KEYS.size(); i++) {
+    out += std::format("{}\"{}\": {}", i == 0 ? "" : ", ", JSON_KEYS[i], *fields[i]);
+  }
+  out += "}\n";
+  return out;
+}
+
+std::optional<ScriptBenchResult> parse_script_bench_json(std::string_view json) {
+  ScriptBenchResult result;
+  auto fields = json_fields(result);
+  auto read = [&](std::string_view key, uint64_t &value) {
+    auto at = json.find(std::format("\"{}\": ", key));
+    if (at == std::string_view::npos) return false;
+    auto start = json.data() + at + key.size() + 4;
+    return std::from_chars(start, json.data() + json.size(), value).ec == std::errc();
+  };
+  for (size_t i = 0; i < JSON_KEYS.size(); i++) {
+    if (!read(JSON_KEYS[i], *fields[i])) return std::nullopt;
+  }
+  return result;
+}
+
+std::pair<std::string, bool> compare_script_bench(const ScriptBenchResult &baseline, const ScriptBenchResult &result, double threshold) {
+  bool regressed = false;
+  std::string out = std::format("{:>20} {:>14} {:>14} {:>9}\n", "", "baseline", "current", "change");
+  auto row = [&](std::string_view name, std::string before, std::string after, double percent, bool checked) {
+    bool over = checked && percent > threshold;
+    regressed |= over;
+    out += std::format("{:>20} {:>14} {:>14} {:>+8.1f}%{}\n", name, before, after, percent, over ? "  regression" : "");
+  };
+  row("eval median ms", milliseconds(baseline.wall.median), milliseconds(result.wall.median), change(baseline.wall.median, result.wall.median), true);
+  row("eval p99 ms", milliseconds(baseline.wall.p99), milliseconds(result.wall.p99), change(baseline.wall.p99, result.wall.p99), false);
+  row("lex median ms", milliseconds(baseline.lex.median), milliseconds(result.lex.median), change(baseline.lex.median, result.lex.median), false);
+  row("parse median ms", milliseconds(baseline.parse.median), milliseconds(result.parse.median), change(baseline.parse.median, result.parse.median), false);
+  row("allocations", std::to_string(baseline.allocations), std::to_string(result.allocations), change(baseline.allocations, result.allocations), false);
+  row("allocated bytes", std::to_string(baseline.allocated_bytes), std::to_string(result.allocated_bytes),
+      change(baseline.allocated_bytes, result.allocated_bytes), true);
+  row("peak RSS KB", std::to_string(baseline.max_rss), std::to_string(result.max_rss), change(baseline.max_rss, result.max_rss), false);
+  return {out, regressed};
+}
@@ -0,0 +1,70 @@
+//
+// Repeated runs of one script in a single process, for `monke_cpp bench`.
+//
+// The script is parsed once and its program evaluated warmup times, so caches and compiled functions settle, then
+// runs more times in a fresh global scope each. Every run also lexes and parses the source again to time the front
+// end; that tree is thrown away.
+//
+
+#ifndef MONKE_CPP_SCRIPT_BENCH_H
+#define MONKE_CPP_SCRIPT_BENCH_H
+
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "object.h"
+
+class ScriptBenchOptions {
+  public:
+  size_t warmup = 3;
+  size_t runs = 20;
+};
+
+// Nanoseconds
+class Distribution {
+  public:
+  uint64_t min = 0;
+  uint64_t median = 0;
+  uint64_t p99 = 0;
+
+  static Distribution of(std::vector<uint64_t> samples);
+};
+
+class ScriptBenchResult {
+  public:
+  uint64_t runs = 0;
+  // Evaluating the parsed program
+  Distribution wall;
+  Distribution lex;
+  Distribution parse;
+  // Made by one more evaluation after the timed ones, with allocation tracking on
+  uint64_t allocations = 0;
+  uint64_t allocated_bytes = 0;
+  // Kilobytes, as getrusage reports it
+  uint64_t max_rss = 0;
+};
+
+/**
+ * Benchmark source as described above
+ * @return the first parse or evaluation error
+ */
+std::expected<ScriptBenchResult, Error> bench_script(const std::string &source, const ScriptBenchOptions &options);
+
+std::string print_script_bench(const ScriptBenchResult &result);
+
+// One flat JSON object, which parse_script_bench_json reads back
+std::string script_bench_json(const ScriptBenchResult &result);
+std::optional<ScriptBenchResult> parse_script_bench_json(std::string_view json);
+
+/**
+ * Compare a result against a saved baseline
+ * @param threshold percent the median wall time or the allocated bytes may grow by
+ * @return a table of both results, and whether either grew by more than threshold
+ */
+std::pair<std::string, bool> compare_script_bench(const ScriptBenchResult &baseline, const ScriptBenchResult &result, double threshold);
+
+#endif//MONKE_CPP_SCRIPT_BENCH_H
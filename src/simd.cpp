@@ -0,0 +1,41 @@
+//
+// Runtime selection of the vectorized kernels.
+//
+
+#include "simd.h"
+
+SimdLevel supported_simd_level() {
+  static const SimdLevel level = []() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (avx2_simd_kernels() != nullptr && __builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (sse_simd_kernels() != nullptr && __builtin_cpu_supports("sse4.2")) return SimdLevel::SSE;
+#endif
+    return SimdLevel::Scalar;
+  }();
+  return level;
+}
+
+const SimdKernels &simd_kernels() {
+  static const SimdKernels &kernels = simd_kernels(supported_simd_level());
+  return kernels;
+}
+
+const SimdKernels &simd_kernels(SimdLevel level) {
+  auto supported = supported_simd_level();
+  if (level >= SimdLevel::AVX2 && supported >= SimdLevel::AVX2) return *avx2_simd_kernels();
+  if (level >= SimdLevel::SSE && supported >= SimdLevel::SSE) return *sse_simd_kernels();
+  return *scalar_simd_kernels();
+}
+
+const char *simd_level_name(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::Scalar:
+      return "scalar";
+    case SimdLevel::SSE:
+      return "sse4.2";
+    case SimdLevel::AVX2:
+      return "avx2";
+  }
+  return "unknown";
+}
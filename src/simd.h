@@ -0,0 +1,65 @@
+//
+// Vectorized kernels over packed int64 and double data, picked at runtime for the CPU we run on.
+//
+// Each instruction set has its own translation unit built with the matching -m flag, so nothing outside those files
+// uses instructions the CPU may lack. They only include this header and the intrinsics, keeping inline library code
+// compiled for a wider ISA from being shared with the rest of the program.
+//
+
+#ifndef MONKE_CPP_SIMD_H
+#define MONKE_CPP_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class SimdLevel {
+  Scalar,
+  // SSE4.2, two lanes
+  SSE,
+  // AVX2, four lanes
+  AVX2
+};
+
+/*
+ * The kernels for one element type. Integer arithmetic wraps around like two's complement hardware does. Floating point
+ * reductions add lanes in a different order than a sequential loop, so their results may differ in the last bits.
+ */
+template<typename T>
+class SimdOps {
+  public:
+  T (*sum)(const T *a, size_t n);
+  T (*dot)(const T *a, const T *b, size_t n);
+  // n must be at least 1
+  T (*min)(const T *a, size_t n);
+  T (*max)(const T *a, size_t n);
+  void (*add)(const T *a, const T *b, T *out, size_t n);
+  void (*add_scalar)(const T *a, T b, T *out, size_t n);
+  void (*mul)(const T *a, const T *b, T *out, size_t n);
+  void (*mul_scalar)(const T *a, T b, T *out, size_t n);
+  void (*clamp)(const T *a, T lo, T hi, T *out, size_t n);
+};
+
+class SimdKernels {
+  public:
+  SimdLevel level;
+  SimdOps<int64_t> i64;
+  SimdOps<double> f64;
+};
+
+// The widest level this build has kernels for and the CPU supports
+SimdLevel supported_simd_level();
+
+// Kernels for the supported level, detected once
+const SimdKernels &simd_kernels();
+
+// Kernels for a specific level, or the widest supported one below it
+const SimdKernels &simd_kernels(SimdLevel level);
+
+const char *simd_level_name(SimdLevel level);
+
+// Defined by each level's translation unit, nullptr where the build has no kernels for it
+const SimdKernels *scalar_simd_kernels();
+const SimdKernels *sse_simd_kernels();
+const SimdKernels *avx2_simd_kernels();
+
+#endif//MONKE_CPP_SIMD_H
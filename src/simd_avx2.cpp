@@ -0,0 +1,59 @@
+//
+// AVX2 kernels, four 64-bit lanes. Built with -mavx2 and only called once the CPU is known to support it.
+//
+
+#include "simd.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace {
+  class I64 {
+    public:
+    typedef int64_t T;
+    typedef __m256i R;
+    static constexpr size_t width = 4;
+    static R load(const T *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    static void store(T *p, R v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    static R set1(T v) { return _mm256_set1_epi64x(v); }
+    static R add(R a, R b) { return _mm256_add_epi64(a, b); }
+    // There is no 64-bit multiply before AVX-512, build it from 32-bit halves: lo*lo + ((hi*lo + lo*hi) << 32)
+    static R mul(R a, R b) {
+      R low = _mm256_mul_epu32(a, b);
+      R cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+      return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+    }
+    static R min(R a, R b) { return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b)); }
+    static R max(R a, R b) { return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b)); }
+  };
+
+  class F64 {
+    public:
+    typedef double T;
+    typedef __m256d R;
+    static constexpr size_t width = 4;
+    static R load(const T *p) { return _mm256_loadu_pd(p); }
+    static void store(T *p, R v) { _mm256_storeu_pd(p, v); }
+    static R set1(T v) { return _mm256_set1_pd(v); }
+    static R add(R a, R b) { return _mm256_add_pd(a, b); }
+    static R mul(R a, R b) { return _mm256_mul_pd(a, b); }
+    // The instructions return their second operand when either is NaN, min1 and max1 their first
+    static R min(R a, R b) { return _mm256_min_pd(b, a); }
+    static R max(R a, R b) { return _mm256_max_pd(b, a); }
+  };
+}// namespace
+
+#include "simd_kernels.h"
+
+namespace {
+  constexpr SimdKernels AVX2 = make_kernels<I64, F64>(SimdLevel::AVX2);
+}// namespace
+
+const SimdKernels *avx2_simd_kernels() {
+  return &AVX2;
+}
+#else
+const SimdKernels *avx2_simd_kernels() {
+  return nullptr;
+}
+#endif
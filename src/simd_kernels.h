@@ -0,0 +1,162 @@
+//
+// The kernels of simd.h written once over a lane type, included by each instruction set's translation unit.
+//
+// A lane type V provides T (the element), R (a register of them), width, load, store, set1, add, mul, min and max.
+// Everything here has internal linkage so every includer gets its own copy, compiled for its own instruction set.
+//
+
+#ifndef MONKE_CPP_SIMD_KERNELS_H
+#define MONKE_CPP_SIMD_KERNELS_H
+
+#include <type_traits>
+
+#include "simd.h"
+
+namespace {
+  // Plain integer arithmetic overflows into undefined behaviour, the vector instructions wrap
+  template<typename T>
+  T add1(T a, T b) {
+    if constexpr (std::is_integral_v<T>) {
+      return static_cast<T>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+    } else {
+      return a + b;
+    }
+  }
+
+  template<typename T>
+  T mul1(T a, T b) {
+    if constexpr (std::is_integral_v<T>) {
+      return static_cast<T>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+    } else {
+      return a * b;
+    }
+  }
+
+  template<typename T>
+  T min1(T a, T b) { return b < a ? b : a; }
+
+  template<typename T>
+  T max1(T a, T b) { return a < b ? b : a; }
+
+  // Two independent accumulators so consecutive adds do not wait on each other
+  template<typename V>
+  typename V::T sum(const typename V::T *a, size_t n) {
+    using T = typename V::T;
+    auto acc0 = V::set1(0);
+    auto acc1 = V::set1(0);
+    size_t i = 0;
+    for (; i + 2 * V::width <= n; i += 2 * V::width) {
+      acc0 = V::add(acc0, V::load(a + i));
+      acc1 = V::add(acc1, V::load(a + i + V::width));
+    }
+    for (; i + V::width <= n; i += V::width) {
+      acc0 = V::add(acc0, V::load(a + i));
+    }
+    T lanes[V::width];
+    V::store(lanes, V::add(acc0, acc1));
+    T total = 0;
+    for (size_t j = 0; j < V::width; j++) total = add1(total, lanes[j]);
+    for (; i < n; i++) total = add1(total, a[i]);
+    return total;
+  }
+
+  template<typename V>
+  typename V::T dot(const typename V::T *a, const typename V::T *b, size_t n) {
+    using T = typename V::T;
+    auto acc0 = V::set1(0);
+    auto acc1 = V::set1(0);
+    size_t i = 0;
+    for (; i + 2 * V::width <= n; i += 2 * V::width) {
+      acc0 = V::add(acc0, V::mul(V::load(a + i), V::load(b + i)));
+      acc1 = V::add(acc1, V::mul(V::load(a + i + V::width), V::load(b + i + V::width)));
+    }
+    for (; i + V::width <= n; i += V::width) {
+      acc0 = V::add(acc0, V::mul(V::load(a + i), V::load(b + i)));
+    }
+    T lanes[V::width];
+    V::store(lanes, V::add(acc0, acc1));
+    T total = 0;
+    for (size_t j = 0; j < V::width; j++) total = add1(total, lanes[j]);
+    for (; i < n; i++) total = add1(total, mul1(a[i], b[i]));
+    return total;
+  }
+
+  // min1 and max1 keep their first operand when either is NaN, so a scan from a[0] gives NaN exactly when a[0] is NaN
+  // and skips every other NaN. Every lane starts from a[0] so the vector loop does the same, whatever lane a NaN is in
+  template<typename V, bool Max>
+  typename V::T extremum(const typename V::T *a, size_t n) {
+    using T = typename V::T;
+    auto pick = [](T x, T y) { return Max ? max1(x, y) : min1(x, y); };
+    T best = a[0];
+    size_t i = 0;
+    if (n >= V::width) {
+      auto acc = V::set1(a[0]);
+      for (i = 0; i + V::width <= n; i += V::width) {
+        acc = Max ? V::max(acc, V::load(a + i)) : V::min(acc, V::load(a + i));
+      }
+      T lanes[V::width];
+      V::store(lanes, acc);
+      best = lanes[0];
+      for (size_t j = 1; j < V::width; j++) best = pick(best, lanes[j]);
+    }
+    for (; i < n; i++) best = pick(best, a[i]);
+    return best;
+  }
+
+  template<typename V>
+  typename V::T min(const typename V::T *a, size_t n) { return extremum<V, false>(a, n); }
+
+  template<typename V>
+  typename V::T max(const typename V::T *a, size_t n) { return extremum<V, true>(a, n); }
+
+  template<typename V>
+  void add(const typename V::T *a, const typename V::T *b, typename V::T *out, size_t n) {
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) V::store(out + i, V::add(V::load(a + i), V::load(b + i)));
+    for (; i < n; i++) out[i] = add1(a[i], b[i]);
+  }
+
+  template<typename V>
+  void add_scalar(const typename V::T *a, typename V::T b, typename V::T *out, size_t n) {
+    auto broadcast = V::set1(b);
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) V::store(out + i, V::add(V::load(a + i), broadcast));
+    for (; i < n; i++) out[i] = add1(a[i], b);
+  }
+
+  template<typename V>
+  void mul(const typename V::T *a, const typename V::T *b, typename V::T *out, size_t n) {
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) V::store(out + i, V::mul(V::load(a + i), V::load(b + i)));
+    for (; i < n; i++) out[i] = mul1(a[i], b[i]);
+  }
+
+  template<typename V>
+  void mul_scalar(const typename V::T *a, typename V::T b, typename V::T *out, size_t n) {
+    auto broadcast = V::set1(b);
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) V::store(out + i, V::mul(V::load(a + i), broadcast));
+    for (; i < n; i++) out[i] = mul1(a[i], b);
+  }
+
+  template<typename V>
+  void clamp(const typename V::T *a, typename V::T lo, typename V::T hi, typename V::T *out, size_t n) {
+    auto low = V::set1(lo);
+    auto high = V::set1(hi);
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width) V::store(out + i, V::min(V::max(V::load(a + i), low), high));
+    for (; i < n; i++) out[i] = min1(max1(a[i], lo), hi);
+  }
+
+  template<typename V>
+  constexpr SimdOps<typename V::T> ops() {
+    return {sum<V>, dot<V>, min<V>, max<V>, add<V>, add_scalar<V>, mul<V>, mul_scalar<V>, clamp<V>};
+  }
+
+  template<typename I64, typename F64>
+  constexpr SimdKernels make_kernels(SimdLevel level) {
+    return {level, ops<I64>(), ops<F64>()};
+  }
+}// namespace
+
+#endif//MONKE_CPP_SIMD_KERNELS_H
@@ -0,0 +1,29 @@
+//
+// Portable kernels, used where no wider instruction set is available.
+//
+
+#include "simd.h"
+#include "simd_kernels.h"
+
+namespace {
+  template<typename Element>
+  class Lane {
+    public:
+    typedef Element T;
+    typedef Element R;
+    static constexpr size_t width = 1;
+    static R load(const T *p) { return *p; }
+    static void store(T *p, R v) { *p = v; }
+    static R set1(T v) { return v; }
+    static R add(R a, R b) { return add1(a, b); }
+    static R mul(R a, R b) { return mul1(a, b); }
+    static R min(R a, R b) { return min1(a, b); }
+    static R max(R a, R b) { return max1(a, b); }
+  };
+
+  constexpr SimdKernels SCALAR = make_kernels<Lane<int64_t>, Lane<double>>(SimdLevel::Scalar);
+}// namespace
+
+const SimdKernels *scalar_simd_kernels() {
+  return &SCALAR;
+}
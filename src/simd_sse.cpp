@@ -0,0 +1,59 @@
+//
+// SSE4.2 kernels, two 64-bit lanes. Built with -msse4.2 and only called once the CPU is known to support it.
+//
+
+#include "simd.h"
+
+#ifdef __SSE4_2__
+#include <immintrin.h>
+
+namespace {
+  class I64 {
+    public:
+    typedef int64_t T;
+    typedef __m128i R;
+    static constexpr size_t width = 2;
+    static R load(const T *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+    static void store(T *p, R v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+    static R set1(T v) { return _mm_set1_epi64x(v); }
+    static R add(R a, R b) { return _mm_add_epi64(a, b); }
+    // There is no 64-bit multiply, build it from 32-bit halves: lo*lo + ((hi*lo + lo*hi) << 32)
+    static R mul(R a, R b) {
+      R low = _mm_mul_epu32(a, b);
+      R cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b), _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+      return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+    }
+    static R min(R a, R b) { return _mm_blendv_epi8(a, b, _mm_cmpgt_epi64(a, b)); }
+    static R max(R a, R b) { return _mm_blendv_epi8(b, a, _mm_cmpgt_epi64(a, b)); }
+  };
+
+  class F64 {
+    public:
+    typedef double T;
+    typedef __m128d R;
+    static constexpr size_t width = 2;
+    static R load(const T *p) { return _mm_loadu_pd(p); }
+    static void store(T *p, R v) { _mm_storeu_pd(p, v); }
+    static R set1(T v) { return _mm_set1_pd(v); }
+    static R add(R a, R b) { return _mm_add_pd(a, b); }
+    static R mul(R a, R b) { return _mm_mul_pd(a, b); }
+    // The instructions return their second operand when either is NaN, min1 and max1 their first
+    static R min(R a, R b) { return _mm_min_pd(b, a); }
+    static R max(R a, R b) { return _mm_max_pd(b, a); }
+  };
+}// namespace
+
+#include "simd_kernels.h"
+
+namespace {
+  constexpr SimdKernels SSE = make_kernels<I64, F64>(SimdLevel::SSE);
+}// namespace
+
+const SimdKernels *sse_simd_kernels() {
+  return &SSE;
+}
+#else
+const SimdKernels *sse_simd_kernels() {
+  return nullptr;
+}
+#endif
@@ -55,6 +55,8 @@ std::string get_token_name(token_t t) {
       return "COMMA";
     case SEMICOLON:
       return "SEMICOLON";
+    case COLON:
+      return "COLON";
     case LPAREN:
       return "LPAREN";
     case RPAREN:
@@ -5,6 +5,7 @@
 #ifndef MONKE_CPP_TOKEN_H
 #define MONKE_CPP_TOKEN_H
 
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 
@@ -34,6 +35,7 @@ enum token_t {
   // Delimiters
   COMMA,
   SEMICOLON,
+  COLON,
 
   LBRACKET,
   RBRACKET,
@@ -56,6 +58,8 @@ class Token {
   public:
   token_t ttype;
   std::string literal;
+  // Line of the input the token starts on, counted from 1. Zero for tokens that were not lexed
+  uint32_t line = 0;
 
   /**
      * Default token constructor
@@ -0,0 +1,140 @@
+//
+// Timeline tracing of interpreter phases and Monke calls.
+//
+
+#include <algorithm>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+#include "trace.h"
+
+std::atomic<uint32_t> trace_categories = 0;
+
+namespace {
+  std::mutex buffers_mutex;
+  // Buffers of running threads
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  // Buffers of threads that have exited, handed to the next thread that records. So there are only ever as many as
+  // threads ran at once
+  std::vector<std::unique_ptr<TraceBuffer>> free_buffers;
+  // Events of threads that have exited, kept until the trace is exported, with their thread
+  std::vector<std::pair<uint32_t, TraceEvent>> retired;
+  uint32_t next_thread = 1;
+
+  // Keeps the events of a buffer, oldest first. Needs buffers_mutex
+  void collect(TraceBuffer &buffer, std::vector<std::pair<uint32_t, TraceEvent>> &out) {
+    auto written = buffer.written.load(std::memory_order_acquire);
+    for (auto i = written - std::min<uint64_t>(written, TRACE_BUFFER_EVENTS); i < written; i++) {
+      out.emplace_back(buffer.thread, buffer.events[i % TRACE_BUFFER_EVENTS]);
+    }
+  }
+
+  // Flushes the thread's events and frees its buffer for another thread when the thread exits
+  class ThreadBuffer {
+    public:
+    TraceBuffer *buffer = nullptr;
+
+    ~ThreadBuffer() {
+      if (buffer == nullptr) return;
+      std::lock_guard lock(buffers_mutex);
+      // Once the trace is stopped, its events have been exported already
+      if (trace_categories.load(std::memory_order_relaxed) != 0) collect(*buffer, retired);
+      auto it = std::find_if(buffers.begin(), buffers.end(), [&](auto &b) { return b.get() == buffer; });
+      free_buffers.push_back(std::move(*it));
+      buffers.erase(it);
+    }
+  };
+  thread_local ThreadBuffer thread_buffer;
+
+  TraceBuffer &buffer_for_thread() {
+    if (thread_buffer.buffer == nullptr) {
+      std::lock_guard lock(buffers_mutex);
+      if (free_buffers.empty()) {
+        buffers.push_back(std::make_unique<TraceBuffer>());
+      } else {
+        buffers.push_back(std::move(free_buffers.back()));
+        free_buffers.pop_back();
+      }
+      buffers.back()->thread = next_thread++;
+      buffers.back()->written = 0;
+      thread_buffer.buffer = buffers.back().get();
+    }
+    return *thread_buffer.buffer;
+  }
+
+  std::string json_string(std::string_view s) {
+    std::string out = "\"";
+    for (char c: s) {
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        out += std::format("\\u{:04x}", c);
+      } else {
+        out += c;
+      }
+    }
+    return out + "\"";
+  }
+
+  const char *category_name(TraceCategory category) {
+    switch (category) {
+      case TraceCategory::Phase:
+        return "phase";
+      case TraceCategory::Call:
+        return "call";
+    }
+    return "";
+  }
+}// namespace
+
+uint64_t trace_clock() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+void record_trace_event(const TraceEvent &event) {
+  auto &buffer = buffer_for_thread();
+  auto written = buffer.written.load(std::memory_order_relaxed);
+  buffer.events[written % TRACE_BUFFER_EVENTS] = event;
+  buffer.written.store(written + 1, std::memory_order_release);
+}
+
+void start_tracing(bool calls) {
+  {
+    std::lock_guard lock(buffers_mutex);
+    for (auto &buffer: buffers) buffer->written = 0;
+    retired.clear();
+  }
+  uint32_t categories = static_cast<uint32_t>(TraceCategory::Phase);
+  if (calls) categories |= static_cast<uint32_t>(TraceCategory::Call);
+  trace_categories = categories;
+}
+
+std::string stop_tracing() {
+  trace_categories = 0;
+  std::vector<std::pair<uint32_t, TraceEvent>> events;
+  {
+    std::lock_guard lock(buffers_mutex);
+    events = retired;
+    for (auto &buffer: buffers) collect(*buffer, events);
+  }
+  uint64_t origin = UINT64_MAX;
+  for (auto &[thread, event]: events) origin = std::min(origin, event.start);
+
+  // Timestamps in microseconds from the first event
+  auto pid = static_cast<int>(getpid());
+  std::string out = "{\"traceEvents\": [\n";
+  for (size_t i = 0; i < events.size(); i++) {
+    auto &[thread, event] = events[i];
+    out += std::format("{{\"name\": {}, \"cat\": \"{}\", \"ph\": \"X\", \"ts\": {:.3f}, \"dur\": {:.3f}, \"pid\": {}, \"tid\": {}}}{}\n",
+                       json_string(event.name), category_name(event.category), static_cast<double>(event.start - origin) / 1000.0,
+                       static_cast<double>(event.duration) / 1000.0, pid, thread, i + 1 < events.size() ? "," : "");
+  }
+  out += "], \"displayTimeUnit\": \"ns\"}\n";
+  return out;
+}
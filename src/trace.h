@@ -0,0 +1,78 @@
+//
+// Timeline tracing of interpreter phases and Monke calls, exported as Chrome trace events.
+//
+// A TraceScope records one complete event, its start and duration, when it goes out of scope. Each thread appends its
+// events to its own ring buffer, so recording takes no locks; a full buffer overwrites its oldest events. The JSON can
+// be loaded in Perfetto or chrome://tracing.
+//
+
+#ifndef MONKE_CPP_TRACE_H
+#define MONKE_CPP_TRACE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Events each thread keeps
+constexpr size_t TRACE_BUFFER_EVENTS = size_t(1) << 16;
+
+enum class TraceCategory : uint32_t {
+  // Reading, lexing, parsing and evaluating a program
+  Phase = 1,
+  // Every call of a Monke function or builtin
+  Call = 2
+};
+
+class TraceEvent {
+  public:
+  // Must outlive the trace: a literal or an interned string
+  std::string_view name;
+  TraceCategory category;
+  // Nanoseconds on the steady clock
+  uint64_t start;
+  uint64_t duration;
+};
+
+// The events of one thread. Only that thread writes, readers must wait until it is done
+class TraceBuffer {
+  public:
+  uint32_t thread;
+  std::array<TraceEvent, TRACE_BUFFER_EVENTS> events;
+  // Events ever written; the newest TRACE_BUFFER_EVENTS of them are still here
+  std::atomic<uint64_t> written = 0;
+};
+
+// Bit mask of the TraceCategory values being recorded
+extern std::atomic<uint32_t> trace_categories;
+
+uint64_t trace_clock();
+void record_trace_event(const TraceEvent &event);
+
+// Records the time from its construction to its destruction. A single branch when its category is not traced
+class TraceScope {
+  public:
+  explicit TraceScope(std::string_view name, TraceCategory category = TraceCategory::Phase) : name(name), category(category) {
+    if (trace_categories.load(std::memory_order_relaxed) & static_cast<uint32_t>(category)) start = trace_clock();
+  }
+  ~TraceScope() {
+    if (start != 0) record_trace_event({name, category, start, trace_clock() - start});
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+  std::string_view name;
+  TraceCategory category;
+  uint64_t start = 0;
+};
+
+// Clear every buffer and start recording phases, and calls too if asked
+void start_tracing(bool calls);
+
+// Stop recording and return what the buffers hold in the Chrome trace event JSON format
+std::string stop_tracing();
+
+#endif//MONKE_CPP_TRACE_H
@@ -0,0 +1,275 @@
+//
+// Ahead of time translation of Monke programs to C++.
+//
+// The generated code mirrors the evaluator node for node: every expression becomes an Object local, errors return
+// from the enclosing C++ function, blocks in expression position run in lambdas so that a ReturnObject ends only the
+// block, and bindings still go through Environment so shadowing and late binding behave exactly as in `evaluate`.
+// What goes away is the AST walk itself and the per block statement copies.
+//
+
+#include <format>
+
+#include "transpiler.h"
+
+namespace {
+  // Octal escapes keep the literal unambiguous whatever character follows
+  std::string cpp_string(const std::string &value) {
+    std::string out = "\"";
+    for (unsigned char c: value) {
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += static_cast<char>(c);
+      } else if (c < 0x20 || c >= 0x7F) {
+        out += std::format("\\{:03o}", c);
+      } else {
+        out += static_cast<char>(c);
+      }
+    }
+    return out + "\"";
+  }
+
+  class Transpiler {
+    public:
+    std::string out;
+    size_t indent = 1;
+    size_t names = 0;
+    // C++ variable holding the current Environment
+    std::string env;
+    std::optional<Error> error = std::nullopt;
+
+    std::string fresh(const std::string &prefix) {
+      return std::format("{}{}", prefix, names++);
+    }
+
+    void line(const std::string &text) {
+      out += std::string(2 * indent, ' ') + text + "\n";
+    }
+
+    void program(Program &node, size_t index) {
+      env = fresh("env");
+      auto result = fresh("r");
+      out += std::format("ObjectResult monke_program_{}([[maybe_unused]] std::shared_ptr<Environment> {}) {{\n", index, env);
+      line(std::format("auto {} = [&]() -> ObjectResult {{", result));
+      indent++;
+      body(node.statements);
+      indent--;
+      line("}();");
+      line(std::format("return unwrap_return_value({});", result));
+      out += "}\n\n";
+    }
+
+    // Statements of a block. The enclosing C++ function returns the block's value like eval(BlockStatement)
+    void body(std::vector<Statement> &statements) {
+      auto result = fresh("r");
+      line(std::format("ObjectResult {} = Object(Null());", result));
+      for (auto &stmt: statements) {
+        statement(stmt, result);
+      }
+      line(std::format("return {};", result));
+    }
+
+    // A block in expression position runs in a lambda so that a return inside it only ends the block
+    std::string nested(BlockStatement &node) {
+      auto value = fresh("t");
+      auto statements = node.get_statements();
+      line(std::format("MONKE_TRY({}, [&]() -> ObjectResult {{", value));
+      indent++;
+      body(statements);
+      indent--;
+      line("}());");
+      return value;
+    }
+
+    void statement(Statement &node, const std::string &result) {
+      std::visit(overloads{
+                         [&](LetStatement &let) {
+                           auto value = expression(let.value);
+                           line(std::format("{}->set({}, {});", env, cpp_string(let.name.string()), value));
+                           line(std::format("{} = Object(Null());", result));
+                         },
+                         [&](ReturnStatement &ret) {
+                           auto value = expression(ret.return_value);
+                           line(std::format("return Object(ReturnObject(new Object({})));", value));
+                         },
+                         [&](ExpressionStatement &e) {
+                           auto value = expression(e.e);
+                           line(std::format("{} = {};", result, value));
+                           line(std::format("if (monke_is_return({})) return {};", value, result));
+                         },
+                         [&](BlockStatement &b) {
+                           auto value = nested(b);
+                           line(std::format("{} = {};", result, value));
+                           line(std::format("if (monke_is_return({})) return {};", value, result));
+                         },
+                 },
+                 node);
+    }
+
+    // Emit code computing node into a new Object local and return the local's name
+    std::string expression(Expression &node) {
+      return std::visit(overloads{
+                                [&](IntegerLiteral &i) {
+                                  auto value = fresh("t");
+                                  line(std::format("Object {} = Integer(static_cast<int64_t>({}ULL));", value, static_cast<uint64_t>(i.val)));
+                                  return value;
+                                },
+                                [&](FloatLiteral &f) {
+                                  auto value = fresh("t");
+                                  line(std::format("Object {} = Float(0x{:a});", value, f.val));
+                                  return value;
+                                },
+                                [&](StringLiteral &s) {
+                                  auto value = fresh("t");
+                                  line(std::format("Object {} = String(std::string({}, {}));", value, cpp_string(s.value), s.value.size()));
+                                  return value;
+                                },
+                                [&](CharLiteral &c) {
+                                  auto value = fresh("t");
+                                  line(std::format("Object {} = Char(static_cast<char>({}));", value, static_cast<int>(c.value)));
+                                  return value;
+                                },
+                                [&](BooleanLiteral &b) {
+                                  auto value = fresh("t");
+                                  line(std::format("Object {} = Boolean({});", value, b.value ? "true" : "false"));
+                                  return value;
+                                },
+                                [&](Identifier &i) {
+                                  auto value = fresh("t");
+                                  line(std::format("MONKE_TRY({}, monke_get({}, {}));", value, env, cpp_string(i.string())));
+                                  return value;
+                                },
+                                [&](PrefixExpression &p) {
+                                  auto right = expression(*p.right);
+                                  auto value = fresh("t");
+                                  line(std::format("MONKE_TRY({}, monke_prefix({}, {}));", value, cpp_string(p.op), right));
+                                  return value;
+                                },
+                                [&](InfixExpression &i) {
+                                  auto left = expression(*i.left);
+                                  auto right = expression(*i.right);
+                                  auto value = fresh("t");
+                                  line(std::format("MONKE_TRY({}, monke_infix({}, {}, {}));", value, cpp_string(i.op), left, right));
+                                  return value;
+                                },
+                                [&](ArrayLiteral &a) {
+                                  std::vector<std::string> elements;
+                                  for (auto *element: a.elements) {
+                                    elements.push_back(expression(*element));
+                                  }
+                                  auto value = fresh("t");
+                                  line(std::format("Object {} = Array::from({{{}}});", value, str_join(elements, ", ")));
+                                  return value;
+                                },
+                                [&](HashLiteral &h) {
+                                  std::vector<std::string> pairs;
+                                  for (auto &[key, value]: h.pairs) {
+                                    auto k = expression(*key);
+                                    pairs.push_back(std::format("{{{}, {}}}", k, expression(*value)));
+                                  }
+                                  auto value = fresh("t");
+                                  line(std::format("MONKE_TRY({}, monke_hash({{{}}}));", value, str_join(pairs, ", ")));
+                                  return value;
+                                },
+                                [&](IndexExpression &i) {
+                                  auto left = expression(*i.left);
+                                  auto index = expression(*i.index);
+                                  auto value = fresh("t");
+                                  line(std::format("MONKE_TRY({}, eval_index_expression({}, {}));", value, left, index));
+                                  return value;
+                                },
+                                [&](IfExpression &i) { return if_expression(i); },
+                                [&](FunctionLiteral &f) { return function(f); },
+                                [&](CallExpression &c) {
+                                  auto callee = expression(*c.function);
+                                  std::vector<std::string> args;
+                                  for (auto *arg: c.arguments) {
+                                    args.push_back(expression(*arg));
+                                  }
+                                  auto value = fresh("t");
+                                  line(std::format("MONKE_TRY({}, monke_call({}, {{{}}}));", value, callee, str_join(args, ", ")));
+                                  return value;
+                                },
+                                [&](auto &) {
+                                  error = TypeError("transpiler: unsupported expression");
+                                  return std::string("Object(Null())");
+                                },
+                        },
+                        node);
+    }
+
+    std::string if_expression(IfExpression &node) {
+      // The condition's errors are swallowed by eval(IfExpression), so they must not return from here
+      auto condition = fresh("c");
+      line(std::format("ObjectResult {} = [&]() -> ObjectResult {{", condition));
+      indent++;
+      line(std::format("return {};", expression(*node.condition)));
+      indent--;
+      line("}();");
+
+      auto value = fresh("t");
+      line(std::format("Object {} = Null();", value));
+      line(std::format("if ({}.has_value() && is_truthy({}.value())) {{", condition, condition));
+      indent++;
+      line(std::format("{} = {};", value, nested(*node.consequence)));
+      indent--;
+      if (node.alternative.has_value()) {
+        line("} else {");
+        indent++;
+        line(std::format("{} = {};", value, nested(*node.alternative.value())));
+        indent--;
+      }
+      line("}");
+      return value;
+    }
+
+    std::string function(FunctionLiteral &node) {
+      auto value = fresh("t");
+      auto outer = env;
+      auto inner = fresh("env");
+      auto result = fresh("r");
+      line(std::format("Object {} = NativeFunction({}, [{}]([[maybe_unused]] std::vector<Object> &args) -> ObjectResult {{", value, node.parameters.size(), outer));
+      indent++;
+      line(std::format("auto {} = enclose_env({});", inner, outer));
+      for (size_t i = 0; i < node.parameters.size(); i++) {
+        line(std::format("{}->set({}, args[{}]);", inner, cpp_string(node.parameters[i]->string()), i));
+      }
+      env = inner;
+      line(std::format("auto {} = [&]() -> ObjectResult {{", result));
+      indent++;
+      auto statements = node.body->get_statements();
+      body(statements);
+      indent--;
+      line("}();");
+      line(std::format("return unwrap_return_value({});", result));
+      env = outer;
+      indent--;
+      line("});");
+      return value;
+    }
+  };
+}// namespace
+
+std::expected<std::string, Error> transpile(std::vector<Program> &programs, std::vector<std::string> &sources) {
+  Transpiler t;
+  for (size_t i = 0; i < programs.size(); i++) {
+    t.program(programs[i], i);
+    if (t.error.has_value()) return std::unexpected(t.error.value());
+  }
+
+  std::vector<std::string> entries;
+  for (size_t i = 0; i < programs.size(); i++) {
+    entries.push_back(std::format("MONKE_NAMESPACE::monke_program_{}", i));
+  }
+
+  std::string out = "";
+  out += std::format("// Generated by monke_cpp --emit-cpp from {}. Do not edit.\n", str_join(sources, ", "));
+  out += "#include \"runtime.h\"\n\n";
+  out += "#ifndef MONKE_NAMESPACE\n#define MONKE_NAMESPACE monke_generated\n#endif\n\n";
+  out += "namespace MONKE_NAMESPACE {\n\n";
+  out += t.out;
+  out += "}// namespace MONKE_NAMESPACE\n\n";
+  out += "#ifndef MONKE_NO_MAIN\n";
+  out += std::format("int main() {{\n  return monke_run({{{}}});\n}}\n", str_join(entries, ", "));
+  out += "#endif\n";
+  return out;
+}
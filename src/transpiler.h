@@ -0,0 +1,24 @@
+//
+// Ahead of time translation of Monke programs to C++.
+//
+
+#ifndef MONKE_CPP_TRANSPILER_H
+#define MONKE_CPP_TRANSPILER_H
+
+#include <expected>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "object.h"
+
+/**
+ * Translate parsed programs into a single standalone C++ translation unit built against runtime.h.
+ *
+ * Program i becomes `ObjectResult MONKE_NAMESPACE::monke_program_i(std::shared_ptr<Environment>)`. Unless MONKE_NO_MAIN
+ * is defined the unit also gets a main that runs every program in order and prints its result like `monke_cpp <file>`.
+ * @param sources file names, only used for the header comment
+ */
+std::expected<std::string, Error> transpile(std::vector<Program> &programs, std::vector<std::string> &sources);
+
+#endif//MONKE_CPP_TRANSPILER_H
@@ -5,10 +5,12 @@
 #include <fstream>
 #include <sstream>
 
+#include "trace.h"
 #include "utils.h"
 
 
 std::string read_file(std::string filename){
+  TraceScope trace("read_file");
   std::ifstream file(filename);
   if (!file.is_open()) {
     return "Error: Unable to open file";
@@ -0,0 +1,58 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "allocation.h"
+#include "jit.h"
+#include "profiler.h"
+
+namespace {
+    size_t count(const AllocationReport &report, AllocationSite site) {
+        return report.sites[static_cast<size_t>(site)].count;
+    }
+}// namespace
+
+TEST(Allocation, SiteTest) {
+    std::string program = "let f = fn(x) { return x + 1; }; f(1) + f(2) + f(3);";
+    // Compiled functions do not create environments
+    auto jit = jit_config().enabled;
+    jit_config().enabled = false;
+    start_allocation_tracking();
+    ASSERT_EQ(eval_program(program).value(), Object(Integer(9)));
+    auto report = stop_allocation_tracking();
+    jit_config().enabled = jit;
+
+    ASSERT_GT(count(report, AllocationSite::Parse), 0);
+    // The program's scope and one per call
+    ASSERT_GE(count(report, AllocationSite::Environment), 4);
+    ASSERT_GE(count(report, AllocationSite::ReturnValue), 3);
+    ASSERT_GE(count(report, AllocationSite::Closure), 1);
+    ASSERT_GE(count(report, AllocationSite::Binding), 4);
+    ASSERT_TRUE(report.functions.contains("f"));
+    ASSERT_GE(report.functions.at("f").count, 3);
+    ASSERT_TRUE(report.functions.contains(PROFILER_TOP_LEVEL));
+
+    auto printed = print_allocation_report(report);
+    ASSERT_NE(printed.find("  return value\n"), std::string::npos) << printed;
+    ASSERT_NE(printed.find("  f\n"), std::string::npos) << printed;
+}
+
+TEST(Allocation, PeakTest) {
+    start_allocation_tracking();
+    {
+        AllocationScope allocations(AllocationSite::Collection);
+        std::vector<char> large(1 << 20);
+        std::vector<char> small(1 << 10);
+    }
+    // Nothing outside a scope, or after tracking stops, is counted against a site
+    std::vector<char> other(1 << 10);
+    auto report = stop_allocation_tracking();
+    std::vector<char> untracked(1 << 20);
+
+    auto &collection = report.sites[static_cast<size_t>(AllocationSite::Collection)];
+    ASSERT_EQ(collection.count, 2);
+    ASSERT_EQ(collection.bytes, (1 << 20) + (1 << 10));
+    ASSERT_EQ(collection.peak, (1 << 20) + (1 << 10));
+    ASSERT_EQ(collection.live, 0);
+    ASSERT_GE(report.peak, (1 << 20) + (1 << 10));
+    ASSERT_GE(count(report, AllocationSite::Other), 1);
+}
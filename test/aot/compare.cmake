@@ -0,0 +1,14 @@
+# Run each case through the interpreter, then the transpiled binary, and require identical output
+set(expected "")
+foreach(case ${CASES})
+    execute_process(COMMAND ${MONKE} ${case} OUTPUT_VARIABLE out)
+    string(APPEND expected "${out}")
+endforeach()
+
+execute_process(COMMAND ${NATIVE} OUTPUT_VARIABLE actual RESULT_VARIABLE status)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${NATIVE} exited with ${status}")
+endif()
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "Transpiled output differs\n--- interpreter\n${expected}--- native\n${actual}")
+endif()
@@ -0,0 +1,91 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+TEST(Array, LiteralTest) {
+    auto ints = eval_program("[1, 2 * 2, 3 + 3];");
+    ASSERT_TRUE(ints.has_value());
+    ASSERT_EQ(ints.value(), Object(Array(std::vector<int64_t>({1, 4, 6}))));
+
+    auto empty = eval_program("[];");
+    ASSERT_TRUE(empty.has_value());
+    ASSERT_EQ(std::get<Array>(empty.value()).size(), 0);
+
+    auto error = eval_program("[1, -true];");
+    ASSERT_FALSE(error.has_value());
+    ASSERT_EQ(get_msg(error.error()), "unknown operator: -BooleanLiteral");
+}
+
+TEST(Array, RepresentationTest) {
+    auto storage = [](std::string input) -> size_t {
+        auto evaluated = eval_program(input);
+        return std::get<Array>(evaluated.value()).elements->index();
+    };
+    // int64, double, boxed
+    ASSERT_EQ(storage("[1, 2, 3];"), 0);
+    ASSERT_EQ(storage("[1.5, 2.5];"), 1);
+    ASSERT_EQ(storage("[1, 2.5];"), 2);
+    ASSERT_EQ(storage("[\"a\", 'b'];"), 2);
+    ASSERT_EQ(storage("push([1, 2], 3);"), 0);
+    ASSERT_EQ(storage("push([], 0.5);"), 1);
+    ASSERT_EQ(storage("push([1, 2], true);"), 2);
+    ASSERT_EQ(storage("slice([1.0, 2.0, 3.0], 0, 2);"), 1);
+}
+
+TEST(Array, IndexTest) {
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"[1, 2, 3][0];", Integer(1)},
+        {"[1, 2, 3][1 + 1];", Integer(3)},
+        {"let i = 0; [1][i];", Integer(1)},
+        {"let a = [1.5, 2.5]; a[0] + a[1];", Float(4.0)},
+        {"let a = [1, \"two\", 'c']; a[1];", String("two")},
+        {"[[1, 2], [3, 4]][1][0];", Integer(3)},
+        {"\"monke\"[1];", Char('o')},
+        {"let sum = fn(a, i) { if (i < len(a)) { a[i] + sum(a, i + 1) } else { 0 } }; sum([1, 2, 3, 4], 0);", Integer(10)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+
+    for (auto input: {"[1, 2, 3][3];", "[1, 2, 3][-1];", "\"\"[0];"}) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_TRUE(std::holds_alternative<Null>(evaluated.value())) << input;
+    }
+
+    auto error = eval_program("[1][true];");
+    ASSERT_FALSE(error.has_value());
+    ASSERT_EQ(get_msg(error.error()), "index operator not supported: Array[BooleanLiteral]");
+}
+
+TEST(Array, BuiltinsTest) {
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"len([1, 2, 3]);", Integer(3)},
+        {"len([]);", Integer(0)},
+        {"let a = [1, 2]; let b = push(a, 3); len(a) + len(b);", Integer(5)},
+        {"push([1, 2], 3)[2];", Integer(3)},
+        {"slice([1, 2, 3, 4], 1, 3);", Array(std::vector<int64_t>({2, 3}))},
+        {"slice([1, 2, 3], 2, 10);", Array(std::vector<int64_t>({3}))},
+        {"len(slice([1, 2, 3], 3, 1));", Integer(0)},
+        {"push([1], 2.5);", Array(std::vector<Object>({Integer(1), Float(2.5)}))},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+
+    auto error = eval_program("push(1, 2);");
+    ASSERT_FALSE(error.has_value());
+    ASSERT_EQ(get_msg(error.error()), "argument to `push` not supported, got Integer");
+}
+
+TEST(Array, SharedElementsTest) {
+    Array a = Array(std::vector<int64_t>({1, 2, 3}));
+    Object copy = a;
+    // Copies share the elements rather than duplicating them
+    ASSERT_EQ(std::get<Array>(copy).elements.get(), a.elements.get());
+    ASSERT_EQ(a.push(Integer(4)).size(), 4);
+    ASSERT_EQ(a.size(), 3);
+}
@@ -0,0 +1,153 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "builtins.h"
+#include "inline_cache.h"
+#include "isolate.h"
+#include "jit.h"
+#include "memo.h"
+#include "parallel.h"
+
+TEST(Builtins, ResultsTest) {
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"len(\"hello\");", Integer(5)},
+        {"len(\"\");", Integer(0)},
+        {"abs(-4) + abs(4);", Integer(8)},
+        {"abs(-1.5);", Float(1.5)},
+        {"min(3, 8) + max(3, 8);", Integer(11)},
+        {"max(1, 2.5);", Float(2.5)},
+        {"sqrt(16);", Float(4.0)},
+        {"pow(3, 4);", Integer(81)},
+        {"pow(4.0, 0.5);", Float(2.0)},
+        {"pow(1, 9223372036854775807);", Integer(1)},
+        {"pow(-2, 63);", Integer(INT64_MIN)},
+        {"pow(0, 0);", Integer(1)},
+        {"floor(2.7) + ceil(2.2);", Integer(5)},
+        {"str(42) + str(true) + str(\"!\");", String("42true!")},
+        {"upper(\"monke\") + lower(\"CPP\");", String("MONKEcpp")},
+        {"trim(\"  padded \");", String("padded")},
+        {"substr(\"interpreter\", 5, 3);", String("pre")},
+        {"substr(\"abc\", 2, 10);", String("c")},
+        {"contains(\"monke\", \"onk\");", Boolean(true)},
+        {"contains(\"monke\", 'z');", Boolean(false)},
+        {"let count = fn(s) { len(trim(s)) }; count(\" ab \");", Integer(2)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+}
+
+TEST(Builtins, ErrorsTest) {
+    std::vector<std::tuple<std::string, std::string> > tests = {
+        {"len(1);", "argument to `len` not supported, got Integer"},
+        {"len(\"a\", \"b\");", "wrong number of arguments: want=1, got=2"},
+        {"sqrt(\"x\");", "argument to `sqrt` not supported, got String"},
+        {"substr(\"abc\", -1, 2);", "substr out of range: start=-1, count=2"},
+        {"pow(2, 63);", "integer overflow in `pow`"},
+        {"pow(-3, 41);", "integer overflow in `pow`"},
+        {"floor(pow(10.0, 400.0));", "floor out of range: inf"},
+        {"ceil(-pow(10.0, 19.0));", "ceil out of range: -1e+19"},
+    };
+    for (const auto &[input, message]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_FALSE(evaluated.has_value()) << input;
+        ASSERT_EQ(get_msg(evaluated.error()), message);
+    }
+}
+
+TEST(Builtins, PutsTest) {
+    testing::internal::CaptureStdout();
+    auto evaluated = eval_program("puts(\"hi\", 1, 2.5, true); puts();");
+    auto out = testing::internal::GetCapturedStdout();
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value().index(), Object(Null()).index());
+    ASSERT_EQ(out, "hi\n1\n2.5\ntrue\n");
+}
+
+TEST(Builtins, ShadowingTest) {
+    auto evaluated = eval_program(R""""(
+        let measure = fn(s) { len(s) };
+        let before = measure("abc");
+        let len = fn(s) { 100 };
+        before + measure("abc") + len("abc");
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    // The call site cached the builtin, then the global binding replaced it
+    ASSERT_EQ(evaluated.value(), Object(Integer(3 + 100 + 100)));
+
+    auto parameter = eval_program("let f = fn(len) { len + 1 }; f(1);");
+    ASSERT_TRUE(parameter.has_value());
+    ASSERT_EQ(parameter.value(), Object(Integer(2)));
+}
+
+TEST(Builtins, CachedResolutionTest) {
+    jit_config().enabled = false;
+    reset_inline_cache_stats();
+    auto evaluated = eval_program("let f = fn(i) { if (i < 1) { 0 } else { abs(i) + f(i - 1) } }; f(50);");
+    jit_config() = JitConfig();
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(1275)));
+    // The abs site resolves once and then hits until the recursion unwinds
+    ASSERT_GE(inline_cache_stats().resolution_hits, 49 * 2);
+}
+
+TEST(Builtins, HostDefinedTest) {
+    Isolate isolate;
+    isolate.builtins.define("twice", 1, true, [](std::span<Object> args) -> ObjectResult {
+        auto *i = std::get_if<Integer>(&args[0]);
+        if (i == nullptr) return std::unexpected(TypeError("twice wants an Integer"));
+        return Integer(i->value * 2);
+    });
+    auto evaluated = isolate.run("let f = fn(x) { twice(x) + 1 }; f(20);");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(41)));
+
+    // Other isolates do not see it
+    Isolate other;
+    ASSERT_FALSE(other.run("twice(1);").has_value());
+
+    auto fn = isolate.lookup("twice");
+    ASSERT_TRUE(fn.has_value());
+    auto called = isolate.call(fn.value(), {Integer(4)});
+    ASSERT_TRUE(called.has_value());
+    ASSERT_EQ(called.value(), Object(Integer(8)));
+}
+
+TEST(Builtins, MemoizedTest) {
+    memo_config().enabled = true;
+    jit_config().enabled = false;
+    reset_memo_stats();
+    auto pure = eval_program("let f = fn(s) { len(s) * 2 }; f(\"ab\") + f(\"ab\");");
+    auto hits = memo_stats().hits;
+    testing::internal::CaptureStdout();
+    auto impure = eval_program("let g = fn(s) { puts(s); 1 }; g(\"x\") + g(\"x\");");
+    auto out = testing::internal::GetCapturedStdout();
+    memo_config() = MemoConfig();
+    jit_config() = JitConfig();
+
+    ASSERT_EQ(pure.value(), Object(Integer(8)));
+    ASSERT_EQ(hits, 1);
+    ASSERT_EQ(impure.value(), Object(Integer(2)));
+    ASSERT_EQ(out, "x\nx\n");
+}
+
+TEST(Builtins, ParallelOrderTest) {
+    auto analyze = [](std::string input) {
+        auto *l = new Lexer(input);
+        Parser p = Parser(l);
+        Program program = p.parse_program();
+        std::vector<StatementInfo> infos;
+        for (auto &stmt: program.statements) {
+            infos.push_back(analyze_statement(stmt));
+        }
+        return infos;
+    };
+    auto infos = analyze("let a = len(\"x\"); let b = len(\"yy\"); puts(a); let say = fn(s) { puts(s) }; say(b);");
+    auto deps = statement_dependencies(infos);
+    ASSERT_TRUE(deps[1].empty());
+    ASSERT_TRUE(infos[2].serial);
+    ASSERT_FALSE(infos[3].serial);
+    ASSERT_TRUE(infos[4].serial);
+}
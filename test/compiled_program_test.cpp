@@ -0,0 +1,125 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <format>
+#include <thread>
+
+#include "compiled_program.h"
+#include "isolate.h"
+
+TEST(CompiledProgram, CompileErrorTest) {
+    auto compiled = CompiledProgram::compile("let c = 'ab';");
+    ASSERT_FALSE(compiled.has_value());
+}
+
+TEST(CompiledProgram, EnvironmentsTest) {
+    auto compiled = CompiledProgram::compile("let y = x * 2; y + 1;");
+    ASSERT_TRUE(compiled.has_value());
+    auto &program = compiled.value();
+    for (int64_t x = 0; x < 5; x++) {
+        auto env = std::make_shared<Environment>(Environment());
+        env->set("x", Integer(x));
+        auto evaluated = program->evaluate(env);
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_EQ(evaluated.value(), Object(Integer(2 * x + 1)));
+    }
+}
+
+TEST(CompiledProgram, SharedAcrossThreadsTest) {
+    auto compiled = CompiledProgram::compile(R""""(
+        let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) };
+        let add = fn(x, y) { x + y };
+        add(fib(n), n);
+    )"""");
+    ASSERT_TRUE(compiled.has_value());
+    std::shared_ptr<const CompiledProgram> program = compiled.value();
+
+    constexpr size_t threads = 8;
+    std::vector<std::thread> workers;
+    std::vector<size_t> failures(threads, 0);
+    std::vector<uint64_t> compiled_functions(threads, 0);
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            IsolateConfig config;
+            config.jit.threshold = 10;
+            Isolate isolate(config);
+            IsolateScope scope(isolate);
+            for (int64_t n = 0; n < 15; n++) {
+                auto env = std::make_shared<Environment>(Environment());
+                env->set("n", Integer(n));
+                std::vector<int64_t> fib = {0, 1, 1, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144, 233, 377};
+                auto result = program->evaluate(env);
+                if (!result.has_value() || result.value() != Object(Integer(fib[n] + n))) failures[t]++;
+            }
+            compiled_functions[t] = isolate.jit_stats.compiled;
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    ASSERT_EQ(failures, std::vector<size_t>(threads, 0));
+    // Isolates that do not own the call sites still tier up through their own caches
+    for (auto compiled: compiled_functions) {
+        ASSERT_GT(compiled, 0);
+    }
+}
+
+TEST(CompiledProgram, LifetimeTest) {
+    std::weak_ptr<const CompiledProgram> weak;
+    {
+        Isolate isolate;
+        {
+            auto compiled = CompiledProgram::compile("let f = fn(x) { x + 1 };");
+            ASSERT_TRUE(compiled.has_value());
+            weak = compiled.value();
+            ASSERT_TRUE(isolate.run(compiled.value()).has_value());
+        }
+        // f is still bound, so the isolate keeps its code alive
+        ASSERT_FALSE(weak.expired());
+        auto evaluated = isolate.run("f(1);");
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_EQ(evaluated.value(), Object(Integer(2)));
+    }
+    ASSERT_TRUE(weak.expired());
+}
+
+TEST(CompiledProgram, FreedProgramStateTest) {
+    IsolateConfig config;
+    config.jit.threshold = 2;
+    config.memo.enabled = true;
+    Isolate isolate(config);
+    IsolateScope scope(isolate);
+    auto env = std::make_shared<Environment>(Environment());
+    // Each program is freed before the next is parsed, so its nodes may be at the addresses the previous one used. The
+    // tiering and memo state of the previous one must not carry over
+    for (int64_t k = 1; k <= 4; k++) {
+        auto compiled = CompiledProgram::compile(std::format("let f = fn(x) {{ x * {} }}; f(1) + f(2) + f(3) + f(4);", k));
+        ASSERT_TRUE(compiled.has_value());
+        auto evaluated = compiled.value()->evaluate(env);
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_EQ(evaluated.value(), Object(Integer(10 * k)));
+    }
+}
+
+TEST(CompiledProgram, FreedProgramSideCacheTest) {
+    IsolateConfig config;
+    config.jit.threshold = 2;
+    Isolate owner(config);
+    Isolate other(config);
+    auto env = std::make_shared<Environment>(Environment());
+    // The owner claims every call site first, so the other isolate calls through caches of its own. Those must not
+    // match a freed program's sites or callees at reused addresses, and must go away with the program
+    for (int64_t k = 1; k <= 60; k++) {
+        auto compiled = CompiledProgram::compile(std::format("let f = fn(x) {{ x * {} }}; f(1) + f(2) + f(3) + f(4);", k));
+        ASSERT_TRUE(compiled.has_value());
+        {
+            IsolateScope scope(owner);
+            ASSERT_TRUE(compiled.value()->evaluate(std::make_shared<Environment>(Environment())).has_value());
+        }
+        IsolateScope scope(other);
+        auto evaluated = compiled.value()->evaluate(env);
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_EQ(evaluated.value(), Object(Integer(10 * k)));
+    }
+    ASSERT_LE(other.call_sites.size(), 16);
+}
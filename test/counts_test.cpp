@@ -0,0 +1,59 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <format>
+
+#include "counts.h"
+#include "jit.h"
+
+TEST(Counts, LineTest) {
+    std::string program = R""""(let fib = fn(n) {
+  if (n < 2) {
+    return n;
+  };
+  fib(n - 1) + fib(n - 2)
+};
+let unused = fn() {
+  0
+};
+fib(5);)"""";
+    // Compiled functions do not count their lines
+    auto jit = jit_config().enabled;
+    jit_config().enabled = false;
+    start_counting();
+    ASSERT_EQ(eval_program(program).value(), Object(Integer(5)));
+    auto counts = stop_counting();
+    jit_config().enabled = jit;
+
+    ASSERT_EQ(counts.lines.size(), 7);
+    ASSERT_EQ(counts.lines[1].count, 1);
+    ASSERT_EQ(counts.lines[2].count, 15);
+    ASSERT_EQ(counts.lines[3].count, 8);
+    ASSERT_EQ(counts.lines[5].count, 7);
+    ASSERT_EQ(counts.lines[7].count, 1);
+    ASSERT_EQ(counts.lines[8].count, 0);
+    ASSERT_EQ(counts.lines[10].count, 1);
+
+    auto &fib = counts.functions.at("fib");
+    ASSERT_EQ(fib.calls, 15);
+    ASSERT_LE(fib.self_time, fib.total_time);
+    ASSERT_GT(fib.total_time, 0);
+
+    auto listing = annotate_source(counts, program);
+    ASSERT_NE(listing.find(std::format("{:>10} {:>12}  {:>5}: {}\n", "#####", "", 8, "  0")), std::string::npos) << listing;
+    ASSERT_NE(listing.find(std::format("{:>10} {:>12}  {:>5}: {}\n", "-", "", 4, "  };")), std::string::npos) << listing;
+    ASSERT_NE(listing.find(std::format("{:>10} ", 15)), std::string::npos) << listing;
+
+    auto json = counts_json(counts);
+    ASSERT_NE(json.find("{\"line\": 8, \"count\": 0, \"self_ns\": 0}"), std::string::npos) << json;
+    ASSERT_NE(json.find("{\"name\": \"fib\", \"calls\": 15, "), std::string::npos) << json;
+}
+
+TEST(Counts, OffTest) {
+    // Nothing is counted unless counting was started
+    eval_program("let f = fn(x) { x }; f(1);");
+    start_counting();
+    auto counts = stop_counting();
+    ASSERT_TRUE(counts.lines.empty());
+    ASSERT_TRUE(counts.functions.empty());
+}
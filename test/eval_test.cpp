@@ -121,6 +121,18 @@ TEST(Eval, ErrorHandlingTest) {
             "foobar",
             "identifier not found: foobar",
         },
+        {
+            "5();",
+            "not a function: Integer",
+        },
+        {
+            "\"s\"(1);",
+            "not a function: String",
+        },
+        {
+            "[1](0);",
+            "not a function: Array",
+        },
     };
     for (const auto &[input, correct]: tests) {
         auto evaluated_result = eval_program(input);
@@ -0,0 +1,87 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "event_log.h"
+#include "intern.h"
+
+namespace {
+    size_t count(const std::string &haystack, const std::string &needle) {
+        size_t n = 0;
+        for (auto at = haystack.find(needle); at != std::string::npos; at = haystack.find(needle, at + 1)) n++;
+        return n;
+    }
+}// namespace
+
+TEST(EventLog, LookupTest) {
+    std::string program = "let f = fn(x) { x + y }; f(1);";
+    // Nothing is recorded unless the log was started
+    eval_program(program);
+    start_event_log();
+    testing::internal::CaptureStdout();
+    ASSERT_FALSE(eval_program(program).has_value());
+    // A failed lookup is only logged, not printed
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "");
+    auto events = decode_event_log(dump_event_log());
+    ASSERT_TRUE(events.has_value());
+    ASSERT_EQ(count(events.value(), " lookup_miss y 0 0\n"), 1) << events.value();
+    ASSERT_EQ(count(events.value(), " error identifier not found: y 0 0\n"), 1) << events.value();
+    // Calls are logged at trace, which is compiled out unless the build asks for it
+    ASSERT_EQ(count(events.value(), " call f 1 0\n"), MONKE_EVENT_LEVEL == 0 ? 1 : 0) << events.value();
+}
+
+TEST(EventLog, CopiedNameTest) {
+    start_event_log();
+    {
+        std::string name = "temporary";
+        log_event_copy<EventLevel::Warn>(EventKind::Start, name, 7);
+        name = "overwritten";
+    }
+    // Error messages are copied into the log, not interned
+    ASSERT_FALSE(eval_program("let x = 1; unbound_in_copied_name_test;").has_value());
+    auto events = decode_event_log(dump_event_log()).value();
+    ASSERT_EQ(count(events, " start temporary 7 0\n"), 1) << events;
+    ASSERT_EQ(count(events, " error identifier not found: unbound_in_copied_name_test 0 0\n"), 1) << events;
+    ASSERT_EQ(find_interned("unbound_in_copied_name_test"), nullptr);
+    ASSERT_EQ(find_interned("identifier not found: unbound_in_copied_name_test"), nullptr);
+}
+
+TEST(EventLog, LevelTest) {
+    start_event_log();
+    log_event<EventLevel::Trace>(EventKind::Start, "trace");
+    log_event<EventLevel::Info>(EventKind::Start, "info", 1, -2);
+    auto events = decode_event_log(dump_event_log()).value();
+    ASSERT_EQ(count(events, " start trace 0 0\n"), MONKE_EVENT_LEVEL == 0 ? 1 : 0);
+    ASSERT_EQ(count(events, "  info       start info 1 -2\n"), 1) << events;
+
+    // Nothing is recorded once the log is dumped
+    log_event<EventLevel::Error>(EventKind::Error, "late");
+    start_event_log();
+    ASSERT_EQ(count(decode_event_log(dump_event_log()).value(), "\n"), 1);
+}
+
+TEST(EventLog, BufferTest) {
+    start_event_log();
+    // Each thread records into its own buffer, and a full buffer keeps the newest records
+    std::thread other([]() {
+        for (size_t i = 0; i < EVENT_LOG_RECORDS + 10; i++) log_event<EventLevel::Warn>(EventKind::Start, "other", static_cast<int64_t>(i));
+    });
+    other.join();
+    log_event<EventLevel::Warn>(EventKind::Start, "main");
+    auto events = decode_event_log(dump_event_log()).value();
+    ASSERT_EQ(count(events, " other "), EVENT_LOG_RECORDS);
+    ASSERT_EQ(count(events, " other 9 0\n"), 0);
+    ASSERT_EQ(count(events, " other 10 0\n"), 1);
+    ASSERT_EQ(count(events, " main 0 0\n"), 1);
+}
+
+TEST(EventLog, DecodeTest) {
+    start_event_log();
+    log_event<EventLevel::Error>(EventKind::Error, "oops", 3);
+    auto dump = dump_event_log();
+    ASSERT_TRUE(dump.starts_with("MONKEEV1"));
+    ASSERT_TRUE(decode_event_log(dump).has_value());
+    ASSERT_FALSE(decode_event_log(dump.substr(0, dump.size() - 1)).has_value());
+    ASSERT_FALSE(decode_event_log("monke heap snapshot\n").has_value());
+}
@@ -0,0 +1,143 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <format>
+
+#include "hash_table.h"
+#include "intern.h"
+
+TEST(Hash, InternTest) {
+    auto *a = intern("monke");
+    ASSERT_EQ(a, intern(std::string("mon") + "ke"));
+    ASSERT_EQ(*a, "monke");
+    ASSERT_EQ(find_interned("monke"), a);
+    ASSERT_EQ(find_interned("never interned by anything"), nullptr);
+}
+
+TEST(Hash, SharedStringTest) {
+    auto shared = intern_shared("shared for a while");
+    ASSERT_EQ(find_interned("shared for a while"), shared.get());
+    ASSERT_EQ(intern_shared(std::string("shared for") + " a while"), shared);
+    shared.reset();
+    ASSERT_EQ(find_interned("shared for a while"), nullptr);
+
+    // Interning a shared string keeps its address, and keeps it for good
+    shared = intern_shared("shared, then interned");
+    auto *interned = intern("shared, then interned");
+    ASSERT_EQ(interned, shared.get());
+    shared.reset();
+    ASSERT_EQ(find_interned("shared, then interned"), interned);
+}
+
+TEST(Hash, RuntimeKeyTest) {
+    auto evaluated = eval_program("put({}, \"built \" + \"at run time\", 1)[\"built \" + \"at run time\"];");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(1)));
+    // The hash is gone, and so is the key it built
+    ASSERT_EQ(find_interned("built at run time"), nullptr);
+}
+
+TEST(Hash, TableTest) {
+    HashTable table;
+    ASSERT_EQ(table.find(HashKey::of(Integer(1)).value()), nullptr);
+    // Enough to rehash several times and fill groups with colliding control bytes
+    for (int64_t i = 0; i < 5000; i++) {
+        table.insert(HashKey::of(Integer(i)).value(), Integer(i * 2));
+        table.insert(HashKey::of(String(std::format("key{}", i))).value(), Integer(-i));
+    }
+    ASSERT_EQ(table.size(), 10000);
+    for (int64_t i = 0; i < 5000; i++) {
+        ASSERT_EQ(*table.find(HashKey::of(Integer(i)).value()), Object(Integer(i * 2)));
+        ASSERT_EQ(*table.find(HashKey::find(String(std::format("key{}", i))).value()), Object(Integer(-i)));
+    }
+    ASSERT_EQ(table.find(HashKey::of(Integer(5000)).value()), nullptr);
+
+    // Replacing keeps the original position
+    table.insert(HashKey::of(Integer(0)).value(), String("zero"));
+    ASSERT_EQ(table.size(), 10000);
+    ASSERT_EQ(table.items()[0].second, Object(String("zero")));
+    ASSERT_EQ(table.items()[1].first.object(), Object(String("key0")));
+
+    // Keys of different kinds never collide
+    ASSERT_FALSE(HashKey::of(Integer(1)) == HashKey::of(Boolean(true)));
+    ASSERT_FALSE(HashKey::of(Integer(97)) == HashKey::of(Char('a')));
+    ASSERT_FALSE(HashKey::of(Float(1.0)).has_value());
+}
+
+TEST(Hash, LiteralTest) {
+    auto evaluated = eval_program("let two = 2; {\"one\": 1, two: \"two\", true: 3.5, 'c': [1]};");
+    ASSERT_TRUE(evaluated.has_value());
+    auto &hash = std::get<Hash>(evaluated.value());
+    ASSERT_EQ(hash.size(), 4);
+    ASSERT_EQ(hash.inspect(), "Hash({String(one): Integer(1), Integer(2): String(two), BooleanLiteral(true): Float(3.5), Char(c): Array([Integer(1)])})");
+
+    auto empty = eval_program("{};");
+    ASSERT_TRUE(empty.has_value());
+    ASSERT_EQ(std::get<Hash>(empty.value()).size(), 0);
+
+    // The later of two equal keys wins
+    auto repeated = eval_program("{\"a\": 1, \"a\": 2}[\"a\"];");
+    ASSERT_EQ(repeated.value(), Object(Integer(2)));
+
+    auto error = eval_program("{1.5: 1};");
+    ASSERT_FALSE(error.has_value());
+    ASSERT_EQ(get_msg(error.error()), "unusable as hash key: Float");
+}
+
+TEST(Hash, IndexTest) {
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"{\"a\": 1, \"b\": 2}[\"b\"];", Integer(2)},
+        {"let h = {1: \"x\"}; h[1];", String("x")},
+        {"let h = {true: 1, false: 0}; h[1 < 2] + h[2 < 1];", Integer(1)},
+        {"let h = {'z': 26}; h['z'];", Integer(26)},
+        {"let k = \"na\" + \"me\"; let h = {\"name\": 5}; h[k];", Integer(5)},
+        {"let k = \"ke\" + \"y\"; let h = {k: 7}; h[\"key\"];", Integer(7)},
+        {"let h = {\"inner\": {\"x\": 3}}; h[\"inner\"][\"x\"];", Integer(3)},
+        {"let get = fn(h, i) { if (i < 1) { 0 } else { h[\"v\"] + get(h, i - 1) } }; get({\"v\": 2}, 10);", Integer(20)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+
+    for (auto input: {"{\"a\": 1}[\"b\"];", "{1: 1}[2];", "{}[\"a string no program has used as a key\"];"}) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_TRUE(std::holds_alternative<Null>(evaluated.value())) << input;
+    }
+
+    auto error = eval_program("{1: 1}[[1]];");
+    ASSERT_FALSE(error.has_value());
+    ASSERT_EQ(get_msg(error.error()), "unusable as hash key: Array");
+}
+
+TEST(Hash, BuiltinsTest) {
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"len({1: 1, 2: 2});", Integer(2)},
+        {"keys({\"b\": 1, \"a\": 2});", Array::from({String("b"), String("a")})},
+        {"values({\"b\": 1, \"a\": 2});", Array(std::vector<int64_t>({1, 2}))},
+        {"has({\"a\": 1}, \"a\");", Boolean(true)},
+        {"has({\"a\": 1}, \"b\");", Boolean(false)},
+        {"let h = {\"a\": 1}; let g = put(h, \"b\", 2); len(h) * 10 + len(g);", Integer(12)},
+        {"put({\"a\": 1}, \"a\", 5)[\"a\"];", Integer(5)},
+        {"str({\"a\": 1, 2: true});", String("{a: 1, 2: true}")},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+    ASSERT_EQ(eval_program("put({}, 1, 2);").value(), eval_program("{1: 2};").value());
+
+    std::vector<std::tuple<std::string, std::string> > errors = {
+        {"keys([1]);", "argument to `keys` not supported, got Array"},
+        {"has({}, 1.5);", "unusable as hash key: Float"},
+        {"put({}, [1], 1);", "unusable as hash key: Array"},
+    };
+    for (const auto &[input, message]: errors) {
+        auto evaluated = eval_program(input);
+        ASSERT_FALSE(evaluated.has_value()) << input;
+        ASSERT_EQ(get_msg(evaluated.error()), message);
+    }
+}
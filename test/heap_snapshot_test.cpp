@@ -0,0 +1,81 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "heap_snapshot.h"
+
+namespace {
+    const HeapNode *binding(const HeapSnapshot &snapshot, const std::string &name) {
+        for (auto &node: snapshot.nodes) {
+            if (node.kind == HeapNodeKind::Binding && node.name == name) return &node;
+        }
+        return nullptr;
+    }
+}// namespace
+
+TEST(HeapSnapshot, DominatorTest) {
+    // root -> a -> c -> d and root -> b -> c: only the root dominates c, which dominates d
+    HeapSnapshot snapshot;
+    snapshot.nodes.resize(5);
+    uint64_t size = 1;
+    for (auto &node: snapshot.nodes) {
+        node.kind = HeapNodeKind::Array;
+        node.self_size = size;
+        size *= 10;
+    }
+    snapshot.nodes[0].kind = HeapNodeKind::Root;
+    snapshot.nodes[0].edges = {1, 2};
+    snapshot.nodes[1].edges = {3};
+    snapshot.nodes[2].edges = {3};
+    snapshot.nodes[3].edges = {4, 3};
+    compute_retained_sizes(snapshot);
+    ASSERT_EQ(snapshot.nodes[1].dominator, 0);
+    ASSERT_EQ(snapshot.nodes[3].dominator, 0);
+    ASSERT_EQ(snapshot.nodes[4].dominator, 3);
+    ASSERT_EQ(snapshot.nodes[1].retained_size, 10);
+    ASSERT_EQ(snapshot.nodes[3].retained_size, 11000);
+    ASSERT_EQ(snapshot.nodes[0].retained_size, 11111);
+}
+
+TEST(HeapSnapshot, RetainerTest) {
+    std::string program = R""""(let grow = fn(s, n) { if (n < 1) { s } else { grow(s + s, n - 1) } };
+let make = fn() {
+  let data = grow("abcdefgh", 12);
+  fn() { data }
+};
+let keep = make();
+let other = [grow("abcdefgh", 4), {"key": grow("abcdefgh", 5)}];)"""";
+    auto env = std::make_shared<Environment>(Environment());
+    ASSERT_TRUE(eval_program(program, env).has_value());
+    auto snapshot = take_heap_snapshot({env});
+
+    uint64_t total = 0;
+    for (auto &node: snapshot.nodes) total += node.self_size;
+    ASSERT_EQ(snapshot.nodes[0].retained_size, total);
+
+    // data is only reachable through the closure bound to keep
+    auto *keep = binding(snapshot, "keep");
+    auto *data = binding(snapshot, "data");
+    ASSERT_NE(keep, nullptr);
+    ASSERT_NE(data, nullptr);
+    ASSERT_EQ(keep->line, 4);
+    ASSERT_GT(keep->retained_size, data->retained_size);
+    ASSERT_GT(data->retained_size, data->self_size);
+    auto *other = binding(snapshot, "other");
+    ASSERT_NE(other, nullptr);
+    ASSERT_GT(other->retained_size, other->self_size);
+
+    auto retainers = print_heap_retainers(snapshot);
+    ASSERT_NE(retainers.find("keep.data"), std::string::npos) << retainers;
+    ASSERT_NE(retainers.find("held by fn at line 4"), std::string::npos) << retainers;
+
+    auto read = read_heap_snapshot(write_heap_snapshot(snapshot));
+    ASSERT_TRUE(read.has_value());
+    ASSERT_EQ(read->nodes.size(), snapshot.nodes.size());
+    ASSERT_EQ(print_heap_retainers(read.value()), retainers);
+    ASSERT_FALSE(read_heap_snapshot("monke heap snapshot\nroot\t0\t0\t0\t0\t\t7\n").has_value());
+    // Bindings that dominate each other never lead back to the root
+    auto cycle = "monke heap snapshot\nroot\t0\t2\t0\t0\t\t1\nbinding\t1\t1\t2\t0\tx\t2\nbinding\t1\t1\t1\t0\ty\t1\n";
+    ASSERT_FALSE(read_heap_snapshot(cycle).has_value());
+    auto chain = "monke heap snapshot\nroot\t0\t2\t0\t0\t\t1\nbinding\t1\t2\t0\t0\tx\t2\nbinding\t1\t1\t1\t0\ty\t\n";
+    ASSERT_TRUE(read_heap_snapshot(chain).has_value());
+}
@@ -0,0 +1,62 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "inline_cache.h"
+
+TEST(InlineCache, MonomorphicHitTest) {
+    reset_inline_cache_stats();
+    auto evaluated = eval_program(R""""(
+        let add = fn(x, y) { x + y };
+        let f = fn(n) { add(n, 1) };
+        f(1) + f(2) + f(3);
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(9)));
+
+    auto &stats = inline_cache_stats();
+    ASSERT_EQ(stats.resolution_misses, 1);
+    ASSERT_EQ(stats.resolution_hits, 2);
+    ASSERT_GE(stats.callee_hits, 2);
+}
+
+TEST(InlineCache, ShadowingInvalidatesTest) {
+    auto evaluated = eval_program(R""""(
+        let g = fn() { 1 };
+        let outer = fn() {
+            let call = fn() { g() };
+            let a = call();
+            let g = fn() { 2 };
+            a + call();
+        };
+        outer();
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(3)));
+}
+
+TEST(InlineCache, PolymorphicTest) {
+    reset_inline_cache_stats();
+    std::vector<std::tuple<std::string, int64_t> > tests = {
+        {"let apply = fn(f, x) { f(x) }; apply(fn(x) { x + 1 }, 1) + apply(fn(x) { x * 2 }, 2);", 6},
+        {
+            R""""(
+            let apply = fn(f, x) { f(x) };
+            let a = apply(fn(x) { x + 1 }, 1);
+            let b = apply(fn(x) { x + 2 }, 1);
+            let c = apply(fn(x) { x + 3 }, 1);
+            let d = apply(fn(x) { x + 4 }, 1);
+            let e = apply(fn(x) { x + 5 }, 1);
+            let f = apply(fn(x) { x + 6 }, 1);
+            a + b + c + d + e + f;
+            )"""",
+            27
+        },
+        {"let a = fn() { 5 }; a() + a();", 10},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_EQ(evaluated.value(), Object(Integer(correct)));
+    }
+    ASSERT_GT(inline_cache_stats().megamorphic_calls, 0);
+}
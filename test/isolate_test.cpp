@@ -0,0 +1,100 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "compiled_program.h"
+#include "isolate.h"
+
+TEST(Isolate, SeparateGlobalsTest) {
+    Isolate a;
+    Isolate b;
+    ASSERT_TRUE(a.run("let x = 40;").has_value());
+    ASSERT_TRUE(b.run("let x = 1;").has_value());
+    auto from_a = a.run("x + 2;");
+    auto from_b = b.run("x + 2;");
+    ASSERT_TRUE(from_a.has_value());
+    ASSERT_TRUE(from_b.has_value());
+    ASSERT_EQ(from_a.value(), Object(Integer(42)));
+    ASSERT_EQ(from_b.value(), Object(Integer(3)));
+}
+
+TEST(Isolate, SeparateConfigTest) {
+    IsolateConfig config;
+    config.jit.threshold = 2;
+    Isolate jit(config);
+    config.jit.enabled = false;
+    Isolate interpreted(config);
+
+    std::string program = "let triple = fn(n) { n * 3 }; triple(1) + triple(2) + triple(3);";
+    ASSERT_EQ(jit.run(program).value(), Object(Integer(18)));
+    ASSERT_EQ(interpreted.run(program).value(), Object(Integer(18)));
+    ASSERT_EQ(jit.jit_stats.compiled, 1);
+    ASSERT_EQ(interpreted.jit_stats.compiled, 0);
+}
+
+TEST(Isolate, ConcurrentStressTest) {
+    std::vector<std::tuple<std::string, int64_t> > programs = {
+        {"let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) }; fib(15);", 610},
+        {"let sum = fn(n) { if (n < 1) { 0 } else { n + sum(n - 1) } }; sum(200);", 20100},
+        {"let add = fn(x, y) { x + y }; let apply = fn(f, x) { f(x, x) }; apply(add, 21);", 42},
+        {"let k = 5; let f = fn(x) { x * k }; f(1) + f(2) + f(3);", 30},
+    };
+    // One program parsed up front and run by every thread, the others parsed per run
+    auto *l = new Lexer("let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) }; fib(10);");
+    Parser p = Parser(l);
+    Program shared = p.parse_program();
+
+    constexpr size_t threads = 8;
+    std::vector<std::thread> workers;
+    std::vector<size_t> failures(threads, 0);
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            IsolateConfig config;
+            config.jit.threshold = 10;
+            config.memo.enabled = t % 2 == 0;
+            for (size_t i = 0; i < 20; i++) {
+                Isolate isolate(config);
+                auto &[source, expected] = programs[(t + i) % programs.size()];
+                auto result = isolate.run(source);
+                if (!result.has_value() || result.value() != Object(Integer(expected))) failures[t]++;
+                auto reused = isolate.run(shared);
+                if (!reused.has_value() || reused.value() != Object(Integer(55))) failures[t]++;
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    ASSERT_EQ(failures, std::vector<size_t>(threads, 0));
+}
+
+TEST(Isolate, HostCallTest) {
+    Isolate isolate;
+    auto compiled = CompiledProgram::compile(R""""(
+        let threshold = 10;
+        let score = fn(x, y) { if (x * y > threshold) { x * y } else { 0 } };
+        let greet = fn(name) { "hi " + name };
+        let limit = 3;
+    )"""");
+    ASSERT_TRUE(compiled.has_value());
+    ASSERT_TRUE(isolate.run(compiled.value()).has_value());
+
+    auto score = isolate.lookup("score");
+    ASSERT_TRUE(score.has_value());
+    for (int64_t x = 0; x < 2000; x++) {
+        auto result = isolate.call(score.value(), {Integer(x), Integer(2)});
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(result.value(), Object(Integer(2 * x > 10 ? 2 * x : 0)));
+    }
+    // Hot enough to have been compiled
+    ASSERT_EQ(isolate.jit_stats.compiled, 1);
+
+    auto greet = isolate.lookup("greet");
+    ASSERT_TRUE(greet.has_value());
+    ASSERT_EQ(isolate.call(greet.value(), {String("monke")}).value(), Object(String("hi monke")));
+
+    ASSERT_FALSE(isolate.lookup("missing").has_value());
+    ASSERT_EQ(get_msg(isolate.lookup("limit").error()), "not a function: Integer");
+    ASSERT_EQ(get_msg(isolate.call(score.value(), {Integer(1)}).error()), "wrong number of arguments: want=2, got=1");
+}
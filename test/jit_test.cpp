@@ -0,0 +1,84 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <format>
+#include <unistd.h>
+
+#include "jit.h"
+
+class JitTest : public ::testing::Test {
+    protected:
+    void SetUp() override {
+        jit_config().enabled = true;
+        jit_config().threshold = 2;
+        reset_jit_stats();
+    }
+    void TearDown() override {
+        jit_config() = JitConfig();
+    }
+};
+
+TEST_F(JitTest, CompiledResultsTest) {
+    std::vector<std::tuple<std::string, int64_t> > tests = {
+        {"let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) }; fib(20);", 6765},
+        {"let fact = fn(n) { if (n < 1) { 1 } else { n * fact(n - 1) } }; fact(10);", 3628800},
+        {"let f = fn(a, b) { let c = a * b; let d = c - a; d / 2 }; f(3, 4) + f(5, 6) + f(7, 8);", 4 + 12 + 24},
+        {"let k = 7; let f = fn(x) { if (!(x > k)) { return -x; } x + k }; f(1) + f(2) + f(10);", -1 - 2 + 17},
+        {"let sq = fn(x) { x * x }; let f = fn(x) { sq(x) + 1 }; f(1) + f(2) + f(3) + f(4);", 2 + 5 + 10 + 17},
+        {"let eq = fn(x, y) { if ((x < y) == (y > x)) { 1 } else { 0 } }; eq(1, 2) + eq(2, 1) + eq(3, 3);", 3},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_EQ(evaluated.value(), Object(Integer(correct)));
+    }
+    ASSERT_GT(jit_stats().compiled, 0);
+    ASSERT_GT(jit_stats().native_calls, 0);
+}
+
+TEST_F(JitTest, GuardBailoutTest) {
+    // Division by zero traps in native code, so the guard hands the call back to the interpreter first
+    auto evaluated = eval_program(R""""(
+        let id = fn(x) { x };
+        let a = id(1) + id(2) + id(3);
+        let s = id("monke");
+        let div = fn(x, y) { if (y > 0) { x / y } else { 0 } };
+        a + div(9, 3) + div(8, 2) + div(1, 0);
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(6 + 3 + 4)));
+    ASSERT_GT(jit_stats().bailouts, 0);
+}
+
+TEST_F(JitTest, UnsupportedTest) {
+    auto evaluated = eval_program(R""""(
+        let greet = fn(x) { "hi" };
+        greet(1);
+        greet(2);
+        greet(3);
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(String("hi")));
+    ASSERT_EQ(jit_stats().compiled, 0);
+    ASSERT_EQ(jit_stats().failed, 1);
+}
+
+TEST_F(JitTest, DisabledTest) {
+    jit_config().enabled = false;
+    auto evaluated = eval_program("let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) }; fib(10);");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(55)));
+    ASSERT_EQ(jit_stats().compiled, 0);
+}
+
+TEST_F(JitTest, PerfMapTest) {
+    auto path = std::format("/tmp/perf-{}.map", getpid());
+    std::filesystem::remove(path);
+    jit_config().perf_map = true;
+    auto evaluated = eval_program("let triple = fn(n) { n * 3 }; triple(1) + triple(2) + triple(3);");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(18)));
+    ASSERT_NE(read_file(path).find("monke::triple"), std::string::npos);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,141 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "jit.h"
+#include "memo.h"
+
+class MemoTest : public ::testing::Test {
+    protected:
+    void SetUp() override {
+        memo_config().enabled = true;
+        // Keep the interpreter on the memoized path
+        jit_config().enabled = false;
+        reset_memo_stats();
+    }
+    void TearDown() override {
+        memo_config() = MemoConfig();
+        jit_config() = JitConfig();
+    }
+};
+
+PurityInfo purity_of(std::string input) {
+    auto *l = new Lexer(input);
+    Parser p = Parser(l);
+    Program program = p.parse_program();
+    auto &stmt = std::get<ExpressionStatement>(program.statements[0]);
+    auto &literal = std::get<FunctionLiteral>(stmt.e);
+    std::vector<Identifier> parameters;
+    for (auto *param: literal.parameters) {
+        parameters.push_back(*param);
+    }
+    return analyze_purity(parameters, *literal.body);
+}
+
+TEST(Memo, PurityAnalysisTest) {
+    auto fib = purity_of("fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) };");
+    ASSERT_TRUE(fib.pure);
+    ASSERT_EQ(fib.callees, std::vector<std::string>({"fib"}));
+
+    auto scaled = purity_of("fn(x) { let y = x * k; y + 1 };");
+    ASSERT_TRUE(scaled.pure);
+    ASSERT_EQ(scaled.captures, std::vector<std::string>({"k"}));
+
+    ASSERT_FALSE(purity_of("fn(f, x) { f(x) };").pure);
+    ASSERT_FALSE(purity_of("fn(x) { fn(y) { x + y } };").pure);
+    ASSERT_FALSE(purity_of("fn(x) { let g = h; g(x) };").pure);
+}
+
+TEST_F(MemoTest, FibTest) {
+    auto evaluated = eval_program("let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) }; fib(60);");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(1548008755920)));
+    // Every fib(k) is computed once; fib(k - 2) is then a hit for k >= 3
+    ASSERT_EQ(memo_stats().misses, 61);
+    ASSERT_EQ(memo_stats().hits, 58);
+}
+
+TEST_F(MemoTest, ResultsTest) {
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"let k = 3; let f = fn(x) { x * k }; f(2) + f(2) + f(5);", Integer(6 + 6 + 15)},
+        {"let f = fn(x, y) { if (x > y) { x } else { y } }; f(1, 2) + f(2, 1) + f(1, 2);", Integer(6)},
+        {"let f = fn(s) { s + \"!\" }; f(\"a\"); f(\"a\");", String("a!")},
+        {"let f = fn(b) { !b }; f(true) == f(true);", Boolean(true)},
+        {"let f = fn(x) { x + 0.5 }; f(1.5) + f(1.5);", Float(4.0)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value());
+        ASSERT_EQ(evaluated.value(), correct);
+    }
+    ASSERT_GT(memo_stats().hits, 0);
+}
+
+TEST_F(MemoTest, ShadowedCaptureTest) {
+    auto evaluated = eval_program(R""""(
+        let outer = fn() {
+            let scale = fn(x) { x * k };
+            let a = scale(2);
+            let k = 10;
+            a + scale(2);
+        };
+        let k = 1;
+        outer();
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(2 + 20)));
+}
+
+TEST_F(MemoTest, ShadowedCalleeCaptureTest) {
+    auto evaluated = eval_program(R""""(
+        let k = 1;
+        let outer = fn() {
+            let g = fn() { k };
+            let f = fn(x) { g() + x };
+            let a = f(1);
+            let k = 100;
+            f(1);
+        };
+        outer();
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(101)));
+    ASSERT_EQ(memo_stats().hits, 0);
+    ASSERT_GT(memo_stats().invalidations, 0);
+}
+
+TEST_F(MemoTest, MutualRecursionImpureTest) {
+    // g's verdict is asked for while f's is still being made, and f turns out impure only after that
+    testing::internal::CaptureStdout();
+    auto evaluated = eval_program(R""""(
+        let f = fn(n) { if (n < 1) { 0 } else { let r = g(n - 1); let p = puts("x"); r } };
+        let g = fn(n) { f(n) };
+        f(2);
+        f(2);
+    )"""");
+    auto output = testing::internal::GetCapturedStdout();
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(output, "x\nx\nx\nx\n");
+    ASSERT_EQ(memo_stats().hits, 0);
+}
+
+TEST_F(MemoTest, ImpureSkippedTest) {
+    auto evaluated = eval_program(R""""(
+        let apply = fn(f, x) { f(x) };
+        let make = fn(x) { fn(y) { x + y } };
+        apply(make(1), 2) + apply(make(1), 2);
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(6)));
+    ASSERT_EQ(memo_stats().hits, 0);
+    ASSERT_GT(memo_stats().skipped, 0);
+}
+
+TEST_F(MemoTest, EvictionTest) {
+    memo_config().capacity = 2;
+    auto evaluated = eval_program("let f = fn(x) { x + 1 }; f(1) + f(2) + f(3) + f(1);");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(2 + 3 + 4 + 2)));
+    // f(1) was the least recently used result when f(3) came in
+    ASSERT_EQ(memo_stats().evictions, 2);
+    ASSERT_EQ(memo_stats().hits, 0);
+}
@@ -0,0 +1,100 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "parallel.h"
+
+class ParallelTest : public ::testing::Test {
+    protected:
+    void SetUp() override {
+        parallel_config().enabled = true;
+        parallel_config().threads = 4;
+        reset_parallel_stats();
+    }
+    void TearDown() override {
+        parallel_config() = ParallelConfig();
+    }
+};
+
+std::vector<std::vector<size_t> > dependencies_of(std::string input) {
+    auto *l = new Lexer(input);
+    Parser p = Parser(l);
+    Program program = p.parse_program();
+    std::vector<StatementInfo> infos;
+    for (auto &stmt: program.statements) {
+        infos.push_back(analyze_statement(stmt));
+    }
+    return statement_dependencies(infos);
+}
+
+TEST(Parallel, DependenciesTest) {
+    // c calls f, whose body reads k, so c waits for k's binding as well as f's
+    auto deps = dependencies_of("let a = 1; let f = fn(x) { x + k }; let k = 2; let c = f(a); let d = 5;");
+    std::vector<std::vector<size_t> > expected = {{}, {}, {}, {0, 1, 2}, {}};
+    ASSERT_EQ(deps, expected);
+
+    // The second binding of x must not run before the use that sees the first one
+    deps = dependencies_of("let x = 1; let y = x; let x = 2;");
+    expected = {{}, {0}, {0, 1}};
+    ASSERT_EQ(deps, expected);
+
+    // Top level blocks and returns keep their place in the program
+    deps = dependencies_of("let a = 1; if (true) { let b = 2; }; let c = 3;");
+    expected = {{}, {0}, {1}};
+    ASSERT_EQ(deps, expected);
+}
+
+TEST_F(ParallelTest, MatchesSequentialTest) {
+    std::vector<std::string> tests = {
+        R""""(
+            let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) };
+            let a = fib(15);
+            let b = fib(16);
+            let c = fib(17);
+            let d = fib(18);
+            a + b + c + d;
+        )"""",
+        "let x = 1; let y = x + 1; let x = 5; let z = x + y; z;",
+        "let f = fn() { g() }; let a = f(); let g = fn() { 1 }; a;",
+        "let f = fn() { g() }; let g = fn() { 1 }; let a = f(); a;",
+        "let a = 1; let b = 2; return a + b; let c = d;",
+        "let a = 1; if (a > 0) { let b = 2; }; let c = b + 1; c;",
+        "let a = 1; let b = a + true; let c = undefined; c;",
+        "let a = 1; let b = 2; let c = 3;",
+        "let s = \"a\"; let t = s + \"b\"; let u = t + s; u;",
+    };
+    for (auto &input: tests) {
+        parallel_config().enabled = false;
+        auto sequential = eval_program(input);
+        parallel_config().enabled = true;
+        auto parallel = eval_program(input);
+        ASSERT_EQ(sequential.has_value(), parallel.has_value()) << input;
+        if (sequential.has_value()) {
+            ASSERT_EQ(inspect(sequential.value()), inspect(parallel.value())) << input;
+        } else {
+            ASSERT_EQ(get_msg(sequential.error()), get_msg(parallel.error())) << input;
+        }
+    }
+}
+
+TEST_F(ParallelTest, IndependentStatementsTest) {
+    auto evaluated = eval_program(R""""(
+        let sum = fn(n) { if (n < 1) { 0 } else { n + sum(n - 1) } };
+        let a = sum(100);
+        let b = sum(200);
+        let c = sum(300);
+        let d = sum(400);
+        a + b + c + d;
+    )"""");
+    ASSERT_TRUE(evaluated.has_value());
+    ASSERT_EQ(evaluated.value(), Object(Integer(5050 + 20100 + 45150 + 80200)));
+    // sum, then a to d together, then the total
+    ASSERT_EQ(parallel_stats().waves, 3);
+    ASSERT_EQ(parallel_stats().parallel_statements, 4);
+}
+
+TEST_F(ParallelTest, FirstErrorWinsTest) {
+    // b fails in the first wave, but a fails earlier in program order once its dependency is bound
+    auto evaluated = eval_program("let x = 1; let a = x + true; let b = 1 + false;");
+    ASSERT_FALSE(evaluated.has_value());
+    ASSERT_EQ(get_msg(evaluated.error()), "type mismatch: Integer + BooleanLiteral");
+}
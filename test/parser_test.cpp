@@ -456,6 +456,18 @@ TEST(Parser, ParserOperatorPrecedenceTest) {
             "add(a + b + c * d / f + g)",
             "add((((a + b) + ((c * d) / f)) + g))",
         },
+        {
+            "a * [1, 2, 3, 4][b * c] * d",
+            "((a * ([1, 2, 3, 4][(b * c)])) * d)",
+        },
+        {
+            "add(a * b[2], b[1], 2 * [1, 2][1])",
+            "add((a * (b[2])), (b[1]), (2 * ([1, 2][1])))",
+        },
+        {
+            "{\"a\": 1 + 2, b: c * d}[\"a\"]",
+            "({\"a\": (1 + 2), b: (c * d)}[\"a\"])",
+        },
     };
 
     for (auto &[input, expected]: tests) {
@@ -604,3 +616,34 @@ TEST(Parser, CallExpressionParsingTest) {
     });
     ASSERT_EQ(program, correct_program);
 }
+
+TEST(Parser, ArrayLiteralParsingTest) {
+    auto p = Parser(new Lexer("[1, 2 * 2, 3 + 3]; [];"));
+    auto program = p.parse_program();
+    ASSERT_EQ(program.statements.size(), 2);
+    auto &array = std::get<ArrayLiteral>(std::get<ExpressionStatement>(program.statements[0]).e);
+    ASSERT_EQ(array.elements.size(), 3);
+    ASSERT_EQ(*array.elements[0], Expression(IntegerLiteral(1)));
+    ASSERT_EQ(array.elements[1]->index(), Expression(InfixExpression()).index());
+    auto &empty = std::get<ArrayLiteral>(std::get<ExpressionStatement>(program.statements[1]).e);
+    ASSERT_TRUE(empty.elements.empty());
+}
+
+TEST(Parser, HashLiteralParsingTest) {
+    auto p = Parser(new Lexer("{\"one\": 1, 2: 1 + 1, true: three}; {};"));
+    auto program = p.parse_program();
+    ASSERT_EQ(program.statements.size(), 2);
+    auto &hash = std::get<HashLiteral>(std::get<ExpressionStatement>(program.statements[0]).e);
+    ASSERT_EQ(hash.pairs.size(), 3);
+    ASSERT_EQ(*hash.pairs[0].first, Expression(StringLiteral(Token(STRING, "one"), "one")));
+    ASSERT_EQ(*hash.pairs[0].second, Expression(IntegerLiteral(1)));
+    ASSERT_EQ(hash.pairs[1].second->index(), Expression(InfixExpression()).index());
+    // Literal keys are interned once, so equal literals share a symbol
+    ASSERT_EQ(std::get<StringLiteral>(*hash.pairs[0].first).symbol, intern("one"));
+    auto &empty = std::get<HashLiteral>(std::get<ExpressionStatement>(program.statements[1]).e);
+    ASSERT_TRUE(empty.pairs.empty());
+
+    auto bad = Parser(new Lexer("{1 2};"));
+    bad.parse_program();
+    ASSERT_FALSE(bad.get_errors().empty());
+}
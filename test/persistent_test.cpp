@@ -0,0 +1,145 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+#include "hash_table.h"
+#include "persistent_map.h"
+#include "persistent_vector.h"
+
+TEST(Persistent, VectorTest) {
+    PersistentVector<int64_t> v;
+    std::vector<PersistentVector<int64_t>> versions;
+    // Deep enough for a three level trie
+    for (int64_t i = 0; i < 40000; i++) {
+        if (i % 997 == 0) versions.push_back(v);
+        v = v.push(i);
+    }
+    ASSERT_EQ(v.size(), 40000);
+    for (int64_t i = 0; i < 40000; i++) ASSERT_EQ(v[i], i);
+    // Every earlier version still sees exactly what it had
+    for (size_t k = 0; k < versions.size(); k++) {
+        ASSERT_EQ(versions[k].size(), k * 997);
+        if (k > 0) {
+            ASSERT_EQ(versions[k][k * 997 - 1], static_cast<int64_t>(k * 997 - 1));
+        }
+    }
+
+    auto changed = v.set(5, -5).set(39999, -1);
+    ASSERT_EQ(changed[5], -5);
+    ASSERT_EQ(changed[39999], -1);
+    ASSERT_EQ(v[5], 5);
+    ASSERT_EQ(v[39999], 39999);
+
+    auto flat = changed.to_vector();
+    ASSERT_EQ(flat.size(), 40000);
+    ASSERT_EQ(flat[5], -5);
+    ASSERT_EQ(flat[1000], 1000);
+}
+
+TEST(Persistent, VectorSharingTest) {
+    auto v = PersistentVector<int64_t>::from(std::vector<int64_t>(1000, 7));
+    // Nothing else holds the nodes, so updates happen where the element is
+    const auto *first = &v[0];
+    v.set_in_place(0, 1);
+    ASSERT_EQ(&v[0], first);
+
+    // A copy shares every node until one of them changes, and then only the changed path is copied
+    auto copy = v;
+    ASSERT_EQ(&copy[0], first);
+    copy.set_in_place(0, 2);
+    ASSERT_NE(&copy[0], first);
+    ASSERT_EQ(&copy[500], &v[500]);
+    ASSERT_EQ(v[0], 1);
+    ASSERT_EQ(copy[0], 2);
+}
+
+TEST(Persistent, MapTest) {
+    PersistentMap map;
+    std::vector<PersistentMap> versions;
+    for (int64_t i = 0; i < 20000; i++) {
+        if (i % 1000 == 0) versions.push_back(map);
+        map.insert(HashKey::of(Integer(i)).value(), Integer(i * 3));
+    }
+    ASSERT_EQ(map.size(), 20000);
+    for (int64_t i = 0; i < 20000; i++) ASSERT_EQ(*map.find(HashKey::of(Integer(i)).value()), Object(Integer(i * 3)));
+    ASSERT_EQ(map.find(HashKey::of(Integer(-1)).value()), nullptr);
+    for (size_t k = 0; k < versions.size(); k++) {
+        ASSERT_EQ(versions[k].size(), k * 1000);
+        ASSERT_EQ(versions[k].find(HashKey::of(Integer(static_cast<int64_t>(k * 1000))).value()), nullptr);
+    }
+
+    // Replacing keeps the size and the insertion order
+    map.insert(HashKey::of(Integer(0)).value(), String("zero"));
+    ASSERT_EQ(map.size(), 20000);
+    ASSERT_EQ(map.items()[0].second, Object(String("zero")));
+    ASSERT_EQ(map.items()[1].first.object(), Object(Integer(1)));
+
+    // These two keys hash to the same 64 bits, so they end up side by side below the last level
+    auto integer = HashKey::of(Integer(int64_t(1) << 61)).value();
+    auto boolean = HashKey::of(Boolean(false)).value();
+    ASSERT_EQ(integer.hash(), boolean.hash());
+    map.insert(integer, Integer(1));
+    map.insert(boolean, Integer(2));
+    ASSERT_EQ(*map.find(integer), Object(Integer(1)));
+    ASSERT_EQ(*map.find(boolean), Object(Integer(2)));
+    ASSERT_EQ(map.size(), 20002);
+}
+
+TEST(Persistent, ArrayTest) {
+    auto storage = [](std::string input) -> size_t {
+        auto evaluated = eval_program(input);
+        return std::get<Array>(evaluated.value()).elements->index();
+    };
+    std::string build = "let build = fn(a, i, n) { if (i < n) { build(push(a, i), i + 1, n) } else { a } };";
+    // Growing an array that the caller's frame still holds switches it to a trie once it is large
+    ASSERT_EQ(storage(build + "build([], 0, 10);"), 0);
+    ASSERT_EQ(storage(build + "build([], 0, 100);"), 3);
+    ASSERT_EQ(storage(build + "push(build([], 0, 100), 0.5);"), 5);
+    // Arrays only the call holds grow in place and stay contiguous
+    ASSERT_EQ(storage("push(push(push([1], 2), 3), 4);"), 0);
+
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {build + "let a = build([], 0, 500); a[0] + a[250] + a[499] + len(a);", Integer(0 + 250 + 499 + 500)},
+        {build + "let a = build([], 0, 500); let b = push(a, 1); len(a) * 1000 + len(b);", Integer(500 * 1000 + 501)},
+        {build + "let a = build([], 0, 100); let b = set(a, 50, -1); a[50] * 10 + b[50];", Integer(500 - 1)},
+        {build + "sum(build([], 0, 100));", Integer(4950)},
+        {build + "let a = build([], 0, 100); len(slice(a, 10, 60)) + slice(a, 10, 60)[0];", Integer(60)},
+        {"set([1, 2, 3], 0, \"one\")[0];", String("one")},
+        {"let a = [1, 2]; let b = set(a, 1, 5); a[1] + b[1];", Integer(7)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+
+    // Equal values are equal arrays whatever their representation
+    std::vector<int64_t> expected(40);
+    std::iota(expected.begin(), expected.end(), 0);
+    ASSERT_EQ(eval_program(build + "build([], 0, 40);").value(), Object(Array(expected)));
+    auto error = eval_program("set([1], 1, 0);");
+    ASSERT_FALSE(error.has_value());
+    ASSERT_EQ(get_msg(error.error()), "set out of range: index=1, size=1");
+}
+
+TEST(Persistent, HashTest) {
+    std::string build = "let build = fn(h, i, n) { if (i < n) { build(put(h, i, i * i), i + 1, n) } else { h } };";
+    auto evaluated = eval_program(build + "build({}, 0, 300);");
+    ASSERT_TRUE(evaluated.has_value());
+    auto &hash = std::get<Hash>(evaluated.value());
+    ASSERT_TRUE(std::holds_alternative<PersistentMap>(*hash.storage));
+    ASSERT_EQ(hash.size(), 300);
+
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {build + "let h = build({}, 0, 300); h[17] + h[299];", Integer(17 * 17 + 299 * 299)},
+        {build + "let h = build({}, 0, 100); let g = put(h, 5, 0); h[5] * 10 + g[5] + len(g);", Integer(250 + 100)},
+        {build + "keys(build({}, 0, 40))[39];", Integer(39)},
+        {build + "has(build({\"x\": 1}, 0, 50), \"x\");", Boolean(true)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+}
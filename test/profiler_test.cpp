@@ -0,0 +1,46 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "intern.h"
+#include "profiler.h"
+
+TEST(Profiler, ReportTest) {
+    Profile profile;
+    profile.stacks = {{"main;fib;fib", 6}, {"main;fib", 2}, {"main", 1}, {"(top level)", 1}};
+    profile.samples = 10;
+    profile.interval = 1000;
+    ASSERT_EQ(folded_stacks(profile), "(top level) 1\nmain 1\nmain;fib 2\nmain;fib;fib 6\n");
+
+    auto table = print_profile(profile, 2);
+    ASSERT_NE(table.find("profile: 10 samples every 1000us, 0 dropped"), std::string::npos);
+    // fib has 8 samples of its own and is in 8, main has 1 of its own but is in 9. Recursion counts once per sample
+    ASSERT_NE(table.find("         8.0   80.0%          8.0   80.0%  fib\n"), std::string::npos) << table;
+    ASSERT_NE(table.find("         1.0   10.0%          9.0   90.0%  main\n"), std::string::npos) << table;
+    ASSERT_EQ(table.find("(top level)"), std::string::npos);
+}
+
+TEST(Profiler, SampleTest) {
+    // Frames are only pushed while the profiler runs
+    {
+        ProfileFrame frame(intern("idle"));
+        ASSERT_EQ(shadow_stack.depth.load(), 0);
+    }
+
+    profiler_config().frequency = 2000;
+    ASSERT_TRUE(start_profiler());
+    ASSERT_FALSE(start_profiler());
+    auto result = eval_program("let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; let run = fn() { fib(21) }; run();");
+    auto profile = stop_profiler();
+    profiler_config() = ProfilerConfig();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(shadow_stack.depth.load(), 0);
+
+    ASSERT_GT(profile.samples, 0);
+    ASSERT_EQ(profile.interval, 500);
+    uint64_t counted = 0;
+    for (const auto &[stack, count]: profile.stacks) {
+        ASSERT_TRUE(stack.starts_with("run;fib") || stack == PROFILER_TOP_LEVEL) << stack;
+        counted += count;
+    }
+    ASSERT_EQ(counted, profile.samples);
+}
@@ -0,0 +1,113 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <format>
+#include <thread>
+
+#include "rope.h"
+
+TEST(Rope, ConcatTest) {
+    auto flat = [](std::string s) { return std::make_shared<const Rope>(std::move(s)); };
+    // Short results are copied into one flat string
+    auto small = Rope::concat(flat("mon"), flat("ke"));
+    ASSERT_EQ(small->flat(), "monke");
+
+    // Long ones link both sides, which stay as they were
+    std::string long_left(100, 'a');
+    auto left = flat(long_left);
+    auto right = flat("b");
+    auto joined = Rope::concat(left, right);
+    ASSERT_EQ(joined->size(), 101);
+    ASSERT_EQ(joined->flat(), long_left + "b");
+    ASSERT_EQ(left->flat(), long_left);
+    ASSERT_EQ(Rope::concat(joined, flat("")), joined);
+    ASSERT_EQ(Rope::concat(flat(""), joined), joined);
+
+    // Deep enough that flattening or releasing it recursively would overflow the stack
+    auto rope = flat("");
+    std::string expected;
+    for (size_t i = 0; i < 200000; i++) {
+        auto piece = std::format("{}", i % 10);
+        rope = Rope::concat(rope, flat(piece));
+        expected += piece;
+        if (i == 500) {
+            ASSERT_EQ(rope->flat(), expected);
+        }
+    }
+    ASSERT_EQ(rope->size(), expected.size());
+    ASSERT_EQ(rope->flat(), expected);
+    rope.reset();
+}
+
+TEST(Rope, FlattenReleasesHalvesTest) {
+    auto flat = [](std::string s) { return std::make_shared<const Rope>(std::move(s)); };
+    std::string piece(100, 'x');
+    // Appending and reading at every step, like a loop that checks len
+    auto rope = flat("");
+    for (size_t i = 0; i < 200; i++) {
+        rope = Rope::concat(rope, flat(piece));
+        ASSERT_EQ(rope->flat().size(), (i + 1) * piece.size());
+    }
+    // Each flattened concatenation dropped its halves, so the result is one copy rather than one per prefix
+    size_t retained = 0;
+    std::vector<std::shared_ptr<const Rope>> pending = {rope};
+    while (!pending.empty()) {
+        auto node = std::move(pending.back());
+        pending.pop_back();
+        retained += node->self_size();
+        if (auto left = node->left_half()) pending.push_back(left);
+        if (auto right = node->right_half()) pending.push_back(right);
+    }
+    ASSERT_EQ(rope->left_half(), nullptr);
+    ASSERT_LT(retained, 2 * rope->size());
+}
+
+TEST(Rope, ConcurrentFlattenTest) {
+    auto flat = [](std::string s) { return std::make_shared<const Rope>(std::move(s)); };
+    std::vector<std::shared_ptr<const Rope>> prefixes = {flat("")};
+    std::string expected;
+    for (size_t i = 0; i < 5000; i++) {
+        auto piece = std::format("{:>70}", i);
+        prefixes.push_back(Rope::concat(prefixes.back(), flat(piece)));
+        expected += piece;
+    }
+    // Flattening the prefixes releases nodes the other threads are walking through
+    std::vector<std::thread> workers;
+    std::vector<int> correct(4, 0);
+    for (size_t t = 0; t < 4; t++) {
+        workers.emplace_back([&, t]() {
+            if (t == 0) {
+                for (size_t i = 1; i < prefixes.size(); i += 7) prefixes[i]->flat();
+            }
+            correct[t] = prefixes.back()->flat() == expected;
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    ASSERT_EQ(correct, std::vector<int>(4, 1));
+}
+
+TEST(Rope, StringTest) {
+    std::string build = "let build = fn(s, i, n) { if (i < n) { build(s + \"ab\", i + 1, n) } else { s } };";
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {build + "len(build(\"\", 0, 500));", Integer(1000)},
+        {build + "build(\"\", 0, 500)[123];", Char('b')},
+        {build + "build(\"\", 0, 100) == build(\"\", 0, 100);", Boolean(true)},
+        {build + "build(\"\", 0, 100) == build(\"b\", 0, 99) + \"a\";", Boolean(false)},
+        {build + "let s = build(\"\", 0, 100); substr(s + s, 197, 4);", String("baba")},
+        {build + "let h = {}; let k = build(\"\", 0, 100); put(h, k, 1)[build(\"\", 0, 100)];", Integer(1)},
+        {"\"a\" + \"\" + \"b\";", String("ab")},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+
+    std::string expected;
+    for (size_t i = 0; i < 300; i++) expected += "ab";
+    auto evaluated = eval_program(build + "build(\"\", 0, 300);");
+    ASSERT_EQ(evaluated.value(), Object(String(expected)));
+    ASSERT_EQ(std::get<String>(evaluated.value()).value(), expected);
+}
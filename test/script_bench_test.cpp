@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "script_bench.h"
+
+TEST(ScriptBench, RunTest) {
+    ScriptBenchOptions options;
+    options.warmup = 1;
+    options.runs = 5;
+    // Each run starts from a fresh scope, so the lets bind again every time
+    auto result = bench_script("let f = fn(x) { x + 1 }; let a = [f(1), f(2)]; a[1] + 1;", options);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->runs, 5);
+    ASSERT_GT(result->wall.min, 0);
+    ASSERT_LE(result->wall.min, result->wall.median);
+    ASSERT_LE(result->wall.median, result->wall.p99);
+    ASSERT_GT(result->lex.median, 0);
+    ASSERT_GT(result->parse.median, 0);
+    ASSERT_GT(result->allocations, 0);
+    ASSERT_GT(result->max_rss, 0);
+
+    ASSERT_FALSE(bench_script("let x = 'ab';", options).has_value());
+    ASSERT_FALSE(bench_script("missing(1);", options).has_value());
+}
+
+TEST(ScriptBench, DistributionTest) {
+    std::vector<uint64_t> samples;
+    for (uint64_t i = 200; i > 0; i--) samples.push_back(i);
+    auto distribution = Distribution::of(samples);
+    ASSERT_EQ(distribution.min, 1);
+    ASSERT_EQ(distribution.median, 101);
+    ASSERT_EQ(distribution.p99, 198);
+    ASSERT_EQ(Distribution::of({7}).p99, 7);
+}
+
+TEST(ScriptBench, CompareTest) {
+    ScriptBenchResult baseline;
+    baseline.runs = 10;
+    baseline.wall = {100, 200, 300};
+    baseline.allocations = 50;
+    baseline.allocated_bytes = 1000;
+    baseline.max_rss = 4096;
+    auto saved = parse_script_bench_json(script_bench_json(baseline));
+    ASSERT_TRUE(saved.has_value());
+    ASSERT_EQ(saved->wall.median, 200);
+    ASSERT_EQ(saved->allocated_bytes, 1000);
+    ASSERT_EQ(saved->max_rss, 4096);
+    ASSERT_FALSE(parse_script_bench_json("{\"runs\": 3}").has_value());
+
+    auto result = baseline;
+    result.wall.median = 208;
+    ASSERT_FALSE(compare_script_bench(baseline, result, 5.0).second);
+    result.wall.median = 220;
+    auto [table, regressed] = compare_script_bench(baseline, result, 5.0);
+    ASSERT_TRUE(regressed);
+    ASSERT_NE(table.find("+10.0%  regression"), std::string::npos) << table;
+    // Slower p99 alone is noise, more allocated bytes is not
+    result.wall.median = 200;
+    result.wall.p99 = 900;
+    ASSERT_FALSE(compare_script_bench(baseline, result, 5.0).second);
+    result.allocated_bytes = 1100;
+    ASSERT_TRUE(compare_script_bench(baseline, result, 5.0).second);
+}
@@ -0,0 +1,171 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+#include "simd.h"
+
+namespace {
+    std::vector<SimdLevel> levels() {
+        std::vector<SimdLevel> out = {SimdLevel::Scalar};
+        if (supported_simd_level() >= SimdLevel::SSE) out.push_back(SimdLevel::SSE);
+        if (supported_simd_level() >= SimdLevel::AVX2) out.push_back(SimdLevel::AVX2);
+        return out;
+    }
+}
+
+TEST(Simd, DispatchTest) {
+    ASSERT_EQ(simd_kernels(SimdLevel::Scalar).level, SimdLevel::Scalar);
+    ASSERT_EQ(simd_kernels().level, supported_simd_level());
+    // Asking for more than the CPU has falls back to what it does have
+    ASSERT_LE(simd_kernels(SimdLevel::AVX2).level, supported_simd_level());
+}
+
+TEST(Simd, IntegerKernelsTest) {
+    for (auto level: levels()) {
+        auto &ops = simd_kernels(level).i64;
+        // Every length up to a few registers, so both the vector loop and the tail are covered
+        for (size_t n = 1; n < 40; n++) {
+            std::vector<int64_t> a(n), b(n);
+            for (size_t i = 0; i < n; i++) {
+                a[i] = static_cast<int64_t>(i * 7 % 13) - 6;
+                b[i] = (static_cast<int64_t>(1) << 33) + static_cast<int64_t>(i) * -3;
+            }
+            int64_t sum = 0, dot = 0, lo = a[0], hi = a[0];
+            for (size_t i = 0; i < n; i++) {
+                sum += a[i];
+                dot += a[i] * b[i];
+                lo = std::min(lo, a[i]);
+                hi = std::max(hi, a[i]);
+            }
+            ASSERT_EQ(ops.sum(a.data(), n), sum) << simd_level_name(level) << " n=" << n;
+            ASSERT_EQ(ops.dot(a.data(), b.data(), n), dot) << simd_level_name(level) << " n=" << n;
+            ASSERT_EQ(ops.min(a.data(), n), lo);
+            ASSERT_EQ(ops.max(a.data(), n), hi);
+
+            std::vector<int64_t> out(n);
+            ops.mul(a.data(), b.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], a[i] * b[i]);
+            ops.add_scalar(a.data(), 100, out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], a[i] + 100);
+            ops.clamp(a.data(), -2, 3, out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], std::clamp<int64_t>(a[i], -2, 3));
+        }
+
+        // Overflow wraps instead of trapping or saturating
+        std::vector<int64_t> big = {INT64_MAX, 1, INT64_MAX, 1, INT64_MAX};
+        ASSERT_EQ(ops.sum(big.data(), big.size()), static_cast<int64_t>(3 * static_cast<uint64_t>(INT64_MAX) + 2));
+    }
+}
+
+TEST(Simd, FloatKernelsTest) {
+    for (auto level: levels()) {
+        auto &ops = simd_kernels(level).f64;
+        for (size_t n = 1; n < 40; n++) {
+            // Small halves add up exactly in any order
+            std::vector<double> a(n), b(n);
+            for (size_t i = 0; i < n; i++) {
+                a[i] = static_cast<double>(i % 9) * 0.5 - 2.0;
+                b[i] = static_cast<double>(i % 4) + 0.5;
+            }
+            double sum = 0, dot = 0, lo = a[0], hi = a[0];
+            for (size_t i = 0; i < n; i++) {
+                sum += a[i];
+                dot += a[i] * b[i];
+                lo = std::min(lo, a[i]);
+                hi = std::max(hi, a[i]);
+            }
+            ASSERT_EQ(ops.sum(a.data(), n), sum) << simd_level_name(level) << " n=" << n;
+            ASSERT_EQ(ops.dot(a.data(), b.data(), n), dot);
+            ASSERT_EQ(ops.min(a.data(), n), lo);
+            ASSERT_EQ(ops.max(a.data(), n), hi);
+
+            std::vector<double> out(n);
+            ops.add(a.data(), b.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], a[i] + b[i]);
+            ops.mul_scalar(a.data(), 2.0, out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], a[i] * 2.0);
+            ops.clamp(a.data(), -1.0, 1.0, out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], std::clamp(a[i], -1.0, 1.0));
+        }
+    }
+}
+
+TEST(Simd, FloatNaNTest) {
+    auto nan = std::numeric_limits<double>::quiet_NaN();
+    for (auto level: levels()) {
+        auto &ops = simd_kernels(level).f64;
+        for (size_t n = 1; n < 20; n++) {
+            // Like the scalar scan: NaN only if the first element is, otherwise every NaN is skipped
+            for (size_t at = 0; at < n; at++) {
+                std::vector<double> a(n);
+                for (size_t i = 0; i < n; i++) a[i] = static_cast<double>((i * 5) % 7) - 3.0;
+                a[at] = nan;
+                double lo = at == 0 ? nan : a[0], hi = lo;
+                for (size_t i = 1; i < n; i++) {
+                    if (i == at) continue;
+                    lo = std::min(lo, a[i]);
+                    hi = std::max(hi, a[i]);
+                }
+                ASSERT_EQ(std::isnan(ops.min(a.data(), n)), at == 0) << simd_level_name(level) << " n=" << n << " at=" << at;
+                ASSERT_EQ(std::isnan(ops.max(a.data(), n)), at == 0);
+                if (at != 0) {
+                    ASSERT_EQ(ops.min(a.data(), n), lo) << simd_level_name(level) << " n=" << n << " at=" << at;
+                    ASSERT_EQ(ops.max(a.data(), n), hi);
+                }
+
+                std::vector<double> out(n);
+                ops.clamp(a.data(), -1.0, 1.0, out.data(), n);
+                for (size_t i = 0; i < n; i++) ASSERT_EQ(std::isnan(out[i]), i == at) << simd_level_name(level);
+            }
+        }
+    }
+}
+
+TEST(Simd, BuiltinsTest) {
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"vec(1, 2, 3);", Vec(std::vector<int64_t>({1, 2, 3}))},
+        {"vec(1, 2.5);", Vec(std::vector<double>({1.0, 2.5}))},
+        {"vec([4, 5]);", Vec(std::vector<int64_t>({4, 5}))},
+        {"vec([1, 0.5]);", Vec(std::vector<double>({1.0, 0.5}))},
+        {"sum(vec(1, 2, 3, 4, 5));", Integer(15)},
+        {"sum([0.5, 0.25]);", Float(0.75)},
+        {"sum(vec());", Integer(0)},
+        {"dot(vec(1, 2, 3), vec(4, 5, 6));", Integer(32)},
+        {"dot(vec(1, 2), [0.5, 0.5]);", Float(1.5)},
+        {"min(vec(3, -1, 2)) + max(vec(3, -1, 2));", Integer(2)},
+        {"max([1.5, 0.5]);", Float(1.5)},
+        {"min(4, 2);", Integer(2)},
+        {"map_add(vec(1, 2), 10);", Vec(std::vector<int64_t>({11, 12}))},
+        {"map_add(vec(1, 2), vec(3, 4));", Vec(std::vector<int64_t>({4, 6}))},
+        {"map_mul(vec(1, 2), 0.5);", Vec(std::vector<double>({0.5, 1.0}))},
+        {"map_mul([2, 3], [4, 5]);", Vec(std::vector<int64_t>({8, 15}))},
+        {"clamp(vec(-5, 0, 5), -1, 1);", Vec(std::vector<int64_t>({-1, 0, 1}))},
+        {"clamp(vec(0.5, 2.5), 0, 1);", Vec(std::vector<double>({0.5, 1.0}))},
+        {"clamp(7, 0, 5);", Integer(5)},
+        {"let v = vec(7, 8, 9); v[1] + len(v);", Integer(11)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+}
+
+TEST(Simd, ErrorsTest) {
+    std::vector<std::tuple<std::string, std::string> > tests = {
+        {"vec(1, \"a\");", "argument to `vec` not supported, got String"},
+        {"sum(1);", "argument to `sum` not supported, got Integer"},
+        {"sum([1, \"a\"]);", "argument to `sum` not supported, got Array"},
+        {"dot(vec(1, 2), vec(1));", "length mismatch in `dot`: 2 vs 1"},
+        {"map_add(vec(1), vec(1, 2));", "length mismatch in `map_add`: 1 vs 2"},
+        {"min(vec());", "`min` of an empty vector"},
+        {"max(1, 2, 3);", "wrong number of arguments: want=1 or 2, got=3"},
+    };
+    for (const auto &[input, message]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_FALSE(evaluated.has_value()) << input;
+        ASSERT_EQ(get_msg(evaluated.error()), message);
+    }
+}
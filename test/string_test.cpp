@@ -0,0 +1,56 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include "hash_table.h"
+#include "intern.h"
+
+TEST(String, StorageTest) {
+    // Either side of the inline capacity, and long enough for a rope
+    for (size_t length: {size_t(0), size_t(1), String::INLINE_CAPACITY, String::INLINE_CAPACITY + 1, Rope::FLAT_LIMIT + 1}) {
+        std::string chars(length, 'x');
+        String s(chars);
+        ASSERT_EQ(s.size(), length);
+        ASSERT_EQ(s.value(), chars);
+        ASSERT_EQ(s.interned(), nullptr);
+        ASSERT_EQ(String(std::string_view(chars)), s);
+        String copy = s;
+        ASSERT_EQ(copy.value(), chars);
+    }
+
+    auto *symbol = intern("an interned string that is too long to be inline");
+    auto s = String::symbol(symbol);
+    ASSERT_EQ(s.interned(), symbol);
+    ASSERT_EQ(s.value().data(), symbol->data());
+    ASSERT_EQ(HashKey::of(s), HashKey::symbol(symbol));
+    ASSERT_EQ(HashKey::find(s), HashKey::symbol(symbol));
+    ASSERT_EQ(std::get<String>(HashKey::symbol(symbol).object()).interned(), symbol);
+}
+
+TEST(String, LiteralTest) {
+    // Literals refer to the parser's interned copy instead of copying it
+    auto evaluated = eval_program("\"a literal string longer than the inline capacity\";");
+    auto &s = std::get<String>(evaluated.value());
+    ASSERT_EQ(s.interned(), intern("a literal string longer than the inline capacity"));
+
+    auto a = String::symbol(intern("monke"));
+    ASSERT_EQ(a, String::symbol(intern("monke")));
+    ASSERT_FALSE(a == String::symbol(intern("monkey")));
+    // Interned and uninterned strings still compare by their characters
+    ASSERT_EQ(a, String("monke"));
+    ASSERT_EQ(String(std::string(40, 'm')), String::symbol(intern(std::string(40, 'm'))));
+
+    std::vector<std::tuple<std::string, Object> > tests = {
+        {"\"monke\" == \"monke\";", Boolean(true)},
+        {"\"monke\" == \"monkey\";", Boolean(false)},
+        {"\"mon\" + \"ke\" == \"monke\";", Boolean(true)},
+        {"let f = fn() { \"same literal\" }; f() == f();", Boolean(true)},
+        {"'a' + 'b';", String("ab")},
+        {"len(\"twenty three characters\" + \"!\");", Integer(24)},
+        {"{\"key\": 1}[\"k\" + \"ey\"];", Integer(1)},
+    };
+    for (const auto &[input, correct]: tests) {
+        auto evaluated = eval_program(input);
+        ASSERT_TRUE(evaluated.has_value()) << input;
+        ASSERT_EQ(evaluated.value(), correct) << input;
+    }
+}
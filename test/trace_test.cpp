@@ -0,0 +1,63 @@
+#include <eval.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "trace.h"
+
+namespace {
+    size_t count(const std::string &haystack, const std::string &needle) {
+        size_t n = 0;
+        for (auto at = haystack.find(needle); at != std::string::npos; at = haystack.find(needle, at + 1)) n++;
+        return n;
+    }
+}// namespace
+
+TEST(Trace, PhaseTest) {
+    std::string program = "let f = fn(x) { x + 1 }; let g = fn(x) { f(x) * 2 }; g(1) + g(2);";
+    // Nothing is recorded unless tracing was started
+    eval_program(program);
+    start_tracing(false);
+    ASSERT_EQ(eval_program(program).value(), Object(Integer(10)));
+    auto phases = stop_tracing();
+    ASSERT_TRUE(phases.starts_with("{\"traceEvents\": ["));
+    ASSERT_EQ(count(phases, "\"ph\": \"X\""), 3) << phases;
+    ASSERT_EQ(count(phases, "{\"name\": \"lex\", \"cat\": \"phase\""), 1);
+    ASSERT_EQ(count(phases, "{\"name\": \"parse\", \"cat\": \"phase\""), 1);
+    ASSERT_EQ(count(phases, "{\"name\": \"evaluate\", \"cat\": \"phase\""), 1);
+
+    start_tracing(true);
+    eval_program(program);
+    auto calls = stop_tracing();
+    ASSERT_EQ(count(calls, "{\"name\": \"g\", \"cat\": \"call\""), 2);
+    ASSERT_EQ(count(calls, "{\"name\": \"f\", \"cat\": \"call\""), 2);
+    ASSERT_EQ(count(calls, "\"ph\": \"X\""), 7);
+}
+
+TEST(Trace, BufferTest) {
+    start_tracing(false);
+    // Each thread records into its own buffer, and a full buffer keeps the newest events
+    std::thread other([]() {
+        for (size_t i = 0; i < TRACE_BUFFER_EVENTS + 10; i++) TraceScope scope(i < 10 ? "old" : "new");
+    });
+    other.join();
+    { TraceScope scope("main \"thread\""); }
+    auto trace = stop_tracing();
+    ASSERT_EQ(count(trace, "\"ph\": \"X\""), TRACE_BUFFER_EVENTS + 1);
+    ASSERT_EQ(count(trace, "\"old\""), 0);
+    ASSERT_EQ(count(trace, "{\"name\": \"main \\\"thread\\\"\""), 1);
+}
+
+TEST(Trace, ExitedThreadsTest) {
+    start_tracing(false);
+    // A thread's events outlive it, its buffer goes to the next thread
+    for (int i = 0; i < 3; i++) {
+        std::thread worker([]() { TraceScope scope("worker"); });
+        worker.join();
+    }
+    auto trace = stop_tracing();
+    ASSERT_EQ(count(trace, "{\"name\": \"worker\""), 3);
+    // Starting again forgets them
+    start_tracing(false);
+    ASSERT_EQ(count(stop_tracing(), "\"ph\": \"X\""), 0);
+}